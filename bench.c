@@ -0,0 +1,1127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "channel.h"
+#include "compact_channel.h"
+#include "shared_channel.h"
+#include "mmap_source.h"
+#include "trace.h"
+#include "broadcast.h"
+#include "stress.h"
+#include "stress_send_recv.h"
+
+// Micro benchmarks for the channel library
+// Usage: ./channel_bench            runs every benchmark with default parameters
+//        ./channel_bench name args  runs a single benchmark
+
+typedef void (*bench_fn_t)(int argc, char** argv);
+typedef struct {
+    char* name;
+    char* usage;
+    bench_fn_t bench;
+} bench_t;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t arg_size(int argc, char** argv, int index, size_t fallback)
+{
+    return argc > index ? (size_t)strtoull(argv[index], NULL, 10) : fallback;
+}
+
+static void report(const char* label, double ops, uint64_t elapsed_ns)
+{
+    double seconds = (double)elapsed_ns / 1e9;
+    printf("  %-36s %14.0f ops/s  (%.3f s)\n", label, ops / seconds, seconds);
+}
+
+// Ring of channels (as in run_stress_send_recv) with the channels local to, or remote from, the worker threads
+static void bench_numa(int argc, char** argv)
+{
+    size_t threads = arg_size(argc, argv, 0, 8);
+    size_t buffer_size = arg_size(argc, argv, 1, 16);
+    useconds_t duration = (useconds_t)arg_size(argc, argv, 2, 1000000);
+    int nodes = numa_node_count();
+    printf("numa: %zu threads, buffer %zu, %d node(s)\n", threads, buffer_size, nodes);
+
+    uint64_t start = now_ns();
+    size_t hops = run_stress_send_recv_on_node(buffer_size, threads, 0.5, duration, 0, 0);
+    report("within socket (node 0 -> node 0)", (double)hops, now_ns() - start);
+    if (nodes <= 1) {
+        printf("  single NUMA node: placement is a no-op, skipping cross-socket run\n");
+        return;
+    }
+    start = now_ns();
+    hops = run_stress_send_recv_on_node(buffer_size, threads, 0.5, duration, 1, 0);
+    report("across sockets (node 1 -> node 0)", (double)hops, now_ns() - start);
+}
+
+// Heap bytes currently in use by the allocator
+static size_t heap_in_use()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Creates many idle channels and reports the memory each one costs
+static void bench_memory(int argc, char** argv)
+{
+    size_t count = arg_size(argc, argv, 0, 1000000);
+    size_t size = arg_size(argc, argv, 1, 16);
+    printf("memory: %zu idle channels of size %zu\n", count, size);
+
+    channel_t** channels = malloc(sizeof(channel_t*) * count);
+    size_t before = heap_in_use();
+    for (size_t i = 0; i < count; i++) {
+        channels[i] = channel_create(size);
+    }
+    size_t after = heap_in_use();
+    printf("  %-36s %10.1f bytes/channel\n", "channel_create", (double)(after - before) / (double)count);
+    for (size_t i = 0; i < count; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    free(channels);
+
+    compact_channel_t** compact = malloc(sizeof(compact_channel_t*) * count);
+    before = heap_in_use();
+    for (size_t i = 0; i < count; i++) {
+        compact[i] = compact_channel_create(size);
+    }
+    after = heap_in_use();
+    printf("  %-36s %10.1f bytes/channel (struct %zu bytes)\n", "compact_channel_create",
+           (double)(after - before) / (double)count, sizeof(compact_channel_t));
+    for (size_t i = 0; i < count; i++) {
+        compact_channel_close(compact[i]);
+        compact_channel_destroy(compact[i]);
+    }
+    free(compact);
+}
+
+// Reads exactly len bytes from fd
+static bool read_full(int fd, void* buf, size_t len)
+{
+    unsigned char* out = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, out, len);
+        if (n <= 0) {
+            return false;
+        }
+        out += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Moves messages from a parent producer process to a child consumer process through a shared channel and a pipe
+static void bench_shared(int argc, char** argv)
+{
+    size_t count = arg_size(argc, argv, 0, 1000000);
+    size_t elem_size = arg_size(argc, argv, 1, 64);
+    size_t capacity = arg_size(argc, argv, 2, 1024);
+    printf("shared: %zu messages of %zu bytes between two processes\n", count, elem_size);
+    unsigned char* message = calloc(1, elem_size);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        free(message);
+        return;
+    }
+    uint64_t start = now_ns();
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[1]);
+        for (size_t i = 0; i < count; i++) {
+            if (!read_full(fds[0], message, elem_size)) {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+    close(fds[0]);
+    for (size_t i = 0; i < count; i++) {
+        if (write(fds[1], message, elem_size) != (ssize_t)elem_size) {
+            break;
+        }
+    }
+    close(fds[1]);
+    waitpid(child, NULL, 0);
+    report("pipe", (double)count, now_ns() - start);
+
+    shared_channel_t* channel = channel_create_shared(NULL, capacity, elem_size);
+    if (!channel) {
+        printf("  could not create shared channel\n");
+        free(message);
+        return;
+    }
+    start = now_ns();
+    child = fork();
+    if (child == 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (shared_channel_receive(channel, message) != SUCCESS) {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+    for (size_t i = 0; i < count; i++) {
+        shared_channel_send(channel, message);
+    }
+    waitpid(child, NULL, 0);
+    report("shared channel", (double)count, now_ns() - start);
+    shared_channel_close(channel);
+    shared_channel_destroy(channel);
+    free(message);
+}
+
+// Counts words in a stream of chunks; in_word carries a word that spans two chunks
+static size_t count_words(const char* data, size_t length, bool* in_word)
+{
+    size_t words = 0;
+    for (size_t i = 0; i < length; i++) {
+        bool space = data[i] == ' ' || data[i] == '\n';
+        if (!space && !*in_word) {
+            words++;
+        }
+        *in_word = !space;
+    }
+    return words;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+} read_chunk_t;
+
+typedef struct {
+    const char* path;
+    size_t chunk_size;
+    channel_t* out;
+} wordcount_producer_t;
+
+// Reads the file with fread into a freshly allocated buffer per chunk; NULL marks the end
+static void* wordcount_fread_producer(wordcount_producer_t* args)
+{
+    FILE* file = fopen(args->path, "r");
+    while (file) {
+        read_chunk_t* chunk = malloc(sizeof(read_chunk_t));
+        chunk->data = malloc(args->chunk_size);
+        chunk->length = fread(chunk->data, 1, args->chunk_size, file);
+        if (chunk->length == 0) {
+            free(chunk->data);
+            free(chunk);
+            break;
+        }
+        channel_send(args->out, chunk);
+    }
+    if (file) {
+        fclose(file);
+    }
+    channel_send(args->out, NULL);
+    return NULL;
+}
+
+static void* wordcount_mmap_producer(wordcount_producer_t* args)
+{
+    mmap_source_t* source = mmap_source_open(args->path, args->chunk_size, -1);
+    if (source) {
+        mmap_source_run(source, args->out);
+    } else {
+        // No end-of-file chunk is coming, so closing is the only way to release the consumer
+        channel_close(args->out);
+    }
+    return NULL;
+}
+
+// Word count over a generated text file, reading it with fread plus malloc per chunk versus the mmap source
+static void bench_wordcount(int argc, char** argv)
+{
+    size_t megabytes = arg_size(argc, argv, 0, 256);
+    size_t chunk_size = arg_size(argc, argv, 1, 64 * 1024);
+    printf("wordcount: %zu MiB file, %zu byte chunks\n", megabytes, chunk_size);
+
+    char path[] = "/tmp/channel_bench_words_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    char line[4096];
+    unsigned seed = 1;
+    for (size_t written = 0; written < megabytes << 20; written += sizeof(line)) {
+        for (size_t i = 0; i < sizeof(line); i++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned r = (seed >> 16) % 32;
+            line[i] = r < 5 ? ' ' : r == 5 ? '\n' : (char)('a' + r - 6);
+        }
+        if (write(fd, line, sizeof(line)) != (ssize_t)sizeof(line)) {
+            perror("write");
+            break;
+        }
+    }
+    close(fd);
+    double bytes = (double)(megabytes << 20);
+
+    channel_t* chunks = channel_create(16);
+    wordcount_producer_t args = {path, chunk_size, chunks};
+    pthread_t producer;
+    uint64_t start = now_ns();
+    pthread_create(&producer, NULL, (void*)wordcount_fread_producer, &args);
+    size_t words = 0;
+    bool in_word = false;
+    while (true) {
+        void* data = NULL;
+        channel_receive(chunks, &data);
+        read_chunk_t* chunk = data;
+        if (!chunk) {
+            break;
+        }
+        words += count_words(chunk->data, chunk->length, &in_word);
+        free(chunk->data);
+        free(chunk);
+    }
+    pthread_join(producer, NULL);
+    report("fread + malloc per chunk (bytes)", bytes, now_ns() - start);
+    size_t fread_words = words;
+
+    start = now_ns();
+    pthread_create(&producer, NULL, (void*)wordcount_mmap_producer, &args);
+    words = 0;
+    in_word = false;
+    while (true) {
+        void* data = NULL;
+        if (channel_receive(chunks, &data) != SUCCESS) {
+            fprintf(stderr, "wordcount: could not map %s\n", path);
+            break;
+        }
+        file_chunk_t* chunk = data;
+        size_t length = chunk->length;
+        words += count_words(chunk->data, length, &in_word);
+        mmap_source_release(chunk);
+        if (length == 0) {
+            break;
+        }
+    }
+    pthread_join(producer, NULL);
+    report("mmap source (bytes)", bytes, now_ns() - start);
+    printf("  %zu words (fread) / %zu words (mmap)\n", fread_words, words);
+
+    channel_close(chunks);
+    channel_destroy(chunks);
+    unlink(path);
+}
+
+static void report_snapshot(const char* label, const shared_snapshot_stats_t* stats)
+{
+    printf("  %-36s %14.0f msgs/s %10.1f MiB/s  (%.3f s)\n", label, (double)stats->messages / stats->seconds,
+           (double)stats->bytes / (1024.0 * 1024.0) / stats->seconds, stats->seconds);
+}
+
+// Snapshots a set of full shared channels to a file and restores them into fresh channels
+static void bench_snapshot(int argc, char** argv)
+{
+    size_t count = arg_size(argc, argv, 0, 64);
+    size_t capacity = arg_size(argc, argv, 1, 16384);
+    size_t elem_size = arg_size(argc, argv, 2, 64);
+    printf("snapshot: %zu channels of %zu messages of %zu bytes\n", count, capacity, elem_size);
+
+    shared_channel_t** channels = calloc(count, sizeof(shared_channel_t*));
+    shared_channel_t** restored = calloc(count, sizeof(shared_channel_t*));
+    unsigned char* message = calloc(1, elem_size);
+    for (size_t i = 0; i < count; i++) {
+        channels[i] = channel_create_shared(NULL, capacity, elem_size);
+        restored[i] = channel_create_shared(NULL, capacity, elem_size);
+        if (!channels[i] || !restored[i]) {
+            printf("  could not create shared channels\n");
+            return;
+        }
+        for (size_t n = 0; n < capacity; n++) {
+            shared_channel_send(channels[i], message);
+        }
+    }
+
+    char path[] = "/tmp/channel_bench_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    close(fd);
+    shared_snapshot_stats_t stats;
+    if (shared_channel_snapshot(channels, count, path, &stats) == SUCCESS) {
+        report_snapshot("snapshot (mmap + msync)", &stats);
+    }
+    if (shared_channel_restore(restored, count, path, &stats) == SUCCESS) {
+        report_snapshot("restore (mmap + bulk load)", &stats);
+    }
+    unlink(path);
+
+    for (size_t i = 0; i < count; i++) {
+        shared_channel_close(channels[i]);
+        shared_channel_destroy(channels[i]);
+        shared_channel_close(restored[i]);
+        shared_channel_destroy(restored[i]);
+    }
+    free(channels);
+    free(restored);
+    free(message);
+}
+
+// Builds the channels of a replayed trace with the backend named by arg
+static channel_t* replay_factory(uint32_t id, size_t capacity, void* arg)
+{
+    (void)id;
+    const char* backend = arg;
+    if (capacity == SIZE_MAX || capacity == TRACE_CAPACITY_UNKNOWN) {
+        return channel_create_unbounded(64);
+    }
+    if (strcmp(backend, "unbounded") == 0) {
+        return channel_create_unbounded(64);
+    }
+    if (strcmp(backend, "mapped") == 0 && capacity > 0) {
+        return channel_create_mapped(capacity, 0);
+    }
+    if (strcmp(backend, "spill") == 0) {
+        return channel_create_spill(capacity, 4096, NULL, NULL);
+    }
+    return channel_create(capacity);
+}
+
+// Replays a recorded trace (or a freshly captured stress_send_recv run) against each channel backend
+static void bench_replay(int argc, char** argv)
+{
+    static char* backends[] = {"ring", "unbounded", "mapped", "spill"};
+    char captured[] = "/tmp/channel_bench_trace_XXXXXX";
+    const char* path = argc > 0 ? argv[0] : NULL;
+    double scale = argc > 1 ? strtod(argv[1], NULL) : 1;
+    if (!path) {
+        int fd = mkstemp(captured);
+        if (fd < 0) {
+            perror("mkstemp");
+            return;
+        }
+        close(fd);
+        path = captured;
+        trace_start(path);
+        run_stress_send_recv(16, 8, 0.5, 200000);
+        trace_stop();
+    }
+    printf("replay: %s at time scale %g\n", path, scale);
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (argc > 2 && strcmp(argv[2], backends[i]) != 0) {
+            continue;
+        }
+        trace_replay_stats_t stats;
+        if (trace_replay(path, scale, replay_factory, backends[i], &stats) != 0) {
+            printf("  could not replay %s\n", path);
+            break;
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "%s (%zu threads, %zu diverged)", backends[i], stats.threads, stats.diverged);
+        report(label, (double)stats.operations, (uint64_t)(stats.seconds * 1e9));
+    }
+    if (path == captured) {
+        unlink(captured);
+    }
+}
+
+// Drains messages from one fan-out channel or broadcast subscriber until a NULL message
+static void* fanout_consumer(void* arg)
+{
+    void* data = NULL;
+    while (channel_receive((channel_t*)arg, &data) == SUCCESS && data != NULL) {
+    }
+    return NULL;
+}
+
+// Delivers every message to each of several consumers: one channel_send per consumer versus one broadcast_send
+static void bench_broadcast(int argc, char** argv)
+{
+    size_t subscribers = arg_size(argc, argv, 0, 8);
+    size_t messages = arg_size(argc, argv, 1, 200000);
+    size_t capacity = arg_size(argc, argv, 2, 1024);
+    printf("broadcast: %zu messages to %zu consumers\n", messages, subscribers);
+    channel_t** channels = malloc(subscribers * sizeof(channel_t*));
+    pthread_t* pids = malloc(subscribers * sizeof(pthread_t));
+
+    for (size_t i = 0; i < subscribers; i++) {
+        channels[i] = channel_create(capacity);
+        pthread_create(&pids[i], NULL, fanout_consumer, channels[i]);
+    }
+    uint64_t start = now_ns();
+    for (size_t n = 1; n <= messages + 1; n++) {
+        void* data = n <= messages ? (void*)n : NULL;
+        for (size_t i = 0; i < subscribers; i++) {
+            channel_send(channels[i], data);
+        }
+    }
+    for (size_t i = 0; i < subscribers; i++) {
+        pthread_join(pids[i], NULL);
+    }
+    report("channel_send per consumer", (double)messages, now_ns() - start);
+    for (size_t i = 0; i < subscribers; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+
+    broadcast_t* broadcast = broadcast_create(capacity);
+    for (size_t i = 0; i < subscribers; i++) {
+        pthread_create(&pids[i], NULL, fanout_consumer, broadcast_subscribe(broadcast));
+    }
+    start = now_ns();
+    for (size_t n = 1; n <= messages + 1; n++) {
+        broadcast_send(broadcast, n <= messages ? (void*)n : NULL);
+    }
+    for (size_t i = 0; i < subscribers; i++) {
+        pthread_join(pids[i], NULL);
+    }
+    report("broadcast_send", (double)messages, now_ns() - start);
+    broadcast_close(broadcast);
+    broadcast_destroy(broadcast);
+    free(channels);
+    free(pids);
+}
+
+// Distance-vector routers of the stress test on regular size-1 channels versus conflating channels keyed by sender
+static void bench_conflate(int argc, char** argv)
+{
+    const char* topology = argc > 0 ? argv[0] : "big_graph.txt";
+    size_t runs = arg_size(argc, argv, 1, 5);
+    printf("conflate: routers on %s, %zu runs each\n", topology, runs);
+    for (int conflate = 0; conflate <= 1; conflate++) {
+        size_t vectors = 0;
+        size_t superseded = 0;
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < runs; i++) {
+            size_t skipped = 0;
+            vectors += run_stress_routers(1, 1, topology, conflate, &skipped);
+            superseded += skipped;
+        }
+        uint64_t elapsed = now_ns() - start;
+        printf("  %-24s %8zu vectors processed %8zu superseded per run  (%.3f s/run)\n",
+               conflate ? "conflating channels" : "size-1 channels", vectors / runs, superseded / runs,
+               (double)elapsed / 1e9 / (double)runs);
+    }
+}
+
+// Consumer that handles messages at a fixed cost per message until the channel closes
+static void* slow_consumer(void* arg)
+{
+    void* data = NULL;
+    while (channel_receive((channel_t*)arg, &data) == SUCCESS) {
+        uint64_t until = now_ns() + 500;
+        while (now_ns() < until) {
+        }
+    }
+    return NULL;
+}
+
+// A producer sending to a slower consumer through a full channel with each overflow policy
+static void bench_overflow(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 1000000);
+    size_t capacity = arg_size(argc, argv, 1, 1024);
+    printf("overflow: %zu messages into a channel of %zu with a slow consumer\n", messages, capacity);
+    static const char* names[] = {"block", "drop newest", "drop oldest"};
+    for (int policy = CHANNEL_OVERFLOW_BLOCK; policy <= CHANNEL_OVERFLOW_DROP_OLDEST; policy++) {
+        channel_t* channel = channel_create(capacity);
+        channel_set_overflow(channel, (enum channel_overflow)policy, NULL);
+        pthread_t pid;
+        pthread_create(&pid, NULL, slow_consumer, channel);
+        uint64_t start = now_ns();
+        for (size_t i = 1; i <= messages; i++) {
+            channel_send(channel, (void*)i);
+        }
+        uint64_t elapsed = now_ns() - start;
+        char label[64];
+        snprintf(label, sizeof(label), "%s (%zu dropped)", names[policy], channel_dropped(channel));
+        report(label, (double)messages, elapsed);
+        channel_close(channel);
+        pthread_join(pid, NULL);
+        channel_destroy(channel);
+    }
+}
+
+// Consumer for bench_codel: records each message's queueing latency (messages carry their send time)
+typedef struct {
+    channel_t* channel;
+    uint64_t* latencies;
+    size_t count;
+} latency_consumer_t;
+
+static void* latency_consumer(void* arg)
+{
+    latency_consumer_t* consumer = arg;
+    void* data = NULL;
+    while (channel_receive(consumer->channel, &data) == SUCCESS && data != NULL) {
+        uint64_t now = now_ns();
+        consumer->latencies[consumer->count++] = now - (uint64_t)data;
+        uint64_t until = now + 500;
+        while (now_ns() < until) {
+        }
+    }
+    return NULL;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// An open-loop producer offering messages twice as fast as the consumer handles them, into a large ring
+// with and without CoDel; reports the queueing latency percentiles of the messages that got through
+static void bench_codel(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 400000);
+    size_t capacity = arg_size(argc, argv, 1, 16384);
+    uint64_t target = arg_size(argc, argv, 2, 500000);
+    printf("codel: %zu messages offered at 2x the consumer's rate into a channel of %zu, target %.2f ms\n", messages,
+           capacity, (double)target / 1e6);
+    for (int codel = 0; codel <= 1; codel++) {
+        channel_t* channel = channel_create(capacity);
+        if (codel) {
+            channel_set_codel(channel, target, 20 * target, NULL, NULL);
+        }
+        latency_consumer_t consumer = {channel, malloc(messages * sizeof(uint64_t)), 0};
+        pthread_t pid;
+        pthread_create(&pid, NULL, latency_consumer, &consumer);
+        // Messages arrive in batches between sleeps, so the producer also leaves the CPU to the consumer
+        size_t rejected = 0;
+        struct timespec pause = {0, 200000};
+        for (size_t i = 0; i < messages; i++) {
+            if (i % 800 == 0) {
+                nanosleep(&pause, NULL);
+            }
+            if (channel_non_blocking_send(channel, (void*)now_ns()) != SUCCESS) {
+                rejected++;
+            }
+        }
+        channel_send(channel, NULL);
+        pthread_join(pid, NULL);
+        qsort(consumer.latencies, consumer.count, sizeof(uint64_t), compare_u64);
+        printf("  %-14s %8zu delivered %8zu dropped %8zu rejected   p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n",
+               codel ? "codel" : "tail drop", consumer.count, channel_dropped(channel), rejected,
+               (double)consumer.latencies[consumer.count / 2] / 1e6,
+               (double)consumer.latencies[consumer.count * 99 / 100] / 1e6,
+               (double)consumer.latencies[consumer.count - 1] / 1e6);
+        free(consumer.latencies);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+}
+
+// Producer for bench_priority: bulk messages with a control message every 100, ending with a 0
+// Control messages go to the control channel if there is one, otherwise to lane control_lane of bulk
+typedef struct {
+    channel_t* bulk;
+    channel_t* control;
+    size_t control_lane;
+    uint64_t* sent_at; // send time of each message, by index
+    size_t messages;
+} priority_producer_t;
+
+static void* priority_producer(void* arg)
+{
+    priority_producer_t* producer = arg;
+    for (size_t i = 1; i <= producer->messages; i++) {
+        producer->sent_at[i] = now_ns();
+        if (i % 100 != 0) {
+            channel_send(producer->bulk, (void*)i);
+        } else if (producer->control) {
+            channel_send(producer->control, (void*)i);
+        } else {
+            channel_send_priority(producer->bulk, (void*)i, producer->control_lane);
+        }
+    }
+    channel_send(producer->bulk, NULL);
+    return NULL;
+}
+
+// Control messages behind a bulk backlog: one FIFO, a second channel plus a select, and a priority channel
+static void bench_priority(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 1000000);
+    size_t capacity = arg_size(argc, argv, 1, 4096);
+    printf("priority: %zu messages (1%% control) through channels of %zu\n", messages, capacity);
+    uint64_t* sent_at = malloc((messages + 1) * sizeof(uint64_t));
+    static const char* names[] = {"single FIFO", "two channels + select", "priority lanes"};
+    for (int mode = 0; mode < 3; mode++) {
+        priority_producer_t producer = {mode == 2 ? channel_create_priority(capacity, 2) : channel_create(capacity),
+                                        mode == 1 ? channel_create(capacity) : NULL, mode == 2 ? 1 : 0, sent_at,
+                                        messages};
+        select_t cases[2] = {{producer.control, RECV, NULL, 0}, {producer.bulk, RECV, NULL, 0}};
+        pthread_t pid;
+        pthread_create(&pid, NULL, priority_producer, &producer);
+        uint64_t start = now_ns();
+        uint64_t control_latency = 0;
+        size_t controls = 0;
+        while (true) {
+            void* data = NULL;
+            if (producer.control) {
+                size_t index = 0;
+                channel_select(cases, 2, &index);
+                data = cases[index].data;
+            } else {
+                channel_receive(producer.bulk, &data);
+            }
+            if (data == NULL) {
+                break;
+            }
+            if ((size_t)data % 100 == 0) {
+                control_latency += now_ns() - sent_at[(size_t)data];
+                controls++;
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+        pthread_join(pid, NULL);
+        char label[64];
+        snprintf(label, sizeof(label), "%s (control %.1f us)", names[mode],
+                 (double)control_latency / (double)(controls ? controls : 1) / 1e3);
+        report(label, (double)messages, elapsed);
+        channel_close(producer.bulk);
+        channel_destroy(producer.bulk);
+        if (producer.control) {
+            channel_close(producer.control);
+            channel_destroy(producer.control);
+        }
+    }
+    free(sent_at);
+}
+
+// A consumer draining a backlog session by session: receive-and-requeue on a plain channel against
+// channel_receive_matching on a keyed channel; messages encode their session in the low byte
+static void bench_matching(int argc, char** argv)
+{
+    size_t capacity = arg_size(argc, argv, 0, 4096);
+    size_t sessions = arg_size(argc, argv, 1, 64);
+    size_t rounds = arg_size(argc, argv, 2, 20);
+    if (sessions == 0 || sessions > 256) {
+        sessions = 64;
+    }
+    printf("matching: %zu rounds of %zu messages over %zu sessions, drained one session message at a time\n", rounds,
+           capacity, sessions);
+    size_t* pending = calloc(sessions, sizeof(size_t));
+    for (int keyed = 0; keyed <= 1; keyed++) {
+        channel_t* channel = keyed ? channel_create_keyed(capacity) : channel_create(capacity);
+        size_t operations = 0;
+        uint64_t seed = 42;
+        uint64_t start = now_ns();
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < capacity; i++) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                size_t session = (size_t)(seed >> 33) % sessions;
+                pending[session]++;
+                void* message = (void*)((i << 8) | session);
+                if (keyed) {
+                    channel_send_keyed(channel, message, session);
+                } else {
+                    channel_send(channel, message);
+                }
+            }
+            size_t want = 0;
+            for (size_t left = capacity; left > 0; left--) {
+                while (pending[want] == 0) {
+                    want = (want + 1) % sessions;
+                }
+                void* data = NULL;
+                if (keyed) {
+                    channel_receive_matching(channel, want, &data);
+                    operations++;
+                } else {
+                    // Everything that is not for this session goes back to the end of the channel
+                    while (channel_receive(channel, &data) == SUCCESS && ((size_t)data & 0xff) != want) {
+                        channel_send(channel, data);
+                        operations += 2;
+                    }
+                    operations++;
+                }
+                pending[want]--;
+                want = (want + 1) % sessions;
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+        char label[64];
+        snprintf(label, sizeof(label), "%s (%.1f ops/msg)", keyed ? "receive_matching" : "receive + requeue",
+                 (double)operations / (double)(rounds * capacity));
+        report(label, (double)(rounds * capacity), elapsed);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+    free(pending);
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t messages;
+} sharded_producer_t;
+
+static void* sharded_producer(void* arg)
+{
+    sharded_producer_t* producer = arg;
+    for (size_t i = 1; i <= producer->messages; i++) {
+        channel_send(producer->channel, (void*)i);
+    }
+    return NULL;
+}
+
+// Producer scaling from 1 to max_producers threads into one consumer: a single channel against a sharded one
+static void bench_sharded(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 1000000);
+    size_t capacity = arg_size(argc, argv, 1, 1024);
+    size_t max_producers = arg_size(argc, argv, 2, 64);
+    size_t shards = arg_size(argc, argv, 3, 0);
+    printf("sharded: %zu messages from 1 to %zu producers, channels of %zu, %zu shard(s) (0: one per CPU)\n", messages,
+           max_producers, capacity, shards);
+    pthread_t* pids = malloc(max_producers * sizeof(pthread_t));
+    sharded_producer_t* producers = malloc(max_producers * sizeof(sharded_producer_t));
+    for (size_t count = 1; count <= max_producers; count *= 2) {
+        for (int sharded = 0; sharded <= 1; sharded++) {
+            channel_t* channel = sharded ? channel_create_sharded(capacity, shards, CHANNEL_RELAXED_ORDER)
+                                         : channel_create(capacity);
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < count; i++) {
+                producers[i] = (sharded_producer_t){channel, messages / count};
+                pthread_create(&pids[i], NULL, sharded_producer, &producers[i]);
+            }
+            void* data = NULL;
+            for (size_t i = 0; i < messages / count * count; i++) {
+                channel_receive(channel, &data);
+            }
+            uint64_t elapsed = now_ns() - start;
+            for (size_t i = 0; i < count; i++) {
+                pthread_join(pids[i], NULL);
+            }
+            char label[64];
+            snprintf(label, sizeof(label), "%2zu producer(s), %s", count, sharded ? "sharded" : "single channel");
+            report(label, (double)(messages / count * count), elapsed);
+            channel_close(channel);
+            channel_destroy(channel);
+        }
+    }
+    free(producers);
+    free(pids);
+}
+
+typedef struct {
+    channel_t* channel;
+    mailbox_node_t* nodes; // NULL for the plain channel, which sends the message index instead
+    size_t first;
+    size_t count;
+} mailbox_producer_t;
+
+static void* mailbox_producer(void* arg)
+{
+    mailbox_producer_t* producer = arg;
+    for (size_t i = producer->first; i < producer->first + producer->count; i++) {
+        channel_send(producer->channel, producer->nodes ? (void*)&producer->nodes[i] : (void*)(i + 1));
+    }
+    return NULL;
+}
+
+// Many producers and one consumer: channel_send on a bounded channel against an intrusive mailbox channel
+static void bench_mailbox(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 1000000);
+    size_t producers = arg_size(argc, argv, 1, 32);
+    size_t capacity = arg_size(argc, argv, 2, 1024);
+    if (producers == 0) {
+        producers = 32;
+    }
+    size_t per_producer = messages / producers;
+    printf("mailbox: %zu messages from %zu producers into one consumer (channel of %zu)\n", per_producer * producers,
+           producers, capacity);
+    mailbox_node_t* nodes = malloc(per_producer * producers * sizeof(mailbox_node_t));
+    pthread_t* pids = malloc(producers * sizeof(pthread_t));
+    mailbox_producer_t* args = malloc(producers * sizeof(mailbox_producer_t));
+    for (int mailbox = 0; mailbox <= 1; mailbox++) {
+        channel_t* channel = mailbox ? channel_create_mailbox() : channel_create(capacity);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < producers; i++) {
+            args[i] = (mailbox_producer_t){channel, mailbox ? nodes : NULL, i * per_producer, per_producer};
+            pthread_create(&pids[i], NULL, mailbox_producer, &args[i]);
+        }
+        void* data = NULL;
+        for (size_t i = 0; i < per_producer * producers; i++) {
+            channel_receive(channel, &data);
+        }
+        uint64_t elapsed = now_ns() - start;
+        for (size_t i = 0; i < producers; i++) {
+            pthread_join(pids[i], NULL);
+        }
+        report(mailbox ? "mailbox (wait-free send)" : "channel_send", (double)(per_producer * producers), elapsed);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+    free(args);
+    free(pids);
+    free(nodes);
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t messages;
+    size_t interval; // the intruder sends once every interval messages of the main producer, 0 for never
+    _Atomic size_t sent;
+    _Atomic bool done;
+} spsc_producer_t;
+
+static void* spsc_producer(void* arg)
+{
+    spsc_producer_t* producer = arg;
+    for (size_t i = 1; i <= producer->messages; i++) {
+        channel_send(producer->channel, (void*)i);
+        atomic_store_explicit(&producer->sent, i, memory_order_relaxed);
+    }
+    atomic_store(&producer->done, true);
+    return NULL;
+}
+
+// Occasionally sends from a second thread, which puts the channel back on the locked path each time
+static void* spsc_intruder(void* arg)
+{
+    spsc_producer_t* producer = arg;
+    size_t next = producer->interval;
+    while (!atomic_load(&producer->done)) {
+        if (atomic_load_explicit(&producer->sent, memory_order_relaxed) >= next) {
+            channel_send(producer->channel, NULL);
+            next += producer->interval;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// One producer and one consumer on a plain channel, alone (promoted to the lock-free path after
+// CHANNEL_SPSC_STREAK operations) and with a second producer that keeps demoting it
+static void bench_spsc(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 2000000);
+    size_t capacity = arg_size(argc, argv, 1, 1024);
+    size_t interval = arg_size(argc, argv, 2, 4096);
+    printf("spsc: %zu messages through a channel of %zu, second producer every %zu messages\n", messages, capacity,
+           interval);
+    for (int intruder = 0; intruder <= 1; intruder++) {
+        channel_t* channel = channel_create(capacity);
+        spsc_producer_t producer = {channel, messages, intruder ? interval : 0, 0, false};
+        pthread_t pids[2];
+        uint64_t start = now_ns();
+        pthread_create(&pids[0], NULL, spsc_producer, &producer);
+        if (intruder) {
+            pthread_create(&pids[1], NULL, spsc_intruder, &producer);
+        }
+        void* data = NULL;
+        size_t received = 0;
+        while (received < messages) {
+            channel_receive(channel, &data);
+            received += data != NULL;
+        }
+        uint64_t elapsed = now_ns() - start;
+        bool active = channel_spsc_active(channel);
+        pthread_join(pids[0], NULL);
+        if (intruder) {
+            pthread_join(pids[1], NULL);
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "%s (lock-free: %s)", intruder ? "+ second producer" : "1 -> 1",
+                 active ? "yes" : "no");
+        report(label, (double)messages, elapsed);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+}
+
+static void* backend_consumer(void* arg)
+{
+    sharded_producer_t* consumer = arg;
+    void* data = NULL;
+    for (size_t i = 0; i < consumer->messages; i++) {
+        channel_receive(consumer->channel, &data);
+    }
+    return NULL;
+}
+
+// The same producers -> consumers workload on channels configured through channel_create_ex, with 1 pair of threads
+// and then with pairs pairs
+static void bench_backends(int argc, char** argv)
+{
+    size_t messages = arg_size(argc, argv, 0, 1000000);
+    size_t capacity = arg_size(argc, argv, 1, 1024);
+    size_t pairs = arg_size(argc, argv, 2, 4);
+    printf("backends: %zu messages through channels of %zu, 1 and %zu producer/consumer pair(s)\n", messages, capacity,
+           pairs);
+    struct {
+        const char* name;
+        enum channel_backend backend;
+        enum channel_wait wait;
+    } configs[] = {{"ring", CHANNEL_BACKEND_RING, CHANNEL_WAIT_BLOCK},
+                   {"ring, yield", CHANNEL_BACKEND_RING, CHANNEL_WAIT_YIELD},
+                   {"spsc", CHANNEL_BACKEND_SPSC, CHANNEL_WAIT_BLOCK},
+                   {"mpmc", CHANNEL_BACKEND_MPMC, CHANNEL_WAIT_BLOCK},
+                   {"mpmc, yield", CHANNEL_BACKEND_MPMC, CHANNEL_WAIT_YIELD},
+                   {"sharded", CHANNEL_BACKEND_SHARDED, CHANNEL_WAIT_BLOCK}};
+    pthread_t* pids = malloc(2 * pairs * sizeof(pthread_t));
+    sharded_producer_t* ends = malloc(2 * pairs * sizeof(sharded_producer_t));
+    size_t counts[2] = {1, pairs};
+    for (size_t k = 0; k < (pairs > 1 ? 2 : 1); k++) {
+        size_t count = counts[k];
+        for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            // A single-producer single-consumer channel only makes sense with one pair
+            if (configs[c].backend == CHANNEL_BACKEND_SPSC && count > 1) {
+                continue;
+            }
+            channel_attr_t attr;
+            channel_attr_init(&attr);
+            attr.capacity = capacity;
+            attr.backend = configs[c].backend;
+            attr.wait = configs[c].wait;
+            attr.flags = CHANNEL_RELAXED_ORDER;
+            channel_t* channel = channel_create_ex(&attr);
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < count; i++) {
+                ends[i] = (sharded_producer_t){channel, messages / count};
+                ends[count + i] = (sharded_producer_t){channel, messages / count};
+                pthread_create(&pids[i], NULL, sharded_producer, &ends[i]);
+                pthread_create(&pids[count + i], NULL, backend_consumer, &ends[count + i]);
+            }
+            for (size_t i = 0; i < 2 * count; i++) {
+                pthread_join(pids[i], NULL);
+            }
+            uint64_t elapsed = now_ns() - start;
+            char label[64];
+            snprintf(label, sizeof(label), "%zu -> %zu, %s", count, count, configs[c].name);
+            report(label, (double)(messages / count * count), elapsed);
+            channel_close(channel);
+            channel_destroy(channel);
+        }
+    }
+    free(ends);
+    free(pids);
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t cases;
+    size_t rounds;
+    channel_t* reply;
+} select_pinger_t;
+
+// Sends to one channel at a time and waits for the reply, so the select on the other side sleeps every round
+static void* select_pinger(void* arg)
+{
+    select_pinger_t* pinger = arg;
+    void* data = NULL;
+    for (size_t i = 0; i < pinger->rounds; i++) {
+        channel_send(pinger->channels[(i * 7) % pinger->cases], "ping");
+        channel_receive(pinger->reply, &data);
+    }
+    return NULL;
+}
+
+// A select over cases channels of which only one holds a message, refilled before every select, non-blocking
+// receives polling an empty channel (both mostly read the channels' lock-free state), and a select that has to
+// sleep until another thread sends to one of the channels
+static void bench_select(int argc, char** argv)
+{
+    size_t rounds = arg_size(argc, argv, 0, 1000000);
+    size_t cases = arg_size(argc, argv, 1, 100);
+    printf("select: %zu selects over %zu channels with one ready case, %zu polls of an empty channel, %zu waiting "
+           "selects\n", rounds, cases, rounds, rounds / 10);
+    channel_t** channels = malloc(cases * sizeof(channel_t*));
+    select_t* list = malloc(cases * sizeof(select_t));
+    for (size_t i = 0; i < cases; i++) {
+        channels[i] = channel_create(1);
+        list[i] = (select_t){.channel = channels[i], .dir = RECV};
+    }
+    size_t index = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < rounds; i++) {
+        channel_non_blocking_send(channels[(i * 7) % cases], "message");
+        channel_select(list, cases, &index);
+    }
+    report("wide select", (double)rounds, now_ns() - start);
+    void* data = NULL;
+    start = now_ns();
+    for (size_t i = 0; i < rounds; i++) {
+        channel_non_blocking_receive(channels[0], &data);
+    }
+    report("empty poll", (double)rounds, now_ns() - start);
+    channel_t* reply = channel_create(1);
+    select_pinger_t pinger = {channels, cases, rounds / 10, reply};
+    pthread_t pid;
+    start = now_ns();
+    pthread_create(&pid, NULL, select_pinger, &pinger);
+    for (size_t i = 0; i < pinger.rounds; i++) {
+        channel_select(list, cases, &index);
+        channel_send(reply, "pong");
+    }
+    pthread_join(pid, NULL);
+    report("waiting select", (double)pinger.rounds, now_ns() - start);
+    channel_close(reply);
+    channel_destroy(reply);
+    for (size_t i = 0; i < cases; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    free(list);
+    free(channels);
+}
+
+static bench_t benches[] = {{"numa", "[threads] [buffer_size] [duration_usec]", bench_numa},
+                           {"memory", "[channels] [buffer_size]", bench_memory},
+                           {"shared", "[messages] [elem_size] [capacity]", bench_shared},
+                           {"wordcount", "[megabytes] [chunk_size]", bench_wordcount},
+                           {"snapshot", "[channels] [messages_per_channel] [elem_size]", bench_snapshot},
+                           {"replay", "[trace_file] [time_scale] [ring|unbounded|mapped|spill]", bench_replay},
+                           {"broadcast", "[subscribers] [messages] [capacity]", bench_broadcast},
+                           {"conflate", "[topology_file] [runs]", bench_conflate},
+                           {"overflow", "[messages] [capacity]", bench_overflow},
+                           {"codel", "[messages] [capacity] [target_ns]", bench_codel},
+                           {"priority", "[messages] [capacity]", bench_priority},
+                           {"matching", "[capacity] [sessions] [rounds]", bench_matching},
+                           {"sharded", "[messages] [capacity] [max_producers] [shards]", bench_sharded},
+                           {"mailbox", "[messages] [producers] [capacity]", bench_mailbox},
+                           {"spsc", "[messages] [capacity] [intruder_interval]", bench_spsc},
+                           {"backends", "[messages] [capacity] [pairs]", bench_backends},
+                           {"select", "[rounds] [cases]", bench_select},
+};
+
+static size_t num_benches = sizeof(benches)/sizeof(benches[0]);
+
+int main(int argc, char** argv)
+{
+    if (argc == 1) {
+        for (size_t i = 0; i < num_benches; i++) {
+            benches[i].bench(0, NULL);
+        }
+        return 0;
+    }
+    for (size_t i = 0; i < num_benches; i++) {
+        if (strcmp(argv[1], benches[i].name) == 0) {
+            benches[i].bench(argc - 2, argv + 2);
+            return 0;
+        }
+    }
+    printf("Unknown benchmark: %s\nAvailable benchmarks:\n", argv[1]);
+    for (size_t i = 0; i < num_benches; i++) {
+        printf("  %s %s\n", benches[i].name, benches[i].usage);
+    }
+    return 1;
+}
@@ -0,0 +1,239 @@
+#include <stdatomic.h>
+#include "broadcast.h"
+
+struct broadcast {
+    // Must stay the first member: subscribers only know the ring, and broadcast_cursor_moved maps it back
+    buffer_shared_ring_t ring;
+    // Serializes senders and protects the fields below
+    pthread_mutex_t lock;
+    list_t* subscribers; // subscriber channels, whose cursors gate the senders
+    size_t gate;         // cursor of the slowest subscriber when last looked at (a lower bound)
+    bool open;
+    // Senders waiting for the slowest subscriber sleep on room; waiting counts them so subscribers
+    // only take room_lock when someone actually waits
+    pthread_mutex_t room_lock;
+    pthread_cond_t room;
+    _Atomic size_t waiting;
+};
+
+// Creates a broadcast channel whose ring holds capacity messages
+broadcast_t* broadcast_create(size_t capacity)
+{
+    if (capacity == 0 || capacity > SIZE_MAX / sizeof(void*)) {
+        return NULL;
+    }
+    broadcast_t* broadcast = malloc(sizeof(broadcast_t));
+    if (!broadcast) {
+        return NULL;
+    }
+    broadcast->ring.slots = malloc(capacity * sizeof(void*));
+    broadcast->subscribers = list_create();
+    if (!broadcast->ring.slots || !broadcast->subscribers) {
+        free(broadcast->ring.slots);
+        if (broadcast->subscribers) {
+            list_destroy(broadcast->subscribers);
+        }
+        free(broadcast);
+        return NULL;
+    }
+    broadcast->ring.capacity = capacity;
+    atomic_init(&broadcast->ring.published, 0);
+    pthread_mutex_init(&broadcast->lock, NULL);
+    broadcast->gate = 0;
+    broadcast->open = true;
+    pthread_mutex_init(&broadcast->room_lock, NULL);
+    pthread_cond_init(&broadcast->room, NULL);
+    atomic_init(&broadcast->waiting, 0);
+    return broadcast;
+}
+
+// Wakes every sender waiting for room
+static void broadcast_wake_senders(broadcast_t* broadcast)
+{
+    if (atomic_load(&broadcast->waiting) > 0) {
+        pthread_mutex_lock(&broadcast->room_lock);
+        pthread_cond_broadcast(&broadcast->room);
+        pthread_mutex_unlock(&broadcast->room_lock);
+    }
+}
+
+// Called by channel.c when a subscriber's cursor moved, so a producer waiting for room can re-check
+void broadcast_cursor_moved(buffer_shared_ring_t* ring)
+{
+    broadcast_wake_senders((broadcast_t*)ring);
+}
+
+// Returns the cursor of the slowest subscriber, or the publish position when there are none
+// Must be called with the broadcast lock held
+static size_t broadcast_slowest(broadcast_t* broadcast)
+{
+    size_t slowest = atomic_load(&broadcast->ring.published);
+    list_node_t* node = list_head(broadcast->subscribers);
+    while (node != NULL) {
+        size_t cursor = atomic_load(&((channel_t*)node->data)->buffer->cursor);
+        if (cursor < slowest) {
+            slowest = cursor;
+        }
+        node = node->next;
+    }
+    return slowest;
+}
+
+// Adds a subscriber that receives every message sent from now on
+channel_t* broadcast_subscribe(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    channel_t* subscriber = NULL;
+    if (broadcast->open) {
+        // Senders are serialized by the lock, so nothing is published while the cursor is placed
+        subscriber = channel_create_cursor(&broadcast->ring, atomic_load(&broadcast->ring.published));
+    }
+    if (subscriber && !list_insert(broadcast->subscribers, subscriber)) {
+        channel_close(subscriber);
+        channel_destroy(subscriber);
+        subscriber = NULL;
+    }
+    pthread_mutex_unlock(&broadcast->lock);
+    return subscriber;
+}
+
+// Removes a subscriber, closing it and releasing the senders it was holding back
+enum channel_status broadcast_unsubscribe(broadcast_t* broadcast, channel_t* subscriber)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    if (!broadcast->open) {
+        pthread_mutex_unlock(&broadcast->lock);
+        return CLOSED_ERROR;
+    }
+    list_node_t* node = list_find(broadcast->subscribers, subscriber);
+    if (!node) {
+        pthread_mutex_unlock(&broadcast->lock);
+        return GENERIC_ERROR;
+    }
+    list_remove(broadcast->subscribers, node);
+    // Closing under the lock guarantees no sender overwrites a slot the subscriber is still reading
+    channel_close(subscriber);
+    pthread_mutex_unlock(&broadcast->lock);
+    broadcast_wake_senders(broadcast);
+    return SUCCESS;
+}
+
+// Returns the current number of subscribers
+size_t broadcast_subscribers(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    size_t count = list_count(broadcast->subscribers);
+    pthread_mutex_unlock(&broadcast->lock);
+    return count;
+}
+
+// Publishes data into the shared ring once and wakes the subscribers that were waiting for it
+static enum channel_status broadcast_publish(broadcast_t* broadcast, void* data, bool blocking)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    size_t capacity = broadcast->ring.capacity;
+    size_t published = atomic_load(&broadcast->ring.published);
+    while (true) {
+        if (!broadcast->open) {
+            pthread_mutex_unlock(&broadcast->lock);
+            return CLOSED_ERROR;
+        }
+        // The cached gate is only refreshed when it says the ring is full, so uncontended sends
+        // do not touch the subscribers' cursors
+        if (published - broadcast->gate < capacity) {
+            break;
+        }
+        broadcast->gate = broadcast_slowest(broadcast);
+        if (published - broadcast->gate < capacity) {
+            break;
+        }
+        if (!blocking) {
+            pthread_mutex_unlock(&broadcast->lock);
+            return CHANNEL_FULL;
+        }
+
+        // Announce the wait before looking at the cursors again, so a subscriber that moves now sees it
+        pthread_mutex_lock(&broadcast->room_lock);
+        atomic_fetch_add(&broadcast->waiting, 1);
+        broadcast->gate = broadcast_slowest(broadcast);
+        bool full = published - broadcast->gate >= capacity;
+        // Subscribers may join or leave, and the channel may close, while we wait
+        pthread_mutex_unlock(&broadcast->lock);
+        if (full) {
+            pthread_cond_wait(&broadcast->room, &broadcast->room_lock);
+        }
+        atomic_fetch_sub(&broadcast->waiting, 1);
+        pthread_mutex_unlock(&broadcast->room_lock);
+        pthread_mutex_lock(&broadcast->lock);
+        published = atomic_load(&broadcast->ring.published);
+    }
+
+    broadcast->ring.slots[published % capacity] = data;
+    atomic_store(&broadcast->ring.published, published + 1);
+
+    // A subscriber with a backlog cannot be waiting, so only the ones that had caught up need a wakeup
+    list_node_t* node = list_head(broadcast->subscribers);
+    while (node != NULL) {
+        channel_t* subscriber = node->data;
+        if (atomic_load(&subscriber->buffer->cursor) == published) {
+            channel_notify_published(subscriber);
+        }
+        node = node->next;
+    }
+    pthread_mutex_unlock(&broadcast->lock);
+    return SUCCESS;
+}
+
+// Sends data to every subscriber, waiting while the slowest subscriber is a full ring behind
+enum channel_status broadcast_send(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish(broadcast, data, true);
+}
+
+// Sends data to every subscriber, or returns CHANNEL_FULL if the slowest subscriber is a full ring behind
+enum channel_status broadcast_non_blocking_send(broadcast_t* broadcast, void* data)
+{
+    return broadcast_publish(broadcast, data, false);
+}
+
+// Closes the broadcast channel and every subscriber
+enum channel_status broadcast_close(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    if (!broadcast->open) {
+        pthread_mutex_unlock(&broadcast->lock);
+        return CLOSED_ERROR;
+    }
+    broadcast->open = false;
+    list_node_t* node = list_head(broadcast->subscribers);
+    while (node != NULL) {
+        channel_close((channel_t*)node->data);
+        node = node->next;
+    }
+    pthread_mutex_unlock(&broadcast->lock);
+    broadcast_wake_senders(broadcast);
+    return SUCCESS;
+}
+
+// Frees the broadcast channel together with the subscribers that are still attached
+enum channel_status broadcast_destroy(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    if (broadcast->open) {
+        pthread_mutex_unlock(&broadcast->lock);
+        return DESTROY_ERROR;
+    }
+    list_node_t* node = list_head(broadcast->subscribers);
+    while (node != NULL) {
+        channel_destroy((channel_t*)node->data);
+        node = node->next;
+    }
+    pthread_mutex_unlock(&broadcast->lock);
+    list_destroy(broadcast->subscribers);
+    pthread_mutex_destroy(&broadcast->lock);
+    pthread_mutex_destroy(&broadcast->room_lock);
+    pthread_cond_destroy(&broadcast->room);
+    free(broadcast->ring.slots);
+    free(broadcast);
+    return SUCCESS;
+}
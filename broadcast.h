@@ -0,0 +1,41 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+#include <stddef.h>
+#include "channel.h"
+
+// Broadcast channel: every message is written once into a ring shared by all subscribers, and each
+// subscriber reads it through its own cursor. The producer is held back by the slowest subscriber only.
+// Subscribers are regular (receive-only) channels, so they work with channel_receive,
+// channel_non_blocking_receive, channel_readable_fd and as RECV cases of channel_select
+// Each subscriber is meant to be drained by a single consumer, like a Disruptor event processor
+typedef struct broadcast broadcast_t;
+
+// Creates a broadcast channel whose ring holds capacity messages
+// Returns NULL if capacity is 0 or on allocation failure
+broadcast_t* broadcast_create(size_t capacity);
+// Adds a subscriber that receives every message sent from now on
+// Subscribers can join at any time; sending to a subscriber fails with GENERIC_ERROR
+// Returns NULL if the broadcast channel is closed or on allocation failure
+channel_t* broadcast_subscribe(broadcast_t* broadcast);
+// Removes a subscriber: it is closed, stops holding back the producer and may then be destroyed by the caller
+// with channel_destroy once no thread uses it
+// Returns SUCCESS, CLOSED_ERROR if the broadcast channel is closed, or GENERIC_ERROR if it is not a subscriber
+enum channel_status broadcast_unsubscribe(broadcast_t* broadcast, channel_t* subscriber);
+// Returns the current number of subscribers
+size_t broadcast_subscribers(broadcast_t* broadcast);
+// Sends data to every subscriber, waiting while the slowest subscriber is a full ring behind
+// Messages sent while there are no subscribers are dropped
+// Returns SUCCESS, CLOSED_ERROR if the broadcast channel is closed, or GENERIC_ERROR on any other error
+enum channel_status broadcast_send(broadcast_t* broadcast, void* data);
+// Like broadcast_send, but returns CHANNEL_FULL instead of waiting for the slowest subscriber
+enum channel_status broadcast_non_blocking_send(broadcast_t* broadcast, void* data);
+// Closes the broadcast channel and every subscriber; blocked senders and receivers return CLOSED_ERROR
+// Returns SUCCESS, or CLOSED_ERROR if it is already closed
+enum channel_status broadcast_close(broadcast_t* broadcast);
+// Frees the broadcast channel together with the subscribers that are still attached
+// Returns SUCCESS, or DESTROY_ERROR if the broadcast channel is still open
+enum channel_status broadcast_destroy(broadcast_t* broadcast);
+
+// Called by channel.c when a subscriber's cursor moved, so a producer waiting for room can re-check
+void broadcast_cursor_moved(buffer_shared_ring_t* ring);
+#endif // BROADCAST_H
@@ -1,5 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
 #include "buffer.h"
 
+// Segment file of a spill buffer: records are written at write_pos and read back from read_pos
+struct buffer_spill_segment {
+    struct buffer_spill_segment* next;
+    char* records;
+    size_t read_pos;
+    size_t write_pos;
+};
+
+// Pending value of a conflating buffer
+struct buffer_conflate_entry {
+    uint64_t key;
+    void* value;
+};
+
+// Conflating buffer state: a FIFO ring of pending entries and an open-addressing index from key to entry
+// Index slots hold the entry's sequence number plus one (0 marks a free slot); entry n lives in
+// entries[n & entry_mask] and the oldest pending entry is number head
+struct buffer_conflate {
+    buffer_key_fn_t key;
+    buffer_release_fn_t release;
+    struct buffer_conflate_entry* entries;
+    size_t entry_mask;
+    size_t head;
+    size_t* index;
+    size_t index_mask;
+};
+
+// Pending value of a keyed buffer, linked both in arrival order and in its key's queue
+struct buffer_keyed_entry {
+    uint64_t key;
+    void* value;
+    struct buffer_keyed_entry* prev;
+    struct buffer_keyed_entry* next;
+    struct buffer_keyed_entry* next_same; // next entry with the same key (also links the free list)
+};
+
+// FIFO of the pending entries with one key; a slot with no head is free
+struct buffer_keyed_queue {
+    uint64_t key;
+    struct buffer_keyed_entry* head;
+    struct buffer_keyed_entry* tail;
+};
+
+// Keyed buffer state: capacity preallocated entries, the arrival-order list, and an open-addressing index
+// from key to its queue sized for at least twice as many keys as the buffer can hold
+struct buffer_keyed {
+    struct buffer_keyed_entry* entries;
+    struct buffer_keyed_entry* free;
+    struct buffer_keyed_entry* head;
+    struct buffer_keyed_entry* tail;
+    struct buffer_keyed_queue* index;
+    size_t index_mask;
+};
+
+// Initial number of entries of a conflating buffer; both tables double when the entries fill up
+#define BUFFER_CONFLATE_INITIAL 8
+
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity)
 {
@@ -9,14 +72,789 @@ buffer_t* buffer_create(size_t capacity)
     buffer->next = 0;
     buffer->capacity = capacity;
     buffer->data = data;
+    buffer->kind = BUFFER_RING;
+    buffer->high_water = 0;
+    buffer->segment_size = 0;
+    buffer->tail_pos = 0;
+    buffer->head_segment = NULL;
+    buffer->tail_segment = NULL;
+    buffer->segment_cache = NULL;
+    buffer->cached_segments = 0;
+    buffer->touched = 0;
+    buffer->released = 0;
+    buffer->ring = NULL;
+    buffer->spill_head = NULL;
+    buffer->spill_tail = NULL;
+    buffer->spill_records = 0;
+    buffer->spill_codec = (buffer_spill_codec_t){sizeof(void*), NULL, NULL};
+    buffer->spilled = 0;
+    buffer->spill_dir = NULL;
+    buffer->shared = NULL;
+    atomic_init(&buffer->cursor, 0);
+    buffer->conflate = NULL;
+    buffer->conflated = 0;
+    buffer->stamps = NULL;
+    buffer->sojourn = 0;
+    buffer->lanes = NULL;
+    buffer->lane_count = 0;
+    buffer->lane_bits = 0;
+    buffer->keyed = NULL;
+    return buffer;
+}
+
+// Creates an unbounded buffer that grows in segments of segment_size slots
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_segmented(size_t segment_size)
+{
+    if (segment_size == 0) {
+        return NULL;
+    }
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->kind = BUFFER_SEGMENTED;
+    buffer->capacity = SIZE_MAX;
+    buffer->segment_size = segment_size;
+    return buffer;
+}
+
+// Creates a buffer with the given capacity whose storage is reserved with mmap
+// Pages are committed on first touch and released with MADV_DONTNEED when the buffer drains
+buffer_t* buffer_create_mapped(size_t capacity, int flags)
+{
+    if (capacity == 0 || capacity > SIZE_MAX / sizeof(void*)) {
+        return NULL;
+    }
+    void* data = mmap(NULL, capacity * sizeof(void*), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    if (flags & BUFFER_MAP_HUGEPAGE) {
+        // Only advice: kernels without THP support simply ignore it
+        madvise(data, capacity * sizeof(void*), MADV_HUGEPAGE);
+    }
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        munmap(data, capacity * sizeof(void*));
+        return NULL;
+    }
+    free(buffer->data);
+    buffer->kind = BUFFER_MAPPED;
+    buffer->capacity = capacity;
+    buffer->data = data;
+    return buffer;
+}
+
+// Creates a buffer that keeps up to capacity values in memory and spills the rest to disk
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_spill(size_t capacity, size_t segment_records, const char* dir,
+                              const buffer_spill_codec_t* codec)
+{
+    if (codec && (codec->record_size == 0 || !codec->encode || !codec->decode)) {
+        return NULL;
+    }
+    size_t record_size = codec ? codec->record_size : sizeof(void*);
+    if (segment_records == 0 || segment_records > SIZE_MAX / record_size) {
+        return NULL;
+    }
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->ring = buffer_create(capacity);
+    buffer->spill_dir = strdup(dir ? dir : "/tmp");
+    if (!buffer->ring || !buffer->spill_dir) {
+        buffer_free(buffer);
+        return NULL;
+    }
+    buffer->kind = BUFFER_SPILL;
+    buffer->capacity = SIZE_MAX;
+    buffer->spill_records = segment_records;
+    if (codec) {
+        buffer->spill_codec = *codec;
+    }
+    return buffer;
+}
+
+// Creates a read-only buffer over a shared ring that starts reading at value number start
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_cursor(buffer_shared_ring_t* shared, size_t start)
+{
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->kind = BUFFER_CURSOR;
+    buffer->capacity = SIZE_MAX;
+    buffer->shared = shared;
+    atomic_init(&buffer->cursor, start);
+    return buffer;
+}
+
+// Creates an unbounded buffer that holds at most one value per key
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_conflating(buffer_key_fn_t key, buffer_release_fn_t release)
+{
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    struct buffer_conflate* conflate = calloc(1, sizeof(struct buffer_conflate));
+    if (conflate) {
+        conflate->entries = malloc(BUFFER_CONFLATE_INITIAL * sizeof(struct buffer_conflate_entry));
+        conflate->index = calloc(2 * BUFFER_CONFLATE_INITIAL, sizeof(size_t));
+    }
+    buffer->conflate = conflate;
+    if (!conflate || !conflate->entries || !conflate->index) {
+        buffer_free(buffer);
+        return NULL;
+    }
+    conflate->key = key;
+    conflate->release = release;
+    conflate->entry_mask = BUFFER_CONFLATE_INITIAL - 1;
+    conflate->index_mask = 2 * BUFFER_CONFLATE_INITIAL - 1;
+    buffer->kind = BUFFER_CONFLATING;
+    buffer->capacity = SIZE_MAX;
     return buffer;
 }
 
+// Creates a buffer of the given capacity whose values are added with a priority below lanes
+// Every lane can hold the whole capacity; buffer_add uses priority 0, the lowest
+buffer_t* buffer_create_priority(size_t capacity, size_t lanes)
+{
+    if (lanes == 0 || lanes > BUFFER_PRIORITY_MAX_LANES) {
+        return NULL;
+    }
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->kind = BUFFER_PRIORITY;
+    buffer->capacity = capacity;
+    buffer->lanes = calloc(lanes, sizeof(buffer_t*));
+    if (!buffer->lanes) {
+        buffer_free(buffer);
+        return NULL;
+    }
+    buffer->lane_count = lanes;
+    for (size_t i = 0; i < lanes; i++) {
+        buffer->lanes[i] = buffer_create(capacity);
+        if (!buffer->lanes[i]) {
+            buffer_free(buffer);
+            return NULL;
+        }
+    }
+    return buffer;
+}
+
+// Creates a buffer of the given capacity whose values carry a key
+// buffer_add uses key 0
+buffer_t* buffer_create_keyed(size_t capacity)
+{
+    if (capacity > SIZE_MAX / 4 / sizeof(struct buffer_keyed_entry)) {
+        return NULL;
+    }
+    buffer_t* buffer = buffer_create(0);
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->kind = BUFFER_KEYED;
+    buffer->capacity = capacity;
+    size_t slots = 2;
+    while (slots < 2 * capacity) {
+        slots *= 2;
+    }
+    struct buffer_keyed* keyed = calloc(1, sizeof(struct buffer_keyed));
+    if (keyed) {
+        keyed->entries = malloc((capacity > 0 ? capacity : 1) * sizeof(struct buffer_keyed_entry));
+        keyed->index = calloc(slots, sizeof(struct buffer_keyed_queue));
+    }
+    buffer->keyed = keyed;
+    if (!keyed || !keyed->entries || !keyed->index) {
+        buffer_free(buffer);
+        return NULL;
+    }
+    keyed->index_mask = slots - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        keyed->entries[i].next_same = keyed->free;
+        keyed->free = &keyed->entries[i];
+    }
+    return buffer;
+}
+
+// Starts recording the enqueue time of every value added to a ring (or mapped ring)
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR for other kinds or on allocation failure
+enum buffer_status buffer_enable_timestamps(buffer_t* buffer)
+{
+    if ((buffer->kind != BUFFER_RING && buffer->kind != BUFFER_MAPPED) || buffer->capacity == 0) {
+        return BUFFER_ERROR;
+    }
+    if (buffer->stamps) {
+        return BUFFER_SUCCESS;
+    }
+    // calloc leaves large tables to lazily zeroed pages, so a mapped ring still only commits what it uses
+    buffer->stamps = calloc(buffer->capacity, sizeof(uint64_t));
+    if (!buffer->stamps) {
+        return BUFFER_ERROR;
+    }
+    uint64_t now = buffer_now();
+    for (size_t i = 0; i < buffer->size; i++) {
+        buffer->stamps[(buffer->next + i) % buffer->capacity] = now;
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Returns the clock used for timestamps, in nanoseconds (CLOCK_MONOTONIC)
+uint64_t buffer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Creates and maps a new, already unlinked, segment file
+static struct buffer_spill_segment* spill_segment_create(buffer_t* buffer)
+{
+    struct buffer_spill_segment* segment = malloc(sizeof(struct buffer_spill_segment));
+    char* path = malloc(strlen(buffer->spill_dir) + sizeof("/channel-spill-XXXXXX"));
+    if (!segment || !path) {
+        free(segment);
+        free(path);
+        return NULL;
+    }
+    sprintf(path, "%s/channel-spill-XXXXXX", buffer->spill_dir);
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        // The mapping keeps the file alive; the kernel deletes it once it is unmapped
+        unlink(path);
+    }
+    free(path);
+    size_t bytes = buffer->spill_records * buffer->spill_codec.record_size;
+    void* records = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, (off_t)bytes) == 0) {
+        records = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (records == MAP_FAILED) {
+        free(segment);
+        return NULL;
+    }
+    segment->next = NULL;
+    segment->records = records;
+    segment->read_pos = 0;
+    segment->write_pos = 0;
+    return segment;
+}
+
+static void spill_segment_free(buffer_t* buffer, struct buffer_spill_segment* segment)
+{
+    munmap(segment->records, buffer->spill_records * buffer->spill_codec.record_size);
+    free(segment);
+}
+
+static enum buffer_status spill_add(buffer_t* buffer, void* data)
+{
+    // Values only go to memory while nothing is on disk, so everything in the ring is older than
+    // everything spilled and draining the ring first keeps FIFO order
+    if (buffer->spilled == 0 && buffer_add(buffer->ring, data) == BUFFER_SUCCESS) {
+        buffer->size++;
+        return BUFFER_SUCCESS;
+    }
+    struct buffer_spill_segment* tail = buffer->spill_tail;
+    if (!tail || tail->write_pos == buffer->spill_records) {
+        struct buffer_spill_segment* segment = spill_segment_create(buffer);
+        if (!segment) {
+            return BUFFER_ERROR;
+        }
+        if (tail) {
+            tail->next = segment;
+        } else {
+            buffer->spill_head = segment;
+        }
+        buffer->spill_tail = segment;
+        tail = segment;
+    }
+    const buffer_spill_codec_t* codec = &buffer->spill_codec;
+    char* record = tail->records + tail->write_pos++ * codec->record_size;
+    if (codec->encode) {
+        codec->encode(data, record);
+    } else {
+        memcpy(record, &data, sizeof(void*));
+    }
+    if (tail->write_pos == buffer->spill_records) {
+        // A full segment is only read again once the backlog ahead of it drains: drop its pages from
+        // our resident set and leave them to the page cache and writeback
+        madvise(tail->records, buffer->spill_records * codec->record_size, MADV_DONTNEED);
+    }
+    buffer->spilled++;
+    buffer->size++;
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status spill_remove(buffer_t* buffer, void** data)
+{
+    if (buffer_remove(buffer->ring, data) == BUFFER_SUCCESS) {
+        buffer->size--;
+        return BUFFER_SUCCESS;
+    }
+    struct buffer_spill_segment* head = buffer->spill_head;
+    if (!head || head->read_pos == head->write_pos) {
+        return BUFFER_ERROR;
+    }
+    const buffer_spill_codec_t* codec = &buffer->spill_codec;
+    const char* record = head->records + head->read_pos++ * codec->record_size;
+    if (codec->decode) {
+        *data = codec->decode(record);
+    } else {
+        memcpy(data, record, sizeof(void*));
+    }
+    buffer->spilled--;
+    buffer->size--;
+    // Consumed segments are deleted; a partially written tail segment stays until it is drained too
+    if (head->read_pos == buffer->spill_records || buffer->spilled == 0) {
+        buffer->spill_head = head->next;
+        if (buffer->spill_tail == head) {
+            buffer->spill_tail = NULL;
+        }
+        spill_segment_free(buffer, head);
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Rewinds a drained mapped buffer and hands the pages it touched back to the kernel
+// Small working sets are kept resident to avoid a syscall on every drain
+static void mapped_drained(buffer_t* buffer)
+{
+    buffer->next = 0;
+    buffer->released = 0;
+    size_t bytes = buffer->touched * sizeof(void*);
+    if (bytes >= BUFFER_MAP_RELEASE_BYTES) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        madvise(buffer->data, (bytes + page - 1) & ~(page - 1), MADV_DONTNEED);
+        buffer->touched = 0;
+    }
+}
+
+// Hands the whole pages behind the head of a mapped buffer back to the kernel once the slots consumed since the
+// last release span BUFFER_MAP_RELEASE_BYTES, so a buffer that never drains still only keeps its backlog resident
+static void mapped_consumed(buffer_t* buffer)
+{
+    size_t from = buffer->released;
+    size_t to = buffer->next;
+    size_t consumed = to >= from ? to - from : buffer->capacity - from + to;
+    // The slots just behind the head are only free if the tail has not wrapped around into them again
+    if (consumed * sizeof(void*) < BUFFER_MAP_RELEASE_BYTES || consumed > buffer->capacity - buffer->size) {
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char* data = (char*)buffer->data;
+    if (to < from) {
+        // The head wrapped: everything from the last release to the end of the ring is consumed
+        madvise(data + from * sizeof(void*), (buffer->capacity - from) * sizeof(void*), MADV_DONTNEED);
+        from = 0;
+    }
+    // The page holding the head may still hold values, so the release stops at the page boundary before it
+    size_t end = (to * sizeof(void*)) & ~(page - 1);
+    if (end > from * sizeof(void*)) {
+        madvise(data + from * sizeof(void*), end - from * sizeof(void*), MADV_DONTNEED);
+    }
+    buffer->released = end / sizeof(void*);
+}
+
+// Takes a segment from the cache, or allocates one when the cache is empty
+static buffer_segment_t* segment_get(buffer_t* buffer)
+{
+    buffer_segment_t* segment = buffer->segment_cache;
+    if (segment) {
+        buffer->segment_cache = segment->next;
+        buffer->cached_segments--;
+    } else {
+        segment = malloc(sizeof(buffer_segment_t) + buffer->segment_size * sizeof(void*));
+        if (!segment) {
+            return NULL;
+        }
+    }
+    segment->next = NULL;
+    return segment;
+}
+
+// Returns a drained segment to the cache, freeing it once the cache is full
+static void segment_put(buffer_t* buffer, buffer_segment_t* segment)
+{
+    if (buffer->cached_segments >= BUFFER_SEGMENT_CACHE_MAX) {
+        free(segment);
+        return;
+    }
+    segment->next = buffer->segment_cache;
+    buffer->segment_cache = segment;
+    buffer->cached_segments++;
+}
+
+static enum buffer_status segmented_add(buffer_t* buffer, void* data)
+{
+    if (!buffer->tail_segment || buffer->tail_pos == buffer->segment_size) {
+        buffer_segment_t* segment = segment_get(buffer);
+        if (!segment) {
+            return BUFFER_ERROR;
+        }
+        if (buffer->tail_segment) {
+            buffer->tail_segment->next = segment;
+        } else {
+            buffer->head_segment = segment;
+            buffer->next = 0;
+        }
+        buffer->tail_segment = segment;
+        buffer->tail_pos = 0;
+    }
+    buffer->tail_segment->slots[buffer->tail_pos++] = data;
+    buffer->size++;
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status segmented_remove(buffer_t* buffer, void** data)
+{
+    if (buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    buffer_segment_t* head = buffer->head_segment;
+    *data = head->slots[buffer->next++];
+    buffer->size--;
+    if (buffer->size == 0) {
+        // Keep the last segment in place and rewind it
+        buffer->next = 0;
+        buffer->tail_pos = 0;
+    } else if (buffer->next == buffer->segment_size) {
+        buffer->head_segment = head->next;
+        buffer->next = 0;
+        segment_put(buffer, head);
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Scrambles a key so that sequential keys spread over an index
+static size_t buffer_mix_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+// Home slot of a key in the conflation index
+static size_t conflate_slot(struct buffer_conflate* conflate, uint64_t key)
+{
+    return buffer_mix_key(key) & conflate->index_mask;
+}
+
+// Returns the index slot of the entry with the given key or, if the key is not pending, the free slot
+// where it would go
+static size_t conflate_find(struct buffer_conflate* conflate, uint64_t key)
+{
+    size_t slot = conflate_slot(conflate, key);
+    while (conflate->index[slot] != 0 &&
+           conflate->entries[(conflate->index[slot] - 1) & conflate->entry_mask].key != key) {
+        slot = (slot + 1) & conflate->index_mask;
+    }
+    return slot;
+}
+
+// Doubles the entry ring and the index, keeping the pending entries in order
+static enum buffer_status conflate_grow(buffer_t* buffer)
+{
+    struct buffer_conflate* conflate = buffer->conflate;
+    size_t entries = (conflate->entry_mask + 1) * 2;
+    struct buffer_conflate_entry* grown = malloc(entries * sizeof(struct buffer_conflate_entry));
+    size_t* index = calloc(2 * entries, sizeof(size_t));
+    if (!grown || !index) {
+        free(grown);
+        free(index);
+        return BUFFER_ERROR;
+    }
+    for (size_t i = 0; i < buffer->size; i++) {
+        grown[i] = conflate->entries[(conflate->head + i) & conflate->entry_mask];
+    }
+    free(conflate->entries);
+    free(conflate->index);
+    conflate->entries = grown;
+    conflate->entry_mask = entries - 1;
+    conflate->index = index;
+    conflate->index_mask = 2 * entries - 1;
+    conflate->head = 0;
+    for (size_t i = 0; i < buffer->size; i++) {
+        conflate->index[conflate_find(conflate, grown[i].key)] = i + 1;
+    }
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status conflating_add(buffer_t* buffer, void* data)
+{
+    struct buffer_conflate* conflate = buffer->conflate;
+    uint64_t key = conflate->key ? conflate->key(data) : 0;
+    size_t slot = conflate_find(conflate, key);
+    if (conflate->index[slot] != 0) {
+        // The key is pending: the new value takes the old one's place in line
+        struct buffer_conflate_entry* entry = &conflate->entries[(conflate->index[slot] - 1) & conflate->entry_mask];
+        void* replaced = entry->value;
+        entry->value = data;
+        buffer->conflated++;
+        if (conflate->release) {
+            conflate->release(replaced);
+        }
+        return BUFFER_SUCCESS;
+    }
+    if (buffer->size > conflate->entry_mask) {
+        if (conflate_grow(buffer) == BUFFER_ERROR) {
+            return BUFFER_ERROR;
+        }
+        slot = conflate_find(conflate, key);
+    }
+    size_t seq = conflate->head + buffer->size;
+    conflate->entries[seq & conflate->entry_mask] = (struct buffer_conflate_entry){key, data};
+    conflate->index[slot] = seq + 1;
+    buffer->size++;
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status conflating_remove(buffer_t* buffer, void** data)
+{
+    struct buffer_conflate* conflate = buffer->conflate;
+    if (buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    struct buffer_conflate_entry* entry = &conflate->entries[conflate->head & conflate->entry_mask];
+    *data = entry->value;
+    // Delete the index slot with backward shifting, so lookups never need tombstones: every later entry of
+    // the probe run that may live in the freed slot moves back into it
+    size_t hole = conflate_find(conflate, entry->key);
+    size_t slot = hole;
+    while (true) {
+        slot = (slot + 1) & conflate->index_mask;
+        if (conflate->index[slot] == 0) {
+            break;
+        }
+        uint64_t key = conflate->entries[(conflate->index[slot] - 1) & conflate->entry_mask].key;
+        size_t home = conflate_slot(conflate, key);
+        // The entry may move back unless its home lies cyclically in (hole, slot]
+        if (((slot - home) & conflate->index_mask) >= ((slot - hole) & conflate->index_mask)) {
+            conflate->index[hole] = conflate->index[slot];
+            hole = slot;
+        }
+    }
+    conflate->index[hole] = 0;
+    conflate->head++;
+    buffer->size--;
+    return BUFFER_SUCCESS;
+}
+
+// Returns the index slot of the queue for key or, if no value with the key is pending, the free slot where it would go
+static size_t keyed_find(struct buffer_keyed* keyed, uint64_t key)
+{
+    size_t slot = buffer_mix_key(key) & keyed->index_mask;
+    while (keyed->index[slot].head != NULL && keyed->index[slot].key != key) {
+        slot = (slot + 1) & keyed->index_mask;
+    }
+    return slot;
+}
+
+// Takes the oldest entry of the queue in slot out of both lists, freeing the slot once the queue is empty
+static void* keyed_take(buffer_t* buffer, size_t slot)
+{
+    struct buffer_keyed* keyed = buffer->keyed;
+    struct buffer_keyed_queue* queue = &keyed->index[slot];
+    struct buffer_keyed_entry* entry = queue->head;
+    queue->head = entry->next_same;
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        keyed->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        keyed->tail = entry->prev;
+    }
+    void* value = entry->value;
+    entry->next_same = keyed->free;
+    keyed->free = entry;
+    buffer->size--;
+    if (queue->head != NULL) {
+        return value;
+    }
+    // Delete the emptied queue with backward shifting, as conflating_remove does
+    size_t hole = slot;
+    while (true) {
+        slot = (slot + 1) & keyed->index_mask;
+        if (keyed->index[slot].head == NULL) {
+            break;
+        }
+        size_t home = buffer_mix_key(keyed->index[slot].key) & keyed->index_mask;
+        if (((slot - home) & keyed->index_mask) >= ((slot - hole) & keyed->index_mask)) {
+            keyed->index[hole] = keyed->index[slot];
+            hole = slot;
+        }
+    }
+    keyed->index[hole].head = NULL;
+    return value;
+}
+
+// Adds the value with the given key into a keyed buffer
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise, or if the buffer is not keyed
+enum buffer_status buffer_add_keyed(buffer_t* buffer, void* data, uint64_t key)
+{
+    struct buffer_keyed* keyed = buffer->keyed;
+    if (buffer->kind != BUFFER_KEYED || buffer->size >= buffer->capacity) {
+        return BUFFER_ERROR;
+    }
+    struct buffer_keyed_entry* entry = keyed->free;
+    keyed->free = entry->next_same;
+    *entry = (struct buffer_keyed_entry){key, data, keyed->tail, NULL, NULL};
+    if (keyed->tail) {
+        keyed->tail->next = entry;
+    } else {
+        keyed->head = entry;
+    }
+    keyed->tail = entry;
+    struct buffer_keyed_queue* queue = &keyed->index[keyed_find(keyed, key)];
+    if (queue->head) {
+        queue->tail->next_same = entry;
+    } else {
+        queue->key = key;
+        queue->head = entry;
+    }
+    queue->tail = entry;
+    buffer->size++;
+    if (buffer->size > buffer->high_water) {
+        buffer->high_water = buffer->size;
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Removes the oldest value with the given key from a keyed buffer and stores it in data
+// Returns BUFFER_SUCCESS if such a value was removed
+// Returns BUFFER_ERROR otherwise, or if the buffer is not keyed
+enum buffer_status buffer_remove_matching(buffer_t* buffer, uint64_t key, void** data)
+{
+    if (buffer->kind != BUFFER_KEYED || buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    size_t slot = keyed_find(buffer->keyed, key);
+    if (buffer->keyed->index[slot].head == NULL) {
+        return BUFFER_ERROR;
+    }
+    *data = keyed_take(buffer, slot);
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status keyed_remove(buffer_t* buffer, void** data)
+{
+    if (buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    // The oldest value overall is also the oldest of its key, so it heads its key's queue
+    *data = keyed_take(buffer, keyed_find(buffer->keyed, buffer->keyed->head->key));
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status cursor_remove(buffer_t* buffer, void** data)
+{
+    size_t cursor = atomic_load_explicit(&buffer->cursor, memory_order_relaxed);
+    size_t size = atomic_load_explicit(&buffer->shared->published, memory_order_acquire) - cursor;
+    if (size == 0) {
+        return BUFFER_ERROR;
+    }
+    if (size > buffer->high_water) {
+        buffer->high_water = size;
+    }
+    *data = buffer->shared->slots[cursor % buffer->shared->capacity];
+    // Publishing the new cursor hands the slot back to the writer, so the value must be read first
+    atomic_store(&buffer->cursor, cursor + 1);
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status priority_remove(buffer_t* buffer, void** data)
+{
+    if (buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    // The highest set bit is the highest non-empty lane
+    size_t lane = 63 - (size_t)__builtin_clzll(buffer->lane_bits);
+    buffer_remove(buffer->lanes[lane], data);
+    if (buffer->lanes[lane]->size == 0) {
+        buffer->lane_bits &= ~(1ULL << lane);
+    }
+    buffer->size--;
+    return BUFFER_SUCCESS;
+}
+
+// Adds the value into the given lane of a priority buffer; other buffers only have lane 0
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise, or if there is no such lane
+enum buffer_status buffer_add_priority(buffer_t* buffer, void* data, size_t priority)
+{
+    if (buffer->kind != BUFFER_PRIORITY) {
+        return priority == 0 ? buffer_add(buffer, data) : BUFFER_ERROR;
+    }
+    if (priority >= buffer->lane_count || buffer->size >= buffer->capacity) {
+        return BUFFER_ERROR;
+    }
+    // Lanes are as large as the whole buffer, so they cannot be full here
+    buffer_add(buffer->lanes[priority], data);
+    buffer->lane_bits |= 1ULL << priority;
+    buffer->size++;
+    if (buffer->size > buffer->high_water) {
+        buffer->high_water = buffer->size;
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Returns the number of priority lanes of the buffer (1 for buffers without priorities)
+size_t buffer_lanes(buffer_t* buffer)
+{
+    return buffer->kind == BUFFER_PRIORITY ? buffer->lane_count : 1;
+}
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_add(buffer_t* buffer, void* data)
 {
+    if (buffer->kind == BUFFER_KEYED) {
+        return buffer_add_keyed(buffer, data, 0);
+    }
+    if (buffer->kind == BUFFER_PRIORITY) {
+        return buffer_add_priority(buffer, data, 0);
+    }
+    if (buffer->kind == BUFFER_CURSOR) {
+        return BUFFER_ERROR; // only the owner of the shared ring writes to it
+    }
+    if (buffer->kind == BUFFER_CONFLATING) {
+        enum buffer_status status = conflating_add(buffer, data);
+        if (buffer->size > buffer->high_water) {
+            buffer->high_water = buffer->size;
+        }
+        return status;
+    }
+    if (buffer->kind == BUFFER_SEGMENTED) {
+        enum buffer_status status = segmented_add(buffer, data);
+        if (buffer->size > buffer->high_water) {
+            buffer->high_water = buffer->size;
+        }
+        return status;
+    }
+    if (buffer->kind == BUFFER_SPILL) {
+        enum buffer_status status = spill_add(buffer, data);
+        if (buffer->size > buffer->high_water) {
+            buffer->high_water = buffer->size;
+        }
+        return status;
+    }
     if (buffer->size >= buffer->capacity) {
         return BUFFER_ERROR;
     }
@@ -25,7 +863,38 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data)
         pos -= buffer->capacity;
     }
     buffer->data[pos] = data;
+    if (buffer->stamps) {
+        buffer->stamps[pos] = buffer_now();
+    }
     buffer->size++;
+    if (buffer->kind == BUFFER_MAPPED && pos >= buffer->touched) {
+        buffer->touched = pos + 1;
+    }
+    if (buffer->size > buffer->high_water) {
+        buffer->high_water = buffer->size;
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Replaces the oldest value of a full ring with value and stores the replaced value in evicted
+// Returns BUFFER_SUCCESS if a value was replaced
+// Returns BUFFER_ERROR otherwise
+enum buffer_status buffer_overwrite(buffer_t* buffer, void* data, void** evicted)
+{
+    if ((buffer->kind != BUFFER_RING && buffer->kind != BUFFER_MAPPED) || buffer->capacity == 0 ||
+        buffer->size < buffer->capacity) {
+        return BUFFER_ERROR;
+    }
+    // In a full ring the oldest slot is also the one the next value would go to
+    *evicted = buffer->data[buffer->next];
+    buffer->data[buffer->next] = data;
+    if (buffer->stamps) {
+        buffer->stamps[buffer->next] = buffer_now();
+    }
+    buffer->next++;
+    if (buffer->next >= buffer->capacity) {
+        buffer->next -= buffer->capacity;
+    }
     return BUFFER_SUCCESS;
 }
 
@@ -34,13 +903,43 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data)
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 {
+    if (buffer->kind == BUFFER_SEGMENTED) {
+        return segmented_remove(buffer, data);
+    }
+    if (buffer->kind == BUFFER_SPILL) {
+        return spill_remove(buffer, data);
+    }
+    if (buffer->kind == BUFFER_CURSOR) {
+        return cursor_remove(buffer, data);
+    }
+    if (buffer->kind == BUFFER_CONFLATING) {
+        return conflating_remove(buffer, data);
+    }
+    if (buffer->kind == BUFFER_PRIORITY) {
+        return priority_remove(buffer, data);
+    }
+    if (buffer->kind == BUFFER_KEYED) {
+        return keyed_remove(buffer, data);
+    }
     if (buffer->size > 0) {
         *data = buffer->data[buffer->next];
+        if (buffer->stamps) {
+            uint64_t now = buffer_now();
+            uint64_t stamp = buffer->stamps[buffer->next];
+            buffer->sojourn = now > stamp ? now - stamp : 0;
+        }
         buffer->size--;
         buffer->next++;
         if (buffer->next >= buffer->capacity) {
             buffer->next -= buffer->capacity;
         }
+        if (buffer->kind == BUFFER_MAPPED) {
+            if (buffer->size == 0) {
+                mapped_drained(buffer);
+            } else {
+                mapped_consumed(buffer);
+            }
+        }
         return BUFFER_SUCCESS;
     }
     return BUFFER_ERROR;
@@ -49,7 +948,55 @@ enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t *buffer)
 {
-    free(buffer->data);
+    buffer_segment_t* segment = buffer->head_segment;
+    while (segment) {
+        buffer_segment_t* next = segment->next;
+        free(segment);
+        segment = next;
+    }
+    segment = buffer->segment_cache;
+    while (segment) {
+        buffer_segment_t* next = segment->next;
+        free(segment);
+        segment = next;
+    }
+    struct buffer_spill_segment* spill = buffer->spill_head;
+    while (spill) {
+        struct buffer_spill_segment* next = spill->next;
+        spill_segment_free(buffer, spill);
+        spill = next;
+    }
+    if (buffer->ring) {
+        buffer_free(buffer->ring);
+    }
+    free(buffer->spill_dir);
+    free(buffer->stamps);
+    for (size_t i = 0; buffer->lanes && i < buffer->lane_count; i++) {
+        if (buffer->lanes[i]) {
+            buffer_free(buffer->lanes[i]);
+        }
+    }
+    free(buffer->lanes);
+    if (buffer->keyed) {
+        free(buffer->keyed->entries);
+        free(buffer->keyed->index);
+        free(buffer->keyed);
+    }
+    struct buffer_conflate* conflate = buffer->conflate;
+    if (conflate) {
+        // Pending values are dropped with the buffer, so they get released too
+        for (size_t i = 0; conflate->release && i < buffer->size; i++) {
+            conflate->release(conflate->entries[(conflate->head + i) & conflate->entry_mask].value);
+        }
+        free(conflate->entries);
+        free(conflate->index);
+        free(conflate);
+    }
+    if (buffer->kind == BUFFER_MAPPED) {
+        munmap(buffer->data, buffer->capacity * sizeof(void*));
+    } else {
+        free(buffer->data);
+    }
     free(buffer);
 }
 
@@ -62,12 +1009,114 @@ size_t buffer_capacity(buffer_t* buffer)
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer)
 {
+    if (buffer->kind == BUFFER_CURSOR) {
+        return atomic_load_explicit(&buffer->shared->published, memory_order_acquire) -
+               atomic_load_explicit(&buffer->cursor, memory_order_relaxed);
+    }
     return buffer->size;
 }
 
+// Returns the largest number of elements the buffer has held at once
+size_t buffer_high_water(buffer_t* buffer)
+{
+    return buffer->high_water;
+}
+
+// Describes the values of a ring as positions, value n living in slot n % capacity
+void buffer_ring_positions(buffer_t* buffer, size_t* head, size_t* tail)
+{
+    *head = buffer->next;
+    *tail = buffer->next + buffer->size;
+}
+
+// Makes a ring hold the values between positions head and tail again
+void buffer_ring_restore(buffer_t* buffer, size_t head, size_t tail, size_t high_water)
+{
+    buffer->next = head % buffer->capacity;
+    buffer->size = tail - head;
+    if (high_water > buffer->high_water) {
+        buffer->high_water = high_water;
+    }
+}
+
+// Returns how long the last removed value waited in a timestamped buffer, in nanoseconds
+uint64_t buffer_sojourn(buffer_t* buffer)
+{
+    return buffer->sojourn;
+}
+
+// Returns the number of values replaced before being removed (0 for buffers that never conflate)
+size_t buffer_conflated(buffer_t* buffer)
+{
+    return buffer->conflated;
+}
+
+// Returns the number of elements currently spilled to disk (0 for buffers that never spill)
+size_t buffer_spilled(buffer_t* buffer)
+{
+    return buffer->spilled;
+}
+
 // Peeks at a value in the buffer
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index)
 {
+    if (buffer->kind == BUFFER_CONFLATING) {
+        // Conflating buffers are indexed from the oldest pending key
+        struct buffer_conflate* conflate = buffer->conflate;
+        return conflate->entries[(conflate->head + index) & conflate->entry_mask].value;
+    }
+    if (buffer->kind == BUFFER_KEYED) {
+        // Keyed buffers are indexed in arrival order
+        struct buffer_keyed_entry* entry = buffer->keyed->head;
+        while (index-- > 0) {
+            entry = entry->next;
+        }
+        return entry->value;
+    }
+    if (buffer->kind == BUFFER_PRIORITY) {
+        // Priority buffers are indexed in removal order: highest lane first
+        for (size_t lane = buffer->lane_count; lane-- > 0;) {
+            buffer_t* ring = buffer->lanes[lane];
+            if (index < ring->size) {
+                return ring->data[(ring->next + index) % ring->capacity];
+            }
+            index -= ring->size;
+        }
+        return NULL;
+    }
+    if (buffer->kind == BUFFER_CURSOR) {
+        // Cursor buffers are indexed from the next value to read
+        return buffer->shared->slots[(atomic_load(&buffer->cursor) + index) % buffer->shared->capacity];
+    }
+    if (buffer->kind == BUFFER_SPILL) {
+        // Spill buffers are indexed from the oldest element: the ring first, then the segments
+        buffer_t* ring = buffer->ring;
+        if (index < ring->size) {
+            return ring->data[(ring->next + index) % ring->capacity];
+        }
+        index -= ring->size;
+        struct buffer_spill_segment* segment = buffer->spill_head;
+        while (index >= segment->write_pos - segment->read_pos) {
+            index -= segment->write_pos - segment->read_pos;
+            segment = segment->next;
+        }
+        // Values spilled through a codec only exist as records, and peeking does not rebuild them
+        void* value = NULL;
+        if (!buffer->spill_codec.decode) {
+            memcpy(&value, segment->records + (segment->read_pos + index) * sizeof(void*), sizeof(void*));
+        }
+        return value;
+    }
+    if (buffer->kind == BUFFER_SEGMENTED) {
+        // Segmented buffers are indexed from the oldest element
+        buffer_segment_t* segment = buffer->head_segment;
+        index += buffer->next;
+        while (index >= buffer->segment_size) {
+            segment = segment->next;
+            index -= buffer->segment_size;
+        }
+        return segment->slots[index];
+    }
     return buffer->data[index];
 }
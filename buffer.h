@@ -2,12 +2,102 @@
 #define BUFFER_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
+// Storage layouts a buffer can use
+enum buffer_kind {
+    BUFFER_RING = 0,     // Fixed-capacity array used as a circular queue
+    BUFFER_SEGMENTED = 1, // Unbounded list of fixed-size segments
+    BUFFER_MAPPED = 2,    // Circular queue in reserved address space committed on first touch
+    BUFFER_SPILL = 3,     // In-memory ring that overflows into mmap'd segment files on disk
+    BUFFER_CURSOR = 4,    // Read cursor into a ring shared with other readers (broadcast subscribers)
+    BUFFER_CONFLATING = 5, // Latest value per key: adding replaces a pending value with the same key
+    BUFFER_PRIORITY = 6,  // Rings (lanes) sharing one capacity: removing takes from the highest non-empty lane
+    BUFFER_KEYED = 7      // Bounded FIFO of keyed values with a per-key FIFO index for removing by key
+};
+
+// Maps a value to its conflation key (conflating only)
+typedef uint64_t (*buffer_key_fn_t)(void* value);
+// Called with values a buffer drops without handing them out (conflating only)
+typedef void (*buffer_release_fn_t)(void* value);
+
+// Serializes values that a spill buffer moves to disk into fixed-size records (spill only)
+// Without a codec only the value itself (the pointer) is written, and what it points to stays in memory
+typedef struct {
+    size_t record_size;                           // bytes per record
+    void (*encode)(void* value, void* record);    // writes value into record, then frees whatever value owned
+    void* (*decode)(const void* record);          // rebuilds the value written to record
+} buffer_spill_codec_t;
+
+// Flags for buffer_create_mapped
+#define BUFFER_MAP_HUGEPAGE 0x1 // Advise the kernel to back the ring with transparent huge pages
+
+// A mapped buffer returns the pages behind its head to the kernel each time this much memory has been consumed,
+// and all its pages when it drains after touching at least this much
+#define BUFFER_MAP_RELEASE_BYTES (256 * 1024)
+
+// Largest number of lanes a priority buffer can have (one bit each in lane_bits)
+#define BUFFER_PRIORITY_MAX_LANES 64
+
+// Number of drained segments a segmented buffer keeps for reuse
+#define BUFFER_SEGMENT_CACHE_MAX 4
+
+// Fixed-size block of slots used by a segmented buffer
+typedef struct buffer_segment {
+    struct buffer_segment* next;
+    void* slots[];
+} buffer_segment_t;
+
+// Ring written once and read by any number of cursor buffers, each at its own pace (see broadcast.h)
+// The writer must not overwrite a slot before every cursor has moved past it
 typedef struct {
+    void** slots;
+    size_t capacity;
+    _Atomic size_t published; // values written so far; value n lives in slots[n % capacity]
+} buffer_shared_ring_t;
+
+// Pending values and key index of a conflating buffer (defined in buffer.c)
+struct buffer_conflate;
+
+// Entries, FIFO list and key index of a keyed buffer (defined in buffer.c)
+struct buffer_keyed;
+
+// Unlinked temporary file of fixed-size records used by a spill buffer (defined in buffer.c)
+struct buffer_spill_segment;
+
+typedef struct buffer {
     size_t size;
     size_t next;
     size_t capacity;
     void** data;
+    enum buffer_kind kind;
+    size_t high_water;             // largest size ever reached
+    size_t segment_size;           // slots per segment (segmented only)
+    size_t tail_pos;               // next free slot in tail_segment
+    buffer_segment_t* head_segment;
+    buffer_segment_t* tail_segment;
+    buffer_segment_t* segment_cache; // drained segments kept for reuse
+    size_t cached_segments;
+    size_t touched;                // slots written since the last release (mapped only)
+    size_t released;               // page-aligned slot where the consumed, still resident slots start (mapped only)
+    struct buffer* ring;           // in-memory part (spill only)
+    struct buffer_spill_segment* spill_head;
+    struct buffer_spill_segment* spill_tail;
+    size_t spill_records;          // records per segment file (spill only)
+    buffer_spill_codec_t spill_codec; // record format; encode and decode are NULL for pointer records (spill only)
+    size_t spilled;                // records currently on disk (spill only)
+    char* spill_dir;               // directory segment files are created in (spill only)
+    buffer_shared_ring_t* shared;  // ring read by this buffer (cursor only)
+    _Atomic size_t cursor;         // next value to read from shared (cursor only)
+    struct buffer_conflate* conflate; // pending values by key (conflating only)
+    size_t conflated;              // values replaced before being removed (conflating only)
+    uint64_t* stamps;              // enqueue time of each slot (timestamped rings only)
+    uint64_t sojourn;              // time the last removed value spent in the buffer (timestamped rings only)
+    struct buffer** lanes;         // one ring per priority, lowest first (priority only)
+    size_t lane_count;
+    uint64_t lane_bits;            // bit n is set while lane n is not empty (priority only)
+    struct buffer_keyed* keyed;    // pending values by arrival and by key (keyed only)
 } buffer_t;
 
 enum buffer_status {
@@ -18,11 +108,82 @@ enum buffer_status {
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity);
 
+// Creates an unbounded buffer that grows in segments of segment_size slots
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_segmented(size_t segment_size);
+
+// Creates a buffer with the given capacity whose storage is reserved with mmap
+// Pages are committed on first touch and released with MADV_DONTNEED once consumed (see BUFFER_MAP_RELEASE_BYTES),
+// so resident memory follows the backlog instead of the capacity
+// flags may contain BUFFER_MAP_HUGEPAGE
+buffer_t* buffer_create_mapped(size_t capacity, int flags);
+
+// Creates a buffer that keeps up to capacity values in memory and spills the rest to disk
+// Overflow is appended to unlinked segment files of segment_records records each, created in dir,
+// which are mapped with mmap and deleted once drained; values always come out in FIFO order
+// Records are written with codec, or hold just the value pointer if codec is NULL
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_spill(size_t capacity, size_t segment_records, const char* dir,
+                              const buffer_spill_codec_t* codec);
+
+// Creates a read-only buffer over a shared ring that starts reading at value number start
+// Removing advances only this buffer's cursor; adding always fails
+// Its capacity is reported as SIZE_MAX so it is never full
+buffer_t* buffer_create_cursor(buffer_shared_ring_t* shared, size_t start);
+
+// Creates an unbounded buffer that holds at most one value per key: adding a value whose key is already
+// pending replaces that value in place, and the replaced value is passed to release (if not NULL)
+// key may be NULL to give every value the same key, so the buffer only keeps the latest value
+// Values come out in the order their keys became pending; capacity is reported as SIZE_MAX
+buffer_t* buffer_create_conflating(buffer_key_fn_t key, buffer_release_fn_t release);
+
+// Creates a buffer of the given capacity whose values are added with a priority below lanes (at most
+// BUFFER_PRIORITY_MAX_LANES); removing returns the oldest value of the highest priority present, in O(1)
+// Every lane can hold the whole capacity; buffer_add uses priority 0, the lowest
+buffer_t* buffer_create_priority(size_t capacity, size_t lanes);
+
+// Creates a buffer of the given capacity whose values carry a key (see buffer_add_keyed)
+// buffer_remove returns values in FIFO order across keys, buffer_remove_matching the oldest value of one key;
+// both are O(1) and leave the order of the other values untouched. buffer_add uses key 0
+buffer_t* buffer_create_keyed(size_t capacity);
+
+// Starts recording the enqueue time of every value added to a ring (or mapped ring), so removing a value
+// also measures how long it waited (see buffer_sojourn); values already buffered count as added now
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR for other kinds or on allocation failure
+enum buffer_status buffer_enable_timestamps(buffer_t* buffer);
+
+// Returns the clock used for timestamps, in nanoseconds (CLOCK_MONOTONIC)
+uint64_t buffer_now(void);
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_add(buffer_t* buffer, void* data);
 
+// Adds the value into the given lane of a priority buffer; other buffers only have lane 0
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise, or if there is no such lane
+enum buffer_status buffer_add_priority(buffer_t* buffer, void* data, size_t priority);
+
+// Adds the value with the given key into a keyed buffer
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise, or if the buffer is not keyed
+enum buffer_status buffer_add_keyed(buffer_t* buffer, void* data, uint64_t key);
+
+// Removes the oldest value with the given key from a keyed buffer and stores it in data
+// Returns BUFFER_SUCCESS if such a value was removed
+// Returns BUFFER_ERROR otherwise, or if the buffer is not keyed
+enum buffer_status buffer_remove_matching(buffer_t* buffer, uint64_t key, void** data);
+
+// Returns the number of priority lanes of the buffer (1 for buffers without priorities)
+size_t buffer_lanes(buffer_t* buffer);
+
+// Replaces the oldest value of a full ring (or mapped ring) with value, which becomes the newest,
+// and stores the replaced value in evicted
+// Returns BUFFER_SUCCESS if a value was replaced
+// Returns BUFFER_ERROR if the buffer is not full, has no capacity, or is of another kind
+enum buffer_status buffer_overwrite(buffer_t* buffer, void* data, void** evicted);
+
 // Removes the value from the buffer in FIFO order and stores it in data
 // Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
 // Returns BUFFER_ERROR otherwise
@@ -37,6 +198,27 @@ size_t buffer_capacity(buffer_t* buffer);
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer);
 
+// Returns the largest number of elements the buffer has held at once
+size_t buffer_high_water(buffer_t* buffer);
+
+// Describes the contents of a ring as positions: the buffered values are number head to tail - 1, value n being in
+// slot n % capacity. Lets a single producer and a single consumer move values through buffer->data with positions
+// of their own (see channel.c) and hand the ring back with buffer_ring_restore
+void buffer_ring_positions(buffer_t* buffer, size_t* head, size_t* tail);
+
+// Makes a ring hold the values between positions head and tail again (see buffer_ring_positions), the most
+// it has held in between being high_water
+void buffer_ring_restore(buffer_t* buffer, size_t head, size_t tail, size_t high_water);
+
+// Returns how long the last removed value waited in a timestamped buffer, in nanoseconds
+uint64_t buffer_sojourn(buffer_t* buffer);
+
+// Returns the number of values replaced before being removed (0 for buffers that never conflate)
+size_t buffer_conflated(buffer_t* buffer);
+
+// Returns the number of elements currently spilled to disk (0 for buffers that never spill)
+size_t buffer_spilled(buffer_t* buffer);
+
 // Peeks at a value in the buffer
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index);
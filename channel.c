@@ -1,22 +1,19 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/eventfd.h>
 #include "channel.h"
-// Creates a new channel with the provided size and returns it to the caller
-channel_t* channel_create(size_t size)
+#include "trace.h"
+#include "broadcast.h"
+#include "futex.h"
+#include "channel_ops.h"
+// Refreshes channel->state, defined with the readiness helpers further down
+static void channel_publish_state(channel_t* channel);
+// Initializes a freshly allocated channel object around the given buffer
+static void channel_init(channel_t* new_channel, buffer_t* buff)
 {
-    // Allocate memory for the channel object on the heap
-    // The `channel_t` structure will hold the buffer, synchronization primitives, and status information.
-    channel_t* new_channel = malloc(sizeof(channel_t));
-    if (!new_channel) {
-        return NULL; // Return NULL if memory allocation fails
-    }
-
-    // Initialize the buffer for the channel
-    // The buffer will handle the data storage for the channel with a fixed capacity specified by size.
-    buffer_t* buff = buffer_create(size);
-    if (!buff) {
-        free(new_channel); // Clean up allocated memory if buffer creation fails
-        return NULL;
-    }
-
     // Assign the buffer to the channel's buffer field
     new_channel->buffer = buff;
 
@@ -36,9 +33,912 @@ channel_t* channel_create(size_t size)
     new_channel->sel_sends = list_create();
     new_channel->sel_recvs = list_create();
 
+    // Channels are not bound to a NUMA node unless created with channel_create_on_node
+    new_channel->numa_node = CHANNEL_NODE_ANY;
+
+    // Nothing is charged to the memory governor yet
+    new_channel->budget_charged = 0;
+    new_channel->budget_messages = 0;
+
+    // Readiness descriptors are only created when asked for
+    new_channel->readable_fd = -1;
+    new_channel->writable_fd = -1;
+    new_channel->readable_signaled = false;
+    new_channel->writable_signaled = false;
+
+    // Full channels make senders wait unless a lossy overflow policy is set
+    new_channel->overflow = CHANNEL_OVERFLOW_BLOCK;
+    new_channel->overflow_release = NULL;
+    new_channel->dropped = 0;
+    new_channel->codel = NULL;
+    new_channel->matching_receivers = 0;
+    new_channel->shards = NULL;
+    new_channel->mailbox = NULL;
+
+    // Nobody has used the channel yet, so it starts on the locked path
+    new_channel->spsc_sender = pthread_self();
+    new_channel->spsc_receiver = new_channel->spsc_sender;
+    new_channel->spsc_sends = 0;
+    new_channel->spsc_receives = 0;
+    new_channel->blocked_threads = 0;
+    new_channel->spsc_threshold = CHANNEL_SPSC_STREAK;
+    atomic_init(&new_channel->spsc, NULL);
+
+    // Ring backend with the default wait and wake behavior until channel_create_ex says otherwise
+    new_channel->ops = &channel_ring_ops;
+    new_channel->mpmc = NULL;
+    atomic_init(&new_channel->sleepers, 0);
+    atomic_init(&new_channel->state, 0);
+    atomic_init(&new_channel->futex_seq, 0);
+    atomic_init(&new_channel->futex_waiters, 0);
+    new_channel->wait = CHANNEL_WAIT_BLOCK;
+    new_channel->wake = CHANNEL_WAKE_ONE;
+    new_channel->stats = false;
+    atomic_init(&new_channel->sent, 0);
+    atomic_init(&new_channel->received, 0);
+
+    // Channels are numbered even when no trace is running, so a trace started later can refer to them
+    new_channel->trace_id = trace_channel_id();
+    channel_publish_state(new_channel);
+    size_t cap = buffer_capacity(buff);
+    trace_end(trace_begin(), TRACE_CREATE, new_channel->trace_id, cap < UINT32_MAX ? (uint32_t)cap : TRACE_CAPACITY_LARGE,
+              false, SUCCESS);
+}
+// Wraps an already created buffer into a new channel and returns it to the caller
+// The buffer is released if the channel object cannot be allocated
+static channel_t* channel_create_with_buffer(buffer_t* buff)
+{
+    if (!buff) {
+        return NULL; // Return NULL if buffer creation failed
+    }
+
+    // Allocate memory for the channel object on the heap
+    // The `channel_t` structure will hold the buffer, synchronization primitives, and status information.
+    channel_t* new_channel = malloc(sizeof(channel_t));
+    if (!new_channel) {
+        buffer_free(buff); // Clean up the buffer if the channel cannot be allocated
+        return NULL;
+    }
+    channel_init(new_channel, buff);
+
     // Return the newly created channel object
     return new_channel;
 }
+// Creates a new channel with the provided size and returns it to the caller
+channel_t* channel_create(size_t size)
+{
+    // The buffer will handle the data storage for the channel with a fixed capacity specified by size.
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.capacity = size;
+    return channel_create_ex(&attr);
+}
+// Creates a new unbounded channel and returns it to the caller
+// Messages are stored in linked segments of segment_size slots, so senders never block on a full channel
+channel_t* channel_create_unbounded(size_t segment_size)
+{
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.capacity = segment_size;
+    attr.backend = CHANNEL_BACKEND_UNBOUNDED;
+    return channel_create_ex(&attr);
+}
+// Creates a new channel with the provided size whose buffer is reserved with mmap instead of malloc
+channel_t* channel_create_mapped(size_t size, int flags)
+{
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.capacity = size;
+    attr.backend = CHANNEL_BACKEND_MAPPED;
+    attr.flags = flags;
+    return channel_create_ex(&attr);
+}
+// Creates a new channel that buffers up to size messages in memory and spills further messages to disk
+channel_t* channel_create_spill(size_t size, size_t segment_records, const char* dir,
+                                const buffer_spill_codec_t* codec)
+{
+    // Like segmented buffers, spill buffers report SIZE_MAX as their capacity, so senders never wait
+    return channel_create_with_buffer(buffer_create_spill(size, segment_records, dir, codec));
+}
+// Creates a new channel that keeps only the latest pending message per key
+channel_t* channel_create_conflating(buffer_key_fn_t key, buffer_release_fn_t release)
+{
+    // Conflating buffers report SIZE_MAX as their capacity too: a send either adds a key or replaces a value
+    return channel_create_with_buffer(buffer_create_conflating(key, release));
+}
+// Creates a receive-only channel that reads a shared ring through its own cursor, starting at value number start
+channel_t* channel_create_cursor(buffer_shared_ring_t* ring, size_t start)
+{
+    // Cursor buffers report SIZE_MAX as their capacity and refuse adds, so sends fail instead of blocking
+    return channel_create_with_buffer(buffer_create_cursor(ring, start));
+}
+// Creates a new channel of the provided size whose messages are received highest priority first
+channel_t* channel_create_priority(size_t size, size_t lanes)
+{
+    // The lanes share the capacity, so full and empty mean the same as for a single ring
+    return channel_create_with_buffer(buffer_create_priority(size, lanes));
+}
+// Creates a new channel of the provided size whose messages carry a key that receivers can match on
+channel_t* channel_create_keyed(size_t size)
+{
+    // Keyed buffers are bounded like rings, so full and empty behave as usual
+    return channel_create_with_buffer(buffer_create_keyed(size));
+}
+// Creates a new channel with the provided size whose memory (struct and ring) is bound to the given NUMA node
+channel_t* channel_create_on_node(size_t size, int node)
+{
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.capacity = size;
+    attr.numa_node = node;
+    return channel_create_ex(&attr);
+}
+// Creates the ring of a ring or SPSC channel, bound to the given NUMA node unless it is CHANNEL_NODE_ANY
+static channel_t* channel_create_placed(size_t size, int node)
+{
+    // Nothing to place for CHANNEL_NODE_ANY or on single-node machines. ANY (-1) sits above FIRST_CONSUMER (-2), so
+    // the range check alone would map it, and channel_destroy would then free() the mapping of a node-less channel
+    if (node == CHANNEL_NODE_ANY || numa_node_count() <= 1 || node < CHANNEL_NODE_FIRST_CONSUMER) {
+        return channel_create_with_buffer(buffer_create(size));
+    }
+
+    // Both the ring and the struct need their own pages so they can be bound (and later migrated) independently of
+    // unrelated heap data. A mapped buffer already lives in its own mapping.
+    buffer_t* buff = size > 0 ? buffer_create_mapped(size, 0) : buffer_create(0);
+    if (!buff) {
+        return NULL;
+    }
+    if (node >= 0 && size > 0 && numa_bind_range(buff->data, size * sizeof(void*), node) != 0) {
+        buffer_free(buff);
+        return NULL;
+    }
+    channel_t* new_channel = numa_alloc_node_memory(sizeof(channel_t), node);
+    if (!new_channel) {
+        buffer_free(buff);
+        return NULL;
+    }
+    channel_init(new_channel, buff);
+    new_channel->numa_node = node;
+    channel_publish_state(new_channel);
+    return new_channel;
+}
+// Returns the NUMA node the channel memory is bound to
+int channel_numa_node(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    int node = channel->numa_node;
+    pthread_mutex_unlock(&channel->channel_lock);
+    return node;
+}
+// Binds a channel created with CHANNEL_NODE_FIRST_CONSUMER to the node of the calling receiver
+// Must be called with the channel lock held; does nothing for other channels
+static void channel_claim_node(channel_t* channel)
+{
+    if (channel->numa_node != CHANNEL_NODE_FIRST_CONSUMER) {
+        return;
+    }
+    int node = numa_current_node();
+    // Migration failures are not fatal: the channel keeps working wherever its pages currently are
+    numa_bind_range(channel, sizeof(channel_t), node);
+    if (channel->buffer->kind == BUFFER_MAPPED) {
+        numa_bind_range(channel->buffer->data, buffer_capacity(channel->buffer) * sizeof(void*), node);
+    }
+    channel->numa_node = node;
+    channel_publish_state(channel);
+}
+// Gives the CPU away instead of sleeping while the channel's wait strategy allows another round
+// Returns true when the caller should re-check its condition, false when it should sleep
+static bool channel_spin(channel_t* channel, size_t* rounds)
+{
+    if (channel->wait != CHANNEL_WAIT_YIELD || *rounds >= CHANNEL_YIELD_ROUNDS) {
+        return false;
+    }
+    (*rounds)++;
+    sched_yield();
+    return true;
+}
+// Waits on cond following the channel's wait strategy; the early rounds of CHANNEL_WAIT_YIELD only yield with
+// the lock released and return, so the caller re-checks its condition either way
+// Must be called with the channel lock held
+static int channel_wait(channel_t* channel, pthread_cond_t* cond, size_t* rounds)
+{
+    if (channel->wait == CHANNEL_WAIT_YIELD && *rounds < CHANNEL_YIELD_ROUNDS) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        channel_spin(channel, rounds);
+        pthread_mutex_lock(&channel->channel_lock);
+        return 0;
+    }
+    return pthread_cond_wait(cond, &channel->channel_lock);
+}
+// Wakes the threads blocked on cond following the channel's wake policy
+// Must be called with the channel lock held
+static void channel_wake(channel_t* channel, pthread_cond_t* cond)
+{
+    if (channel->wake == CHANNEL_WAKE_ALL) {
+        pthread_cond_broadcast(cond);
+    } else {
+        pthread_cond_signal(cond);
+    }
+}
+// Counts a message sent (sent true) or received through a channel that keeps statistics
+static void channel_count(channel_t* channel, bool sent)
+{
+    if (channel->stats) {
+        atomic_fetch_add_explicit(sent ? &channel->sent : &channel->received, 1, memory_order_relaxed);
+    }
+}
+// Lock-free state of a channel promoted to a single producer and a single consumer (see channel_spsc_track)
+// While active, the two owners move messages through the ring slots with positions of their own instead of the lock
+struct channel_spsc {
+    _Atomic bool active;     // cleared by channel_spsc_demote
+    pthread_t sender;        // the owners, only rewritten while inactive
+    pthread_t receiver;
+    _Atomic bool sending;    // held by whoever is inside the lock-free send, so demotion can wait for it
+    _Atomic bool receiving;  // same for the lock-free receive
+    void** slots;
+    size_t capacity;
+    _Atomic size_t head;     // position of the next message to receive (see buffer_ring_positions)
+    _Atomic size_t tail;     // position of the next message to send
+    _Atomic size_t parked;   // owners sleeping on the channel conditions
+    _Atomic size_t high_water;
+};
+// Returns a promoted channel to the locked path: waits until nobody is inside the lock-free path, then hands
+// the ring back to the buffer. Must be called with the channel lock held before the buffer is used
+static void channel_spsc_demote(channel_t* channel)
+{
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_relaxed);
+    if (!spsc || !atomic_load(&spsc->active)) {
+        return;
+    }
+    atomic_store(&spsc->active, false);
+    // The lock-free operations never take the lock, so they finish quickly
+    while (atomic_load(&spsc->sending) || atomic_load(&spsc->receiving)) {
+        sched_yield();
+    }
+    buffer_ring_restore(channel->buffer, atomic_load(&spsc->head), atomic_load(&spsc->tail),
+                        atomic_load(&spsc->high_water));
+    channel->spsc_sends = 0;
+    channel->spsc_receives = 0;
+    channel_publish_state(channel);
+    // Parked owners retry on the locked path
+    pthread_cond_broadcast(&channel->full);
+    pthread_cond_broadcast(&channel->empty);
+}
+// Records a successful locked send (sender true) or receive by the calling thread, and promotes the channel to
+// the lock-free path once one thread did its last spsc_threshold sends and one its last receives
+// Must be called with the channel lock held
+static void channel_spsc_track(channel_t* channel, bool sender)
+{
+    pthread_t self = pthread_self();
+    pthread_t* owner = sender ? &channel->spsc_sender : &channel->spsc_receiver;
+    size_t* streak = sender ? &channel->spsc_sends : &channel->spsc_receives;
+    if (*streak == 0 || !pthread_equal(*owner, self)) {
+        *owner = self;
+        *streak = 0;
+    }
+    (*streak)++;
+    if (channel->spsc_sends < channel->spsc_threshold || channel->spsc_receives < channel->spsc_threshold) {
+        return;
+    }
+    // Only plain rings qualify, and nothing the lock-free path skips may be in use: waiters on the locked path,
+    // selects, readiness descriptors, lossy overflow, CoDel, the memory budget or first-consumer placement
+    buffer_t* buffer = channel->buffer;
+    if (buffer->kind != BUFFER_RING || buffer_capacity(buffer) == 0 || buffer->stamps || channel->codel ||
+        channel->overflow != CHANNEL_OVERFLOW_BLOCK || channel->readable_fd >= 0 || channel->writable_fd >= 0 ||
+        channel->numa_node == CHANNEL_NODE_FIRST_CONSUMER || channel->blocked_threads > 0 ||
+        list_count(channel->sel_sends) > 0 || list_count(channel->sel_recvs) > 0 ||
+        atomic_load_explicit(&channel->futex_waiters, memory_order_relaxed) > 0 || governor_budget() > 0) {
+        return;
+    }
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_relaxed);
+    if (!spsc) {
+        spsc = malloc(sizeof(struct channel_spsc));
+        if (!spsc) {
+            return;
+        }
+        atomic_init(&spsc->active, false);
+        atomic_init(&spsc->sending, false);
+        atomic_init(&spsc->receiving, false);
+        atomic_init(&spsc->head, 0);
+        atomic_init(&spsc->tail, 0);
+        atomic_init(&spsc->parked, 0);
+        atomic_init(&spsc->high_water, 0);
+        atomic_store_explicit(&channel->spsc, spsc, memory_order_release);
+    }
+    size_t head, tail;
+    buffer_ring_positions(buffer, &head, &tail);
+    spsc->sender = channel->spsc_sender;
+    spsc->receiver = channel->spsc_receiver;
+    spsc->slots = buffer->data;
+    spsc->capacity = buffer_capacity(buffer);
+    atomic_store(&spsc->head, head);
+    atomic_store(&spsc->tail, tail);
+    atomic_store(&spsc->high_water, 0);
+    atomic_store(&spsc->active, true);
+    channel_publish_state(channel);
+}
+// Enters the lock-free path through the given side's flag if the channel is promoted and the caller owns that side
+// Returns NULL when the caller has to take the locked path
+static struct channel_spsc* channel_spsc_enter(channel_t* channel, bool sender)
+{
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_acquire);
+    if (!spsc) {
+        return NULL;
+    }
+    // Taking the flag with a compare-and-swap keeps a second producer or consumer from ever clearing the owner's
+    _Atomic bool* flag = sender ? &spsc->sending : &spsc->receiving;
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(flag, &expected, true)) {
+        return NULL;
+    }
+    if (atomic_load(&spsc->active) && pthread_equal(sender ? spsc->sender : spsc->receiver, pthread_self()) &&
+        governor_budget() == 0) {
+        return spsc;
+    }
+    atomic_store(flag, false);
+    return NULL;
+}
+// Sleeps until the other owner makes progress (room for a sender, a message for a receiver) or the channel is demoted
+static void channel_spsc_park(channel_t* channel, struct channel_spsc* spsc, bool sender)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    // Announce the sleep before the last look, so the other owner either sees us or we see its progress
+    atomic_fetch_add(&spsc->parked, 1);
+    size_t used = atomic_load(&spsc->tail) - atomic_load(&spsc->head);
+    if (atomic_load(&spsc->active) && (sender ? used == spsc->capacity : used == 0)) {
+        pthread_cond_wait(sender ? &channel->empty : &channel->full, &channel->channel_lock);
+    }
+    atomic_fetch_sub(&spsc->parked, 1);
+    pthread_mutex_unlock(&channel->channel_lock);
+}
+// Wakes the other owner if it is parked on the given condition
+static void channel_spsc_wake(channel_t* channel, struct channel_spsc* spsc, pthread_cond_t* cond)
+{
+    if (atomic_load(&spsc->parked) > 0) {
+        pthread_mutex_lock(&channel->channel_lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&channel->channel_lock);
+    }
+}
+// Sends through the lock-free path when the calling thread is the producer of a promoted channel
+// Returns false, having done nothing, when the caller has to take the locked path
+static bool channel_spsc_send(channel_t* channel, void* data, bool blocking, bool* blocked,
+                              enum channel_status* status)
+{
+    size_t rounds = 0;
+    while (true) {
+        struct channel_spsc* spsc = channel_spsc_enter(channel, true);
+        if (!spsc) {
+            return false;
+        }
+        size_t tail = atomic_load_explicit(&spsc->tail, memory_order_relaxed);
+        size_t used = tail - atomic_load_explicit(&spsc->head, memory_order_acquire);
+        if (used < spsc->capacity) {
+            spsc->slots[tail % spsc->capacity] = data;
+            channel_count(channel, true);
+            atomic_store(&spsc->tail, tail + 1);
+            if (used + 1 > atomic_load_explicit(&spsc->high_water, memory_order_relaxed)) {
+                atomic_store_explicit(&spsc->high_water, used + 1, memory_order_relaxed);
+            }
+            atomic_store(&spsc->sending, false);
+            channel_spsc_wake(channel, spsc, &channel->full);
+            *status = SUCCESS;
+            return true;
+        }
+        atomic_store(&spsc->sending, false);
+        if (!blocking) {
+            *status = CHANNEL_FULL;
+            return true;
+        }
+        *blocked = true;
+        if (!channel_spin(channel, &rounds)) {
+            channel_spsc_park(channel, spsc, true);
+        }
+    }
+}
+// Receives through the lock-free path when the calling thread is the consumer of a promoted channel
+// Returns false, having done nothing, when the caller has to take the locked path
+static bool channel_spsc_receive(channel_t* channel, void** data, bool blocking, bool* blocked,
+                                 enum channel_status* status)
+{
+    size_t rounds = 0;
+    while (true) {
+        struct channel_spsc* spsc = channel_spsc_enter(channel, false);
+        if (!spsc) {
+            return false;
+        }
+        size_t head = atomic_load_explicit(&spsc->head, memory_order_relaxed);
+        if (atomic_load_explicit(&spsc->tail, memory_order_acquire) != head) {
+            *data = spsc->slots[head % spsc->capacity];
+            channel_count(channel, false);
+            atomic_store(&spsc->head, head + 1);
+            atomic_store(&spsc->receiving, false);
+            channel_spsc_wake(channel, spsc, &channel->empty);
+            *status = SUCCESS;
+            return true;
+        }
+        atomic_store(&spsc->receiving, false);
+        if (!blocking) {
+            *status = CHANNEL_EMPTY;
+            return true;
+        }
+        *blocked = true;
+        if (!channel_spin(channel, &rounds)) {
+            channel_spsc_park(channel, spsc, false);
+        }
+    }
+}
+// Returns whether the channel currently runs on the lock-free single-producer single-consumer path
+bool channel_spsc_active(channel_t* channel)
+{
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_acquire);
+    return spsc && atomic_load(&spsc->active);
+}
+// Returns the largest number of messages the channel has buffered at once (its high-water mark)
+size_t channel_high_water(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    size_t high_water = buffer_high_water(channel->buffer);
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_relaxed);
+    if (spsc && atomic_load(&spsc->active) && atomic_load(&spsc->high_water) > high_water) {
+        high_water = atomic_load(&spsc->high_water); // the lock-free path keeps its own mark until demoted
+    }
+    pthread_mutex_unlock(&channel->channel_lock);
+    return high_water;
+}
+// Returns the number of messages a conflating channel replaced before they were received
+size_t channel_conflated(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    size_t conflated = buffer_conflated(channel->buffer);
+    pthread_mutex_unlock(&channel->channel_lock);
+    return conflated;
+}
+// Returns the amount of the process-wide memory budget charged to the messages buffered in the channel
+size_t channel_budget_usage(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    size_t charged = channel->budget_charged;
+    pthread_mutex_unlock(&channel->channel_lock);
+    return charged;
+}
+// Charges one message to the memory governor before it is added to the channel
+// Must be called without the channel lock held, since blocking senders wait here until any channel releases budget
+// Returns SUCCESS with the charged amount stored in charged, CLOSED_ERROR if the channel closes while waiting,
+// or CHANNEL_OVER_BUDGET if the budget is exhausted and the caller may not wait
+static enum channel_status channel_charge(channel_t* channel, bool blocking, size_t* charged)
+{
+    // Fast path: no budget set, or room left
+    if (governor_try_charge(charged)) {
+        return SUCCESS;
+    }
+
+    // Announce the wait before re-checking so a concurrent release cannot be missed
+    governor_enter_wait();
+    enum channel_status status = SUCCESS;
+    while (true) {
+        unsigned long seen = governor_generation();
+        if (governor_try_charge(charged)) {
+            break;
+        }
+
+        // A closed channel reports CLOSED_ERROR rather than the budget error
+        pthread_mutex_lock(&channel->channel_lock);
+        bool open = channel->channel_status;
+        pthread_mutex_unlock(&channel->channel_lock);
+        if (!open) {
+            status = CLOSED_ERROR;
+            break;
+        }
+        if (!blocking || governor_policy() == GOVERNOR_FAIL) {
+            status = CHANNEL_OVER_BUDGET;
+            break;
+        }
+
+        // Sleep until budget is released somewhere or a channel is closed
+        governor_wait(seen);
+    }
+    governor_leave_wait();
+    return status;
+}
+// Records that a message charged with the given amount was added to the buffer
+// Must be called with the channel lock held
+static void channel_account_add(channel_t* channel, size_t charged)
+{
+    channel_count(channel, true);
+    // A conflating channel that replaced a pending message did not grow: every buffered message is already
+    // charged, so the new charge is handed back instead of being counted twice
+    if (charged > 0 && channel->budget_messages >= buffer_current_size(channel->buffer)) {
+        governor_release(charged);
+        return;
+    }
+    if (charged > 0) {
+        channel->budget_charged += charged;
+        channel->budget_messages++;
+    }
+}
+// Returns the budget charged for a message that was just removed from the buffer
+// Must be called with the channel lock held
+static void channel_account_remove(channel_t* channel)
+{
+    if (channel->budget_messages > 0) {
+        size_t amount = channel->budget_charged / channel->budget_messages;
+        channel->budget_charged -= amount;
+        channel->budget_messages--;
+        governor_release(amount);
+    }
+}
+// Applies a lossy overflow policy to a send that found the buffer full
+// Returns SUCCESS if data overwrote the oldest message, or CHANNEL_FULL if data was dropped
+// Neither outcome changes whether the channel is empty or full, so nobody is woken
+// Must be called with the channel lock held
+static enum channel_status channel_shed(channel_t* channel, void* data, size_t charged)
+{
+    channel->dropped++;
+    void* evicted = NULL;
+    if (channel->overflow == CHANNEL_OVERFLOW_DROP_OLDEST &&
+        buffer_overwrite(channel->buffer, data, &evicted) == BUFFER_SUCCESS) {
+        channel_account_remove(channel);
+        channel_account_add(channel, charged);
+        if (channel->overflow_release) {
+            channel->overflow_release(evicted);
+        }
+        return SUCCESS;
+    }
+    governor_release(charged);
+    return CHANNEL_FULL;
+}
+// Removes the next message to hand to a receiver, letting the CoDel controller (if any) drop stale messages
+// ahead of it, and returns the budget of everything removed
+// Must be called with the channel lock held
+static enum buffer_status channel_dequeue(channel_t* channel, void** data)
+{
+    if (!channel->codel) {
+        if (buffer_remove(channel->buffer, data) == BUFFER_ERROR) {
+            return BUFFER_ERROR;
+        }
+        channel_account_remove(channel);
+        channel_count(channel, false);
+        return BUFFER_SUCCESS;
+    }
+    size_t dropped = 0;
+    if (codel_dequeue(channel->codel, channel->buffer, data, &dropped) == BUFFER_ERROR) {
+        return BUFFER_ERROR;
+    }
+    channel_count(channel, false);
+    for (size_t i = 0; i <= dropped; i++) {
+        channel_account_remove(channel);
+    }
+    if (dropped > 0) {
+        channel->dropped += dropped;
+        // Every dropped message made room for one more sender
+        pthread_cond_broadcast(&channel->empty);
+    }
+    return BUFFER_SUCCESS;
+}
+// Wakes a waiting (or about to wait) select so it re-checks its cases
+// Selects that also wait on file descriptors sleep in poll() and are woken through their eventfd
+static void channel_wake_select(sel_sync_t* sel)
+{
+    if (sel->wake_fd >= 0) {
+        uint64_t counter = 1;
+        ssize_t rc = write(sel->wake_fd, &counter, sizeof(counter));
+        (void)rc; // the counter only saturates after ~2^64 wakeups, and any non-zero value wakes the select
+        return;
+    }
+    pthread_mutex_lock(sel->sel_lock);
+    sel->signaled = true;
+    pthread_cond_signal(sel->sel_cond);
+    pthread_mutex_unlock(sel->sel_lock);
+}
+// Signals every select registered in the given list (sel_recvs or sel_sends)
+// Must be called with the channel lock held
+static void channel_notify_selects(list_t* sels)
+{
+    list_node_t* head = list_head(sels);
+    while (head != NULL) {
+        channel_wake_select((sel_sync_t*)head->data);
+        head = head->next;
+    }
+}
+// Wakes the selects sleeping on the channel's futex word so they re-check their cases
+// Selects count themselves in futex_waiters before their last look at the channel, which they take under the lock,
+// so a change made under the lock either is seen by that look or sees the select
+// Must be called with the channel lock held
+static void channel_notify_futex(channel_t* channel)
+{
+    if (atomic_load_explicit(&channel->futex_waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&channel->futex_seq, 1);
+        futex_wake_all(&channel->futex_seq);
+    }
+}
+// Sets what sends do when the channel is full
+void channel_set_overflow(channel_t* channel, enum channel_overflow policy, buffer_release_fn_t release)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+    channel->overflow = policy;
+    channel->overflow_release = release;
+    channel_publish_state(channel);
+    // Senders waiting for space re-check under the new policy
+    pthread_cond_broadcast(&channel->empty);
+    channel_notify_selects(channel->sel_sends);
+    channel_notify_futex(channel);
+    pthread_mutex_unlock(&channel->channel_lock);
+}
+// Returns the number of messages shed by the channel's overflow policy
+size_t channel_dropped(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    size_t dropped = channel->dropped;
+    pthread_mutex_unlock(&channel->channel_lock);
+    return dropped;
+}
+// Enables (or with a target_ns of 0, disables) CoDel active queue management on a ring or mapped channel
+enum channel_status channel_set_codel(channel_t* channel, uint64_t target_ns, uint64_t interval_ns, codel_drop_fn_t drop,
+                                      void* arg)
+{
+    codel_t* codel = NULL;
+    if (target_ns > 0) {
+        codel = codel_create(target_ns, interval_ns, drop, arg);
+        if (!codel) {
+            return GENERIC_ERROR;
+        }
+    }
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+    if (codel && buffer_enable_timestamps(channel->buffer) == BUFFER_ERROR) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        codel_free(codel);
+        return GENERIC_ERROR;
+    }
+    codel_t* old = channel->codel;
+    channel->codel = codel;
+    pthread_mutex_unlock(&channel->channel_lock);
+    if (old) {
+        codel_free(old);
+    }
+    return SUCCESS;
+}
+// Copies the counters of the channel's CoDel controller into stats
+enum channel_status channel_codel_stats(channel_t* channel, codel_stats_t* stats)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    enum channel_status status = GENERIC_ERROR;
+    if (channel->codel) {
+        codel_stats(channel->codel, stats);
+        status = SUCCESS;
+    }
+    pthread_mutex_unlock(&channel->channel_lock);
+    return status;
+}
+// Makes a readiness eventfd readable (value true) or not readable (value false)
+// *signaled mirrors the eventfd counter so only actual transitions cost a syscall
+// Must be called with the channel lock held
+static void channel_set_ready(int fd, bool* signaled, bool value)
+{
+    if (fd < 0 || *signaled == value) {
+        return;
+    }
+    uint64_t counter = 1;
+    ssize_t rc = value ? write(fd, &counter, sizeof(counter)) : read(fd, &counter, sizeof(counter));
+    (void)rc; // a non-blocking eventfd only fails here if it is already in the requested state
+    *signaled = value;
+}
+// Wakes everyone interested in a message having been added to the buffer:
+// blocked receivers (through "full", per the wake policy, or all of them while some wait for a key), every select
+// waiting to receive,
+// and the readiness descriptors whose state the add changed
+// Must be called with the channel lock held
+static void channel_notify_added(channel_t* channel)
+{
+    // Receivers waiting for a particular key may not want this message, so everyone gets to look at it
+    if (channel->matching_receivers > 0) {
+        pthread_cond_broadcast(&channel->full);
+    } else {
+        channel_wake(channel, &channel->full);
+    }
+    channel_notify_selects(channel->sel_recvs);
+    channel_notify_futex(channel);
+    channel_publish_state(channel);
+    channel_set_ready(channel->readable_fd, &channel->readable_signaled, true);
+    if (buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)) {
+        channel_set_ready(channel->writable_fd, &channel->writable_signaled, false);
+    }
+}
+// Wakes everyone interested in a message having been removed from the buffer:
+// blocked senders (through "empty", per the wake policy), every select waiting to send,
+// and the readiness descriptors whose state the remove changed
+// Must be called with the channel lock held
+static void channel_notify_removed(channel_t* channel)
+{
+    channel_wake(channel, &channel->empty);
+    channel_notify_selects(channel->sel_sends);
+    channel_notify_futex(channel);
+    channel_publish_state(channel);
+    channel_set_ready(channel->writable_fd, &channel->writable_signaled, true);
+    if (buffer_current_size(channel->buffer) == 0) {
+        channel_set_ready(channel->readable_fd, &channel->readable_signaled, false);
+    }
+    // A broadcast subscriber may be the slowest cursor a producer is waiting on
+    if (channel->buffer->kind == BUFFER_CURSOR) {
+        broadcast_cursor_moved(channel->buffer->shared);
+    }
+}
+// Wakes the receivers of a channel whose buffer gained messages without a send on the channel
+void channel_notify_published(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    if (channel->channel_status) {
+        channel_notify_added(channel);
+    }
+    pthread_mutex_unlock(&channel->channel_lock);
+}
+// Creates a readiness eventfd on first use and primes it with the channel's current state
+// Must be called with the channel lock held
+static int channel_ready_fd(int* fd, bool* signaled, bool ready)
+{
+    if (*fd < 0) {
+        *fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        *signaled = false;
+        channel_set_ready(*fd, signaled, ready);
+    }
+    return *fd;
+}
+// Returns an eventfd that polls readable while the channel holds data or is closed
+int channel_readable_fd(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+    bool ready = !channel->channel_status || buffer_current_size(channel->buffer) > 0;
+    int fd = channel_ready_fd(&channel->readable_fd, &channel->readable_signaled, ready);
+    pthread_mutex_unlock(&channel->channel_lock);
+    return fd;
+}
+// Returns an eventfd that polls readable while the channel has space for a message or is closed
+int channel_writable_fd(channel_t* channel)
+{
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+    bool ready = !channel->channel_status ||
+                 buffer_current_size(channel->buffer) < buffer_capacity(channel->buffer);
+    int fd = channel_ready_fd(&channel->writable_fd, &channel->writable_signaled, ready);
+    pthread_mutex_unlock(&channel->channel_lock);
+    return fd;
+}
+// Wakes a select that is waiting for the memory governor to release budget
+static void channel_select_budget_wake(void* arg)
+{
+    channel_wake_select((sel_sync_t*)arg);
+}
+// Adds data to the buffer; tag is the lane of a priority channel or the key of a keyed channel (0 otherwise)
+// Must be called with the channel lock held
+static enum buffer_status channel_buffer_add(channel_t* channel, void* data, uint64_t tag)
+{
+    if (channel->buffer->kind == BUFFER_KEYED) {
+        return buffer_add_keyed(channel->buffer, data, tag);
+    }
+    return buffer_add_priority(channel->buffer, data, (size_t)tag);
+}
+// Sharded, mailbox and MPMC channels keep their messages outside the channel buffer
+static bool channel_is_detached(channel_t* channel)
+{
+    return channel->ops->try_receive != NULL;
+}
+// Rewrites the lock-free copy of the channel's readiness from the state it guards
+// The count and FULL are only kept where the buffer alone decides readiness under the lock: detached backends,
+// channels on the lock-free SPSC path, broadcast subscribers (whose ring fills without the lock), lossy channels
+// and channels waiting for their first consumer's NUMA node are marked CHANNEL_STATE_LOCKED instead
+// Must be called with the channel lock held (or before the channel is shared) after any of that state changed
+static void channel_publish_state(channel_t* channel)
+{
+    size_t state = channel->channel_status ? 0 : CHANNEL_STATE_CLOSED;
+    struct channel_spsc* spsc = atomic_load_explicit(&channel->spsc, memory_order_relaxed);
+    if (channel_is_detached(channel) || (spsc && atomic_load(&spsc->active)) ||
+        channel->buffer->kind == BUFFER_CURSOR || channel->overflow != CHANNEL_OVERFLOW_BLOCK ||
+        channel->numa_node == CHANNEL_NODE_FIRST_CONSUMER) {
+        state |= CHANNEL_STATE_LOCKED;
+    } else {
+        size_t size = buffer_current_size(channel->buffer);
+        state |= size << CHANNEL_STATE_SIZE_SHIFT;
+        if (size == buffer_capacity(channel->buffer)) {
+            state |= CHANNEL_STATE_FULL;
+        }
+    }
+    atomic_store_explicit(&channel->state, state, memory_order_release);
+}
+// Reads the lock-free copy of the channel's readiness (see channel_publish_state)
+static size_t channel_state(channel_t* channel)
+{
+    return atomic_load_explicit(&channel->state, memory_order_acquire);
+}
+// Blocking send of ring channels; sets *blocked when the call has to wait for space
+static enum channel_status channel_ring_blocking_send(channel_t *channel, void* data, uint64_t tag, bool* blocked)
+{
+    /* IMPLEMENT THIS */
+    enum channel_status status;
+    if (channel_spsc_send(channel, data, true, blocked, &status)) {
+        return status;
+    }
+
+    // Reserve room for the message in the process-wide memory budget (a no-op when no budget is set)
+    // This may wait, so it happens before taking the channel lock
+    size_t charged = 0;
+    enum channel_status charge_status = channel_charge(channel, true, &charged);
+    if (charge_status != SUCCESS) {
+        return charge_status;
+    }
+
+    // Lock the channel mutex to ensure thread-safe access to the channel's data
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+
+    // Check if the channel is closed
+    // If the channel's status indicates it is closed, return CLOSED_ERROR
+    if (!channel->channel_status) {
+        pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
+        governor_release(charged); // Give back the unused reservation
+        return CLOSED_ERROR;
+    }
+
+    // Wait for space to become available in the buffer
+    // Get the capacity of the buffer
+    size_t cap = buffer_capacity(channel->buffer);
+    size_t rounds = 0;
+    
+    // While the buffer is full, wait on the "empty" condition variable
+    while (buffer_current_size(channel->buffer) == cap) {
+        // Lossy channels shed a message instead of waiting
+        if (channel->overflow != CHANNEL_OVERFLOW_BLOCK) {
+            status = channel_shed(channel, data, charged);
+            pthread_mutex_unlock(&channel->channel_lock);
+            return status;
+        }
+
+        // Block until the buffer is not full or the channel status changes
+        *blocked = true;
+        channel->blocked_threads++;
+        int rc = channel_wait(channel, &channel->empty, &rounds);
+        channel->blocked_threads--;
+        if (rc != 0) {
+            // If an error occurs while waiting, unlock and return a generic error
+            pthread_mutex_unlock(&channel->channel_lock);
+            governor_release(charged);
+            return GENERIC_ERROR;
+        }
+
+        // Check if the channel has been closed while waiting
+        if (!channel->channel_status) {
+            pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
+            governor_release(charged);
+            return CLOSED_ERROR;
+        }
+    }
+
+    // Add the data to the buffer
+    // Use the channel_buffer_add() function to insert the data into its lane or key. If it fails, return an error.
+    if (channel_buffer_add(channel, data, tag) == BUFFER_ERROR) {
+        pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
+        governor_release(charged);
+        return GENERIC_ERROR;
+    }
+    channel_account_add(channel, charged);
+
+    // Wake a blocked receiver, every select waiting to receive, and readiness descriptors
+    channel_notify_added(channel);
+    channel_spsc_track(channel, true);
+
+    // Unlock the channel mutex before returning
+    pthread_mutex_unlock(&channel->channel_lock);
+
+    // Return SUCCESS to indicate that the data was successfully written to the channel
+    return SUCCESS;
+}
+// Body of channel_send and its priority and keyed variants; sets *blocked when the call has to wait for space
+static enum channel_status channel_send_op(channel_t* channel, void* data, uint64_t tag, bool* blocked)
+{
+    return channel->ops->send(channel, data, tag, true, blocked);
+}
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -46,10 +946,52 @@ channel_t* channel_create(size_t size)
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_send(channel_t *channel, void* data)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id; // read up front: the channel may be destroyed as soon as the operation returns
+    bool blocked = false;
+    enum channel_status status = channel_send_op(channel, data, 0, &blocked);
+    trace_end(start, TRACE_SEND, id, 0, blocked, status);
+    return status;
+}
+// Writes data to the given lane of a priority channel, waiting while the channel is full
+enum channel_status channel_send_priority(channel_t* channel, void* data, size_t priority)
+{
+    if (priority >= buffer_lanes(channel->buffer)) {
+        return GENERIC_ERROR;
+    }
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    bool blocked = false;
+    enum channel_status status = channel_send_op(channel, data, priority, &blocked);
+    trace_end(start, TRACE_SEND, id, 0, blocked, status);
+    return status;
+}
+// Writes data tagged with key to a keyed channel, waiting while the channel is full
+enum channel_status channel_send_keyed(channel_t* channel, void* data, uint64_t key)
+{
+    if (channel->buffer->kind != BUFFER_KEYED) {
+        return GENERIC_ERROR;
+    }
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    bool blocked = false;
+    enum channel_status status = channel_send_op(channel, data, key, &blocked);
+    trace_end(start, TRACE_SEND, id, 0, blocked, status);
+    return status;
+}
+// Blocking receive of ring channels; sets *blocked when the call has to wait for data
+static enum channel_status channel_ring_blocking_receive(channel_t* channel, void** data, bool* blocked)
 {
     /* IMPLEMENT THIS */
+    enum channel_status status;
+    if (channel_spsc_receive(channel, data, true, blocked, &status)) {
+        return status;
+    }
+
     // Lock the channel mutex to ensure thread-safe access to the channel's data
     pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
 
     // Check if the channel is closed
     // If the channel's status indicates it is closed, return CLOSED_ERROR
@@ -58,14 +1000,19 @@ enum channel_status channel_send(channel_t *channel, void* data)
         return CLOSED_ERROR;
     }
 
-    // Wait for space to become available in the buffer
-    // Get the capacity of the buffer
-    size_t cap = buffer_capacity(channel->buffer);
-    
-    // While the buffer is full, wait on the "empty" condition variable
-    while (buffer_current_size(channel->buffer) == cap) {
-        // Block until the buffer is not full or the channel status changes
-        if (pthread_cond_wait(&channel->empty, &channel->channel_lock) != 0) {
+    // The first receiver decides where a CHANNEL_NODE_FIRST_CONSUMER channel lives
+    channel_claim_node(channel);
+
+    // Wait for data to become available in the buffer
+    // While the buffer is empty, wait on the "full" condition variable
+    size_t rounds = 0;
+    while (buffer_current_size(channel->buffer) == 0) {
+        // Block until the buffer is not empty or the channel status changes
+        *blocked = true;
+        channel->blocked_threads++;
+        int rc = channel_wait(channel, &channel->full, &rounds);
+        channel->blocked_threads--;
+        if (rc != 0) {
             // If an error occurs while waiting, unlock and return a generic error
             pthread_mutex_unlock(&channel->channel_lock);
             return GENERIC_ERROR;
@@ -78,44 +1025,29 @@ enum channel_status channel_send(channel_t *channel, void* data)
         }
     }
 
-    // Add the data to the buffer
-    // Use the buffer_add() function to insert the data. If it fails, return an error.
-    if (buffer_add(channel->buffer, data) == BUFFER_ERROR) {
+    // Remove the data from the buffer
+    // Use channel_dequeue() to retrieve the data and return its share of the memory budget; a CoDel controller
+    // may drop stale messages ahead of it. If it fails, return an error.
+    if (channel_dequeue(channel, data) == BUFFER_ERROR) {
         pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
         return GENERIC_ERROR;
     }
 
-    // Signal the "full" condition variable to notify that data has been added
-    pthread_cond_signal(&channel->full);
-
-    // Notify all receivers that are using "select"
-    // These are listeners registered for specific channel events
-    size_t num_recvs = list_count(channel->sel_recvs); // Get the number of select receivers
-    if (num_recvs != 0) {
-        list_node_t* head = list_head(channel->sel_recvs); // Get the head of the receiver list
-
-        // Iterate over all select receivers and signal their conditions
-        while (head != NULL) {
-            // Lock the receiver's mutex
-            pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-            
-            // Signal the receiver's condition variable to notify about the new data
-            pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-            
-            // Unlock the receiver's mutex
-            pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-
-            // Move to the next receiver in the list
-            head = head->next;
-        }
-    }
+    // Wake a blocked sender, every select waiting to send, and readiness descriptors
+    channel_notify_removed(channel);
+    channel_spsc_track(channel, false);
 
     // Unlock the channel mutex before returning
     pthread_mutex_unlock(&channel->channel_lock);
 
-    // Return SUCCESS to indicate that the data was successfully written to the channel
+    // Return SUCCESS to indicate that data was successfully retrieved from the channel
     return SUCCESS;
 }
+// Body of channel_receive; sets *blocked when the call has to wait for data
+static enum channel_status channel_receive_op(channel_t* channel, void** data, bool* blocked)
+{
+    return channel->ops->receive(channel, data, true, blocked);
+}
 // Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
 // This is a blocking call i.e., the function only returns on a successful completion of receive
 // In case the channel is empty, the function waits till the channel has some data to read
@@ -123,129 +1055,670 @@ enum channel_status channel_send(channel_t *channel, void* data)
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_receive(channel_t* channel, void** data)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    bool blocked = false;
+    enum channel_status status = channel_receive_op(channel, data, &blocked);
+    trace_end(start, TRACE_RECV, id, 0, blocked, status);
+    return status;
+}
+// Non-blocking send of ring channels
+static enum channel_status channel_ring_non_blocking_send(channel_t* channel, void* data, uint64_t tag)
 {
     /* IMPLEMENT THIS */
-    // Lock the channel mutex to ensure thread-safe access to the channel's data
+    enum channel_status status;
+    bool blocked = false;
+    if (channel_spsc_send(channel, data, false, &blocked, &status)) {
+        return status;
+    }
+
+    // A closed or full channel fails without taking the lock.
+    size_t state = channel_state(channel);
+    if (state & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    if (state & CHANNEL_STATE_FULL) {
+        return CHANNEL_FULL;
+    }
+
+    // Reserve room for the message in the process-wide memory budget without waiting.
+    size_t charged = 0;
+    enum channel_status charge_status = channel_charge(channel, false, &charged);
+    if (charge_status != SUCCESS) {
+        return charge_status;
+    }
+
+    // Acquire the lock to ensure thread-safe access to the channel.
     pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
 
-    // Check if the channel is closed
-    // If the channel's status indicates it is closed, return CLOSED_ERROR
+    // Check if the channel is closed. If it is, release the lock and return an error status.
     if (!channel->channel_status) {
-        pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
+        pthread_mutex_unlock(&channel->channel_lock);
+        governor_release(charged);
         return CLOSED_ERROR;
     }
 
-    // Wait for data to become available in the buffer
-    // While the buffer is empty, wait on the "full" condition variable
-    while (buffer_current_size(channel->buffer) == 0) {
-        // Block until the buffer is not empty or the channel status changes
-        if (pthread_cond_wait(&channel->full, &channel->channel_lock) != 0) {
-            // If an error occurs while waiting, unlock and return a generic error
+    // Check if the channel's buffer is full.
+    size_t cap = buffer_capacity(channel->buffer);
+    if (buffer_current_size(channel->buffer) == cap) {
+        // Lossy channels shed a message (and count it) according to their overflow policy.
+        if (channel->overflow != CHANNEL_OVERFLOW_BLOCK) {
+            status = channel_shed(channel, data, charged);
             pthread_mutex_unlock(&channel->channel_lock);
-            return GENERIC_ERROR;
+            return status;
         }
+        // If the buffer is full, release the lock and return a full error status.
+        pthread_mutex_unlock(&channel->channel_lock);
+        governor_release(charged);
+        return CHANNEL_FULL;
+    }
 
-        // Check if the channel has been closed while waiting
+    // Add the data to the buffer.
+    // If there is an error during the addition (e.g., memory issue), return a generic error.
+    if (channel_buffer_add(channel, data, tag) == BUFFER_ERROR) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        governor_release(charged);
+        return GENERIC_ERROR;
+    }
+    channel_account_add(channel, charged);
+
+    // Wake a blocked receiver, every select waiting to receive, and readiness descriptors.
+    channel_notify_added(channel);
+    channel_spsc_track(channel, true);
+
+    // Release the lock as all operations are complete.
+    pthread_mutex_unlock(&channel->channel_lock);
+
+    // Return a success status to indicate the data was sent successfully.
+    return SUCCESS;
+}
+// Body of channel_non_blocking_send and its priority and keyed variants
+static enum channel_status channel_non_blocking_send_op(channel_t* channel, void* data, uint64_t tag)
+{
+    bool blocked = false;
+    return channel->ops->send(channel, data, tag, false, &blocked);
+}
+// Writes data to the given channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS for successfully writing data to the channel,
+// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    enum channel_status status = channel_non_blocking_send_op(channel, data, 0);
+    trace_end(start, TRACE_NB_SEND, id, 0, false, status);
+    return status;
+}
+// Writes data to the given lane of a priority channel, or returns CHANNEL_FULL if the channel is full
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, size_t priority)
+{
+    if (priority >= buffer_lanes(channel->buffer)) {
+        return GENERIC_ERROR;
+    }
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    enum channel_status status = channel_non_blocking_send_op(channel, data, priority);
+    trace_end(start, TRACE_NB_SEND, id, 0, false, status);
+    return status;
+}
+// Writes data tagged with key to a keyed channel, or returns CHANNEL_FULL if the channel is full
+enum channel_status channel_non_blocking_send_keyed(channel_t* channel, void* data, uint64_t key)
+{
+    if (channel->buffer->kind != BUFFER_KEYED) {
+        return GENERIC_ERROR;
+    }
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    enum channel_status status = channel_non_blocking_send_op(channel, data, key);
+    trace_end(start, TRACE_NB_SEND, id, 0, false, status);
+    return status;
+}
+// Non-blocking receive of ring channels
+static enum channel_status channel_ring_non_blocking_receive(channel_t* channel, void** data)
+{
+    /* IMPLEMENT THIS */
+    enum channel_status status;
+    bool blocked = false;
+    if (channel_spsc_receive(channel, data, false, &blocked, &status)) {
+        return status;
+    }
+
+    // A closed or empty channel fails without taking the lock.
+    size_t state = channel_state(channel);
+    if (state & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    if (!(state & CHANNEL_STATE_LOCKED) && state >> CHANNEL_STATE_SIZE_SHIFT == 0) {
+        return CHANNEL_EMPTY;
+    }
+
+    // Acquire the channel lock to ensure thread-safe access to the channel.
+    pthread_mutex_lock(&channel->channel_lock);
+    channel_spsc_demote(channel);
+
+    // Check if the channel is closed; if so, release the lock and return CLOSED_ERROR.
+    if (!channel->channel_status) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        return CLOSED_ERROR;
+    }
+
+    // The first receiver decides where a CHANNEL_NODE_FIRST_CONSUMER channel lives.
+    channel_claim_node(channel);
+
+    // If the channel's buffer is empty, release the lock and return CHANNEL_EMPTY.
+    if (buffer_current_size(channel->buffer) == 0) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        return CHANNEL_EMPTY;
+    }
+
+    // Attempt to remove data from the buffer. If an error occurs, release the lock and return GENERIC_ERROR.
+    // The message's share of the memory budget is returned along with it.
+    if (channel_dequeue(channel, data) == BUFFER_ERROR) {
+        pthread_mutex_unlock(&channel->channel_lock);
+        return GENERIC_ERROR;
+    }
+
+    // Wake a blocked sender, every select waiting to send, and readiness descriptors.
+    channel_notify_removed(channel);
+    channel_spsc_track(channel, false);
+
+    // Release the channel lock after completing all operations.
+    pthread_mutex_unlock(&channel->channel_lock);
+
+    // Return SUCCESS to indicate that the data was successfully received.
+    return SUCCESS;
+}
+// Body of channel_non_blocking_receive
+static enum channel_status channel_non_blocking_receive_op(channel_t* channel, void** data)
+{
+    bool blocked = false;
+    return channel->ops->receive(channel, data, false, &blocked);
+}
+// Sends on a ring channel; the lock-free SPSC path is tried first by the bodies themselves
+enum channel_status channel_ring_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked)
+{
+    if (blocking) {
+        return channel_ring_blocking_send(channel, data, tag, blocked);
+    }
+    return channel_ring_non_blocking_send(channel, data, tag);
+}
+// Receives from a ring channel
+enum channel_status channel_ring_receive(channel_t* channel, void** data, bool blocking, bool* blocked)
+{
+    if (blocking) {
+        return channel_ring_blocking_receive(channel, data, blocked);
+    }
+    return channel_ring_non_blocking_receive(channel, data);
+}
+// SEND case of a select on a ring channel: ready when the buffer has space (lossy channels always do) and the
+// memory budget has room, or when the budget is exhausted under the GOVERNOR_FAIL policy
+// Must be called with the channel lock held
+enum channel_status channel_ring_select_send(channel_t* channel, void* data, bool* ready)
+{
+    // Check if the channel buffer has space for sending; lossy channels are always ready
+    size_t cap = buffer_capacity(channel->buffer);
+    bool full = buffer_current_size(channel->buffer) == cap;
+    if (full && channel->overflow == CHANNEL_OVERFLOW_BLOCK) {
+        return CHANNEL_FULL;
+    }
+
+    // The message also needs room in the process-wide memory budget; otherwise the case waits for budget to be released
+    size_t charged = 0;
+    if (!governor_try_charge(&charged)) {
+        *ready = governor_policy() == GOVERNOR_FAIL;
+        return CHANNEL_OVER_BUDGET;
+    }
+
+    *ready = true;
+    if (full) {
+        return channel_shed(channel, data, charged);
+    }
+
+    // Add data to buffer
+    if (buffer_add(channel->buffer, data) == BUFFER_ERROR) {
+        governor_release(charged);
+        return GENERIC_ERROR;
+    }
+    channel_account_add(channel, charged);
+
+    // Signal any waiting receivers
+    channel_notify_added(channel);
+    return SUCCESS;
+}
+// RECV case of a select on a ring channel: ready when the buffer has data
+// Must be called with the channel lock held
+enum channel_status channel_ring_select_receive(channel_t* channel, void** data, bool* ready)
+{
+    channel_claim_node(channel);
+    // Check if the channel buffer has data for receiving
+    if (buffer_current_size(channel->buffer) == 0) {
+        return CHANNEL_EMPTY;
+    }
+
+    // Remove data from buffer
+    *ready = true;
+    if (channel_dequeue(channel, data) == BUFFER_ERROR) {
+        return GENERIC_ERROR;
+    }
+
+    // Signal any waiting senders
+    channel_notify_removed(channel);
+    return SUCCESS;
+}
+// Orders the caller's last write (a message or room published, or a sleeper registered) before its next read
+// ThreadSanitizer does not support fences, so sanitized builds use a read-modify-write of the sleepers counter,
+// which orders the same accesses
+static void channel_fence(channel_t* channel)
+{
+#ifdef __SANITIZE_THREAD__
+    atomic_fetch_add(&channel->sleepers, 0);
+#else
+    (void)channel;
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+// Wakes the threads and selects sleeping on a detached channel after it gained (added) or lost a message
+// locked tells whether the caller already holds the channel lock
+static void channel_wake_sleepers(channel_t* channel, bool added, bool locked)
+{
+    // Sleepers register before their last look, and both sides fence between their write and their read, so either
+    // the sleeper sees our message (or room) or we see the sleeper
+    channel_fence(channel);
+    if (atomic_load(&channel->sleepers) == 0) {
+        return;
+    }
+    if (!locked) {
+        pthread_mutex_lock(&channel->channel_lock);
+    }
+    if (added) {
+        channel_wake(channel, &channel->full);
+        channel_notify_selects(channel->sel_recvs);
+    } else {
+        channel_wake(channel, &channel->empty);
+        channel_notify_selects(channel->sel_sends);
+    }
+    channel_notify_futex(channel);
+    if (!locked) {
+        pthread_mutex_unlock(&channel->channel_lock);
+    }
+}
+// Sends (out NULL) or receives into out on a detached channel: tries without the lock, and while the channel is full
+// (or empty) sleeps on the channel itself after registering as a sleeper, so the other side knows to wake it
+static enum channel_status channel_detached_op(channel_t* channel, void* data, void** out, bool blocking, bool* blocked)
+{
+    const struct channel_ops* ops = channel->ops;
+    size_t rounds = 0;
+    while (true) {
+        // Detached backends report closing through channel->state, so failing fast needs no lock
+        enum channel_status status = out ? ops->try_receive(channel, out, false) : ops->try_send(channel, data, false);
+        if (status != CHANNEL_EMPTY || !blocking) {
+            return status;
+        }
+        if (channel_spin(channel, &rounds)) {
+            continue;
+        }
+        pthread_mutex_lock(&channel->channel_lock);
         if (!channel->channel_status) {
-            pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
+            pthread_mutex_unlock(&channel->channel_lock);
             return CLOSED_ERROR;
         }
+        // Register as a sleeper before the last look, so operations that miss us in that look see us here
+        atomic_fetch_add(&channel->sleepers, 1);
+        channel_fence(channel);
+        status = out ? ops->try_receive(channel, out, true) : ops->try_send(channel, data, true);
+        if (status == CHANNEL_EMPTY) {
+            *blocked = true;
+            pthread_cond_wait(out ? &channel->full : &channel->empty, &channel->channel_lock);
+        }
+        atomic_fetch_sub(&channel->sleepers, 1);
+        pthread_mutex_unlock(&channel->channel_lock);
+        if (status != CHANNEL_EMPTY) {
+            return status;
+        }
+    }
+}
+// Sends on a mailbox or MPMC channel
+enum channel_status channel_detached_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked)
+{
+    (void)tag;
+    return channel_detached_op(channel, data, NULL, blocking, blocked);
+}
+// Receives from a sharded, mailbox or MPMC channel
+enum channel_status channel_detached_receive(channel_t* channel, void** data, bool blocking, bool* blocked)
+{
+    return channel_detached_op(channel, NULL, data, blocking, blocked);
+}
+// Tells whether a non-blocking attempt made for a select case completed it: full and empty channels make the select
+// wait, and so does an exhausted memory budget unless the governor policy is GOVERNOR_FAIL
+static bool channel_detached_ready(enum channel_status status)
+{
+    if (status == CHANNEL_OVER_BUDGET) {
+        return governor_policy() == GOVERNOR_FAIL;
+    }
+    return status != CHANNEL_FULL && status != CHANNEL_EMPTY;
+}
+// SEND case of a select on a detached channel
+enum channel_status channel_detached_select_send(channel_t* channel, void* data, bool* ready)
+{
+    enum channel_status status = channel->ops->try_send(channel, data, true);
+    *ready = channel_detached_ready(status);
+    return status;
+}
+// RECV case of a select on a detached channel
+enum channel_status channel_detached_select_receive(channel_t* channel, void** data, bool* ready)
+{
+    enum channel_status status = channel->ops->try_receive(channel, data, true);
+    *ready = channel_detached_ready(status);
+    return status;
+}
+// Sub-channels of a sharded channel
+struct channel_shards {
+    size_t count;
+    channel_t** shards;
+    _Atomic uint64_t ready;  // bit n is set when shard n may hold messages (cleared by receivers that find it empty)
+    _Atomic size_t sweep;    // where the next receiver starts looking, so every shard gets its turn
+};
+// Sends data to the calling thread's shard, so each producer's messages stay in order
+static enum channel_status channel_sharded_push(channel_t* channel, void* data, bool blocking, bool locked,
+                                                bool* blocked)
+{
+    struct channel_shards* shards = channel->shards;
+    uint64_t hash = (uint64_t)pthread_self() * 0x9e3779b97f4a7c15ULL;
+    size_t index = (size_t)(hash >> 32) % shards->count;
+    enum channel_status status = blocking ? channel_send_op(shards->shards[index], data, 0, blocked)
+                                          : channel_non_blocking_send_op(shards->shards[index], data, 0);
+    if (status == SUCCESS) {
+        atomic_fetch_or(&shards->ready, 1ULL << index);
+        channel_wake_sleepers(channel, true, locked);
+    }
+    return status;
+}
+// Sends on a sharded channel; blocking senders wait inside their shard
+enum channel_status channel_sharded_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked)
+{
+    (void)tag;
+    return channel_sharded_push(channel, data, blocking, false, blocked);
+}
+// Sends on a sharded channel without waiting for room in the shard
+enum channel_status channel_sharded_try_send(channel_t* channel, void* data, bool locked)
+{
+    bool blocked = false;
+    return channel_sharded_push(channel, data, false, locked, &blocked);
+}
+// Takes a message from the first shard marked ready, starting the sweep at a rotating shard
+// Returns SUCCESS, CHANNEL_EMPTY if no shard had a message, or the error of a closed shard
+enum channel_status channel_sharded_try_receive(channel_t* channel, void** data, bool locked)
+{
+    if (channel_state(channel) & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    struct channel_shards* shards = channel->shards;
+    size_t start = atomic_fetch_add_explicit(&shards->sweep, 1, memory_order_relaxed) % shards->count;
+    uint64_t ready = atomic_load(&shards->ready);
+    while (ready != 0) {
+        uint64_t after = ready & ~((1ULL << start) - 1);
+        size_t index = (size_t)__builtin_ctzll(after != 0 ? after : ready);
+        ready &= ~(1ULL << index);
+        enum channel_status status = channel_non_blocking_receive_op(shards->shards[index], data);
+        if (status == CHANNEL_EMPTY) {
+            // Clear the bit, then look once more: a sender that set it just before us has its message there
+            atomic_fetch_and(&shards->ready, ~(1ULL << index));
+            status = channel_non_blocking_receive_op(shards->shards[index], data);
+            if (status == SUCCESS) {
+                atomic_fetch_or(&shards->ready, 1ULL << index);
+            }
+        }
+        if (status == SUCCESS) {
+            channel_wake_sleepers(channel, false, locked);
+        }
+        if (status != CHANNEL_EMPTY) {
+            return status;
+        }
+    }
+    return CHANNEL_EMPTY;
+}
+// Pushes the mailbox_node_t data points to; never blocks, as mailboxes are unbounded
+enum channel_status channel_mailbox_try_send(channel_t* channel, void* data, bool locked)
+{
+    if (channel_state(channel) & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    if (data == NULL) {
+        return GENERIC_ERROR;
+    }
+    channel_count(channel, true);
+    mailbox_push(channel->mailbox, data);
+    channel_wake_sleepers(channel, true, locked);
+    return SUCCESS;
+}
+// Pops the oldest message of a mailbox channel; only its single consumer may call this
+// Nobody waits for room in a mailbox, so there is nobody to wake
+enum channel_status channel_mailbox_try_receive(channel_t* channel, void** data, bool locked)
+{
+    (void)locked;
+    if (channel_state(channel) & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    mailbox_node_t* node = mailbox_pop(channel->mailbox);
+    if (node == NULL) {
+        return CHANNEL_EMPTY;
+    }
+    channel_count(channel, false);
+    *data = node;
+    return SUCCESS;
+}
+// Appends data to the queue of an MPMC channel, or returns CHANNEL_FULL
+enum channel_status channel_mpmc_try_send(channel_t* channel, void* data, bool locked)
+{
+    if (channel_state(channel) & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    if (!mpmc_push(channel->mpmc, data)) {
+        return CHANNEL_FULL;
+    }
+    channel_count(channel, true);
+    channel_wake_sleepers(channel, true, locked);
+    return SUCCESS;
+}
+// Removes the oldest message of an MPMC channel, or returns CHANNEL_EMPTY
+enum channel_status channel_mpmc_try_receive(channel_t* channel, void** data, bool locked)
+{
+    if (channel_state(channel) & CHANNEL_STATE_CLOSED) {
+        return CLOSED_ERROR;
+    }
+    if (!mpmc_pop(channel->mpmc, data)) {
+        return CHANNEL_EMPTY;
+    }
+    channel_count(channel, false);
+    channel_wake_sleepers(channel, false, locked);
+    return SUCCESS;
+}
+// Switches a channel to a detached backend, whose readiness channel->state then tracks without the lock
+static void channel_use_detached(channel_t* channel, const struct channel_ops* ops)
+{
+    channel->ops = ops;
+    channel_publish_state(channel);
+}
+// Creates a channel made of attr->shards ring sub-channels of attr->capacity messages each, configured like attr
+static channel_t* channel_create_shards(const channel_attr_t* attr)
+{
+    // Sharding gives up the global FIFO order, so callers have to ask for it explicitly
+    if (!(attr->flags & CHANNEL_RELAXED_ORDER)) {
+        return NULL;
+    }
+    size_t shards = attr->shards;
+    if (shards == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        shards = cpus > 0 ? (size_t)cpus : 1;
+        if (shards > CHANNEL_MAX_SHARDS) {
+            shards = CHANNEL_MAX_SHARDS;
+        }
+    }
+    if (shards > CHANNEL_MAX_SHARDS) {
+        return NULL;
+    }
+    channel_t* channel = channel_create_with_buffer(buffer_create(0));
+    struct channel_shards* sub = calloc(1, sizeof(struct channel_shards));
+    channel_t** list = calloc(shards, sizeof(channel_t*));
+    if (!channel || !sub || !list) {
+        free(sub);
+        free(list);
+        if (channel) {
+            channel_close(channel);
+            channel_destroy(channel);
+        }
+        return NULL;
     }
-
-    // Remove the data from the buffer
-    // Use the buffer_remove() function to retrieve the data. If it fails, return an error.
-    if (buffer_remove(channel->buffer, data) == BUFFER_ERROR) {
-        pthread_mutex_unlock(&channel->channel_lock); // Unlock before returning
-        return GENERIC_ERROR;
+    // The shards wait, wake and count like the channel; its own counters stay unused
+    channel_attr_t shard_attr = *attr;
+    shard_attr.backend = CHANNEL_BACKEND_RING;
+    shard_attr.flags = 0;
+    for (size_t i = 0; i < shards; i++) {
+        list[i] = channel_create_ex(&shard_attr);
+        if (!list[i]) {
+            for (size_t j = 0; j < i; j++) {
+                channel_close(list[j]);
+                channel_destroy(list[j]);
+            }
+            free(list);
+            free(sub);
+            channel_close(channel);
+            channel_destroy(channel);
+            return NULL;
+        }
     }
-
-    // Signal the "empty" condition variable to notify that space is available
-    pthread_cond_signal(&channel->empty);
-
-    // Notify all senders that are using "select"
-    // These are senders registered for specific channel events
-    size_t num_sends = list_count(channel->sel_sends); // Get the number of select senders
-    if (num_sends != 0) {
-        list_node_t* head = list_head(channel->sel_sends); // Get the head of the sender list
-
-        // Iterate over all select senders and signal their conditions
-        while (head != NULL) {
-            // Lock the sender's mutex
-            pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-            
-            // Signal the sender's condition variable to notify about the available space
-            pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-            
-            // Unlock the sender's mutex
-            pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-
-            // Move to the next sender in the list
-            head = head->next;
+    sub->count = shards;
+    sub->shards = list;
+    atomic_init(&sub->ready, 0);
+    atomic_init(&sub->sweep, 0);
+    channel->shards = sub;
+    channel_use_detached(channel, &channel_sharded_ops);
+    return channel;
+}
+// Creates a channel made of shards sub-channels of size messages each; see channel.h
+channel_t* channel_create_sharded(size_t size, size_t shards, int flags)
+{
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.capacity = size;
+    attr.backend = CHANNEL_BACKEND_SHARDED;
+    attr.shards = shards;
+    attr.flags = flags;
+    return channel_create_ex(&attr);
+}
+// Returns the number of shards of a sharded channel (0 for other channels)
+size_t channel_shard_count(channel_t* channel)
+{
+    return channel->shards ? channel->shards->count : 0;
+}
+// Creates a mailbox channel, or an MPMC channel of capacity messages
+static channel_t* channel_create_detached(enum channel_backend backend, size_t capacity)
+{
+    channel_t* channel = channel_create_with_buffer(buffer_create(0));
+    mailbox_t* mailbox = backend == CHANNEL_BACKEND_MAILBOX ? malloc(sizeof(mailbox_t)) : NULL;
+    mpmc_t* mpmc = backend == CHANNEL_BACKEND_MPMC ? mpmc_create(capacity) : NULL;
+    if (!channel || (!mailbox && !mpmc)) {
+        free(mailbox);
+        if (mpmc) {
+            mpmc_free(mpmc);
+        }
+        if (channel) {
+            channel_close(channel);
+            channel_destroy(channel);
         }
+        return NULL;
     }
-
-    // Unlock the channel mutex before returning
-    pthread_mutex_unlock(&channel->channel_lock);
-
-    // Return SUCCESS to indicate that data was successfully retrieved from the channel
-    return SUCCESS;
+    if (mailbox) {
+        mailbox_init(mailbox);
+        channel->mailbox = mailbox;
+        channel_use_detached(channel, &channel_mailbox_ops);
+    } else {
+        channel->mpmc = mpmc;
+        channel_use_detached(channel, &channel_mpmc_ops);
+    }
+    return channel;
 }
-// Writes data to the given channel
-// This is a non-blocking call i.e., the function simply returns if the channel is full
-// Returns SUCCESS for successfully writing data to the channel,
-// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
-// CLOSED_ERROR if the channel is closed, and
-// GENERIC_ERROR on encountering any other generic error of any sort
-enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
+// Creates an unbounded single-consumer channel whose messages embed their own mailbox_node_t link
+channel_t* channel_create_mailbox()
 {
-    /* IMPLEMENT THIS */
-    // Acquire the lock to ensure thread-safe access to the channel.
-    pthread_mutex_lock(&channel->channel_lock);
-
-    // Check if the channel is closed. If it is, release the lock and return an error status.
-    if (!channel->channel_status) {
-        pthread_mutex_unlock(&channel->channel_lock);
-        return CLOSED_ERROR;
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.backend = CHANNEL_BACKEND_MAILBOX;
+    return channel_create_ex(&attr);
+}
+// Initializes attr to the configuration of channel_create
+void channel_attr_init(channel_attr_t* attr)
+{
+    attr->capacity = 0;
+    attr->backend = CHANNEL_BACKEND_RING;
+    attr->wait = CHANNEL_WAIT_BLOCK;
+    attr->wake = CHANNEL_WAKE_ONE;
+    attr->numa_node = CHANNEL_NODE_ANY;
+    attr->shards = 0;
+    attr->flags = 0;
+    attr->stats = false;
+}
+// Creates a channel from a configuration; see channel.h
+channel_t* channel_create_ex(const channel_attr_t* attr)
+{
+    // Placement is only implemented for rings
+    bool ring = attr->backend == CHANNEL_BACKEND_RING || attr->backend == CHANNEL_BACKEND_SPSC;
+    if (attr->numa_node != CHANNEL_NODE_ANY && !ring) {
+        return NULL;
     }
-
-    // Check if the channel's buffer is full.
-    size_t cap = buffer_capacity(channel->buffer);
-    if (buffer_current_size(channel->buffer) == cap) {
-        // If the buffer is full, release the lock and return a full error status.
-        pthread_mutex_unlock(&channel->channel_lock);
-        return CHANNEL_FULL;
+    channel_t* channel = NULL;
+    switch (attr->backend) {
+    case CHANNEL_BACKEND_RING:
+    case CHANNEL_BACKEND_SPSC:
+        channel = channel_create_placed(attr->capacity, attr->numa_node);
+        break;
+    case CHANNEL_BACKEND_MPMC:
+        channel = channel_create_detached(attr->backend, attr->capacity);
+        break;
+    case CHANNEL_BACKEND_UNBOUNDED:
+        // A segmented buffer reports SIZE_MAX as its capacity, so the "buffer is full" checks
+        // in send and select never hold and the regular send/receive/select paths apply unchanged.
+        channel = channel_create_with_buffer(buffer_create_segmented(attr->capacity));
+        break;
+    case CHANNEL_BACKEND_MAPPED:
+        channel = channel_create_with_buffer(buffer_create_mapped(attr->capacity, attr->flags));
+        break;
+    case CHANNEL_BACKEND_SHARDED:
+        channel = channel_create_shards(attr);
+        break;
+    case CHANNEL_BACKEND_MAILBOX:
+        channel = channel_create_detached(attr->backend, 0);
+        break;
     }
-
-    // Add the data to the buffer.
-    // If there is an error during the addition (e.g., memory issue), return a generic error.
-    if (buffer_add(channel->buffer, data) == BUFFER_ERROR) {
-        pthread_mutex_unlock(&channel->channel_lock);
+    if (!channel) {
+        return NULL;
+    }
+    channel->wait = attr->wait;
+    channel->wake = attr->wake;
+    channel->stats = attr->stats;
+    if (attr->backend == CHANNEL_BACKEND_SPSC) {
+        channel->spsc_threshold = 1;
+    }
+    return channel;
+}
+// Copies the message counters of a channel created with stats enabled into stats
+enum channel_status channel_stats(channel_t* channel, channel_stats_t* stats)
+{
+    if (!channel->stats) {
         return GENERIC_ERROR;
     }
-
-    // Signal any waiting threads that the buffer is no longer empty.
-    pthread_cond_signal(&channel->full);
-
-    // Notify all select receivers (threads waiting on this channel for a receive operation).
-    size_t num_recvs = list_count(channel->sel_recvs); // Count the number of select receivers.
-    if (num_recvs != 0) {
-        list_node_t* head = list_head(channel->sel_recvs); // Get the head of the select receivers list.
-        while (head != NULL) {
-            // Lock each receiver's synchronization structure.
-            pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-            // Signal the condition variable associated with the receiver.
-            pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-            // Unlock the receiver's synchronization structure.
-            pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-            // Move to the next receiver in the list.
-            head = head->next;
-        }
+    stats->sent = atomic_load_explicit(&channel->sent, memory_order_relaxed);
+    stats->received = atomic_load_explicit(&channel->received, memory_order_relaxed);
+    // A sharded channel's messages are counted by its shards
+    for (size_t i = 0; channel->shards && i < channel->shards->count; i++) {
+        stats->sent += atomic_load_explicit(&channel->shards->shards[i]->sent, memory_order_relaxed);
+        stats->received += atomic_load_explicit(&channel->shards->shards[i]->received, memory_order_relaxed);
     }
-
-    // Release the lock as all operations are complete.
-    pthread_mutex_unlock(&channel->channel_lock);
-
-    // Return a success status to indicate the data was sent successfully.
     return SUCCESS;
 }
 // Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
@@ -256,56 +1729,76 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
 {
-    /* IMPLEMENT THIS */
-    // Acquire the channel lock to ensure thread-safe access to the channel.
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    enum channel_status status = channel_non_blocking_receive_op(channel, data);
+    trace_end(start, TRACE_NB_RECV, id, 0, false, status);
+    return status;
+}
+// Body of channel_receive_matching and channel_non_blocking_receive_matching
+static enum channel_status channel_receive_matching_op(channel_t* channel, uint64_t key, void** data, bool blocking,
+                                                       bool* blocked)
+{
+    if (channel->buffer->kind != BUFFER_KEYED) {
+        return GENERIC_ERROR;
+    }
     pthread_mutex_lock(&channel->channel_lock);
-
-    // Check if the channel is closed; if so, release the lock and return CLOSED_ERROR.
     if (!channel->channel_status) {
         pthread_mutex_unlock(&channel->channel_lock);
         return CLOSED_ERROR;
     }
+    channel_claim_node(channel);
 
-    // If the channel's buffer is empty, release the lock and return CHANNEL_EMPTY.
-    if (buffer_current_size(channel->buffer) == 0) {
-        pthread_mutex_unlock(&channel->channel_lock);
-        return CHANNEL_EMPTY;
-    }
-
-    // Attempt to remove data from the buffer. If an error occurs, release the lock and return GENERIC_ERROR.
-    if (buffer_remove(channel->buffer, data) == BUFFER_ERROR) {
-        pthread_mutex_unlock(&channel->channel_lock);
-        return GENERIC_ERROR;
-    }
-
-    // Signal the condition variable to notify any waiting producers that the buffer is no longer full.
-    pthread_cond_signal(&channel->empty);
-
-    // Notify all threads waiting on the `sel_sends` list that they can proceed.
-    size_t num_sends = list_count(channel->sel_sends);
-    if (num_sends != 0) {
-        list_node_t* head = list_head(channel->sel_sends);
-        while (head != NULL) {
-            // Acquire the lock for the current select sender and signal its condition variable.
-            pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-            pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-            pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-            head = head->next;
+    // The key index finds the oldest matching message directly; other messages stay where they are
+    size_t rounds = 0;
+    while (buffer_remove_matching(channel->buffer, key, data) == BUFFER_ERROR) {
+        if (!blocking) {
+            pthread_mutex_unlock(&channel->channel_lock);
+            return CHANNEL_EMPTY;
+        }
+        // Senders broadcast instead of signaling while someone waits for a key, so we cannot swallow a
+        // wakeup meant for another receiver
+        *blocked = true;
+        channel->matching_receivers++;
+        int rc = channel_wait(channel, &channel->full, &rounds);
+        channel->matching_receivers--;
+        if (rc != 0) {
+            pthread_mutex_unlock(&channel->channel_lock);
+            return GENERIC_ERROR;
+        }
+        if (!channel->channel_status) {
+            pthread_mutex_unlock(&channel->channel_lock);
+            return CLOSED_ERROR;
         }
     }
-
-    // Release the channel lock after completing all operations.
+    channel_account_remove(channel);
+    channel_count(channel, false);
+    channel_notify_removed(channel);
     pthread_mutex_unlock(&channel->channel_lock);
-
-    // Return SUCCESS to indicate that the data was successfully received.
     return SUCCESS;
 }
-// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
-// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
-// Returns SUCCESS if close is successful,
-// CLOSED_ERROR if the channel is already closed, and
-// GENERIC_ERROR in any other error case
-enum channel_status channel_close(channel_t* channel)
+// Reads the oldest message sent with key to a keyed channel, waiting until there is one
+enum channel_status channel_receive_matching(channel_t* channel, uint64_t key, void** data)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    bool blocked = false;
+    enum channel_status status = channel_receive_matching_op(channel, key, data, true, &blocked);
+    trace_end(start, TRACE_RECV, id, 0, blocked, status);
+    return status;
+}
+// Reads the oldest message sent with key to a keyed channel, or returns CHANNEL_EMPTY if there is none
+enum channel_status channel_non_blocking_receive_matching(channel_t* channel, uint64_t key, void** data)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    bool blocked = false;
+    enum channel_status status = channel_receive_matching_op(channel, key, data, false, &blocked);
+    trace_end(start, TRACE_NB_RECV, id, 0, false, status);
+    return status;
+}
+// Body of channel_close
+static enum channel_status channel_close_op(channel_t* channel)
 {
     // Lock the channel mutex to ensure thread-safe access to the channel's state
     pthread_mutex_lock(&channel->channel_lock);
@@ -316,6 +1809,9 @@ enum channel_status channel_close(channel_t* channel)
         return CLOSED_ERROR; // Return an error if the channel is already closed
     }
 
+    // Closed channels report their state on the locked path
+    channel_spsc_demote(channel);
+
     // Mark the channel as closed
     channel->channel_status = false;
 
@@ -324,42 +1820,47 @@ enum channel_status channel_close(channel_t* channel)
     pthread_cond_broadcast(&channel->full);
     pthread_cond_broadcast(&channel->empty);
 
-    // Notify all select receivers that the channel is now closed
-    size_t num_recvs = list_count(channel->sel_recvs); // Get the number of select receivers
-    if (num_recvs != 0) {
-        list_node_t* head = list_head(channel->sel_recvs); // Get the head of the receiver list
+    // Notify all select receivers and senders that the channel is now closed
+    channel_notify_selects(channel->sel_recvs);
+    channel_notify_selects(channel->sel_sends);
+    channel_notify_futex(channel);
 
-        // Iterate over all select receivers and signal their conditions
-        while (head != NULL) {
-            sel_sync_t* sel = (sel_sync_t*)head->data; // Cast node data to sel_sync_t
-            pthread_mutex_lock(sel->sel_lock);         // Lock the receiver's mutex
-            pthread_cond_signal(sel->sel_cond);       // Signal the condition variable
-            pthread_mutex_unlock(sel->sel_lock);      // Unlock the receiver's mutex
-            head = head->next;                        // Move to the next receiver
-        }
-    }
+    // Closed channels stay readable on both descriptors so epoll loops observe CLOSED_ERROR
+    channel_set_ready(channel->readable_fd, &channel->readable_signaled, true);
+    channel_set_ready(channel->writable_fd, &channel->writable_signaled, true);
 
-    // Notify all select senders that the channel is now closed
-    size_t num_sends = list_count(channel->sel_sends); // Get the number of select senders
-    if (num_sends != 0) {
-        list_node_t* head = list_head(channel->sel_sends); // Get the head of the sender list
+    // Operations of detached backends and lock-free checks read the closed state from here
+    channel_publish_state(channel);
 
-        // Iterate over all select senders and signal their conditions
-        while (head != NULL) {
-            sel_sync_t* sel = (sel_sync_t*)head->data; // Cast node data to sel_sync_t
-            pthread_mutex_lock(sel->sel_lock);         // Lock the sender's mutex
-            pthread_cond_signal(sel->sel_cond);       // Signal the condition variable
-            pthread_mutex_unlock(sel->sel_lock);      // Unlock the sender's mutex
-            head = head->next;                        // Move to the next sender
-        }
+    // Closing the shards releases the threads blocked on them
+    for (size_t i = 0; channel->shards && i < channel->shards->count; i++) {
+        channel_close_op(channel->shards->shards[i]);
     }
 
     // Unlock the channel mutex before returning
     pthread_mutex_unlock(&channel->channel_lock);
 
+    // Senders waiting for the memory budget re-check their channel and return CLOSED_ERROR
+    if (governor_budget() > 0) {
+        governor_notify();
+    }
+
     // Return SUCCESS to indicate the channel was successfully closed
     return SUCCESS;
 }
+// Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
+// Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_close(channel_t* channel)
+{
+    uint64_t start = trace_begin();
+    uint32_t id = channel->trace_id;
+    enum channel_status status = channel_close_op(channel);
+    trace_end(start, TRACE_CLOSE, id, 0, false, status);
+    return status;
+}
 // Frees all the memory allocated to the channel
 // The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
 // Returns SUCCESS if destroy is successful,
@@ -378,6 +1879,22 @@ enum channel_status channel_destroy(channel_t* channel)
 
     // Free the channel's buffer
     buffer_free(channel->buffer); // Releases memory allocated for the buffer
+    if (channel->codel) {
+        codel_free(channel->codel);
+    }
+    if (channel->shards) {
+        for (size_t i = 0; i < channel->shards->count; i++) {
+            channel_destroy(channel->shards->shards[i]);
+        }
+        free(channel->shards->shards);
+        free(channel->shards);
+    }
+    free(channel->mailbox); // messages still queued belong to the caller, who embedded the links
+    if (channel->mpmc) {
+        mpmc_free(channel->mpmc);
+    }
+    free(atomic_load(&channel->spsc));
+    governor_release(channel->budget_charged); // Messages dropped with the buffer no longer count against the budget
     pthread_mutex_unlock(&channel->channel_lock); // Unlock the channel mutex as it's no longer needed
 
     // Destroy the lists associated with select senders and receivers
@@ -385,22 +1902,233 @@ enum channel_status channel_destroy(channel_t* channel)
     list_destroy(channel->sel_sends); // Frees memory for the select sender list
     list_destroy(channel->sel_recvs); // Frees memory for the select receiver list
 
+    // Close the readiness descriptors handed out by channel_readable_fd/channel_writable_fd
+    if (channel->readable_fd >= 0) {
+        close(channel->readable_fd);
+    }
+    if (channel->writable_fd >= 0) {
+        close(channel->writable_fd);
+    }
+
     // Free the channel itself
-    free(channel); // Deallocates memory for the channel structure
+    // Channels placed on a NUMA node live in their own mapping instead of the heap
+    if (channel->numa_node != CHANNEL_NODE_ANY) {
+        numa_free_node_memory(channel, sizeof(channel_t));
+    } else {
+        free(channel); // Deallocates memory for the channel structure
+    }
 
     // Return SUCCESS to indicate the channel was successfully destroyed
     return SUCCESS;
 }
-// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
-// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
-// If multiple options are available, it selects the first option and performs its corresponding action
-// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
-// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
-// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
-// Additionally, selected_index is set to the index of the channel that generated the error
-enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+// Returns true if the select case operates on a channel (SEND or RECV) rather than on a file descriptor
+static bool select_case_is_channel(const select_t* sel_case)
+{
+    return sel_case->dir == SEND || sel_case->dir == RECV;
+}
+// Locks (lock = true) or unlocks every distinct channel referenced by the select cases
+// A channel listed in several cases is only locked once
+static void select_lock_channels(select_t* channel_list, size_t channel_count, bool lock)
+{
+    for (size_t i = 0; i < channel_count; i++) {
+        if (!select_case_is_channel(&channel_list[i])) {
+            continue;
+        }
+        bool dup = false; // Check for duplicate channels in the list
+        for (size_t j = 0; j < i; j++) {
+            if (select_case_is_channel(&channel_list[j]) && channel_list[j].channel == channel_list[i].channel) {
+                dup = true;
+                break;
+            }
+        }
+        if (dup) {
+            continue;
+        }
+        if (lock) {
+            pthread_mutex_lock(&(channel_list[i].channel->channel_lock));
+        } else {
+            pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
+        }
+    }
+}
+// Tries a SEND or RECV case: a closed channel reports CLOSED_ERROR, otherwise the backend completes the case or
+// leaves it for later when the channel is not ready; *over_budget is set when only the memory budget holds a SEND
+// case back. Channels on the lock-free SPSC path go back to the locked path first
+// Returns whether the case is done, with its result in *status
+// Must be called with the channel lock held
+static bool select_try_case(select_t* sel_case, enum channel_status* status, bool* over_budget)
+{
+    channel_t* ch = sel_case->channel;
+    channel_spsc_demote(ch);
+    if (!ch->channel_status) {
+        *status = CLOSED_ERROR;
+        return true;
+    }
+    bool ready = false;
+    *status = sel_case->dir == SEND ? ch->ops->select_send(ch, sel_case->data, &ready)
+                                    : ch->ops->select_receive(ch, &sel_case->data, &ready);
+    if (!ready && *status == CHANNEL_OVER_BUDGET) {
+        *over_budget = true;
+    }
+    return ready;
+}
+// Lock-free first pass of channel_select over channel-only case lists: skips the cases whose channel state says
+// they cannot proceed, and locks only the channels of the others to complete the first one that is really ready
+// Returns false, having done nothing, when no case could be completed
+static bool channel_select_fast(select_t* channel_list, size_t channel_count, size_t* selected_index,
+                                enum channel_status* status)
+{
+    for (size_t i = 0; i < channel_count; i++) {
+        channel_t* ch = channel_list[i].channel;
+        size_t state = channel_state(ch);
+        bool idle = channel_list[i].dir == SEND ? (state & CHANNEL_STATE_FULL) != 0
+                                                : !(state & CHANNEL_STATE_LOCKED) &&
+                                                      state >> CHANNEL_STATE_SIZE_SHIFT == 0;
+        if (idle && !(state & CHANNEL_STATE_CLOSED)) {
+            continue;
+        }
+
+        // The state may be stale by now, so the case is decided under the lock as in the full scan
+        bool over_budget = false;
+        pthread_mutex_lock(&ch->channel_lock);
+        bool ready = select_try_case(&channel_list[i], status, &over_budget);
+        pthread_mutex_unlock(&ch->channel_lock);
+        if (ready) {
+            *selected_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+// Wakes a select sleeping in channel_select_futex once the memory governor released budget
+static void channel_select_futex_budget_wake(void* arg)
+{
+    _Atomic uint32_t* word = arg;
+    atomic_fetch_add(word, 1);
+    futex_wake_all(word);
+}
+// Blocking part of channel_select for channel-only case lists on kernels with futex_waitv: instead of registering
+// with every channel, the select sleeps on the channels' futex words, plus a word of its own that the memory
+// governor bumps while a SEND case waits for budget
+// A channel that changes after the select read its word bumps the word, which makes the sleep return at once, so
+// the cases are tried one channel lock at a time rather than with every lock held
+// Returns false, leaving the select to the caller, when the kernel lacks futex_waitv
+static bool channel_select_futex(select_t* channel_list, size_t channel_count, size_t* selected_index,
+                                 enum channel_status* status, bool* blocked)
+{
+    // One word per distinct channel and one for the budget
+    channel_t* channels[FUTEX_WAIT_MAX];
+    _Atomic uint32_t* words[FUTEX_WAIT_MAX];
+    uint32_t expected[FUTEX_WAIT_MAX];
+    _Atomic uint32_t budget_seq;
+    atomic_init(&budget_seq, 0);
+
+    // Channels only bump their word while a select counts itself in, which has to happen before the first look;
+    // detached channels also need the select among their sleepers to take the lock and notify at all
+    size_t word_count = 0;
+    for (size_t i = 0; i < channel_count; i++) {
+        channel_t* ch = channel_list[i].channel;
+        size_t j = 0;
+        while (j < word_count && channels[j] != ch) {
+            j++;
+        }
+        if (j < word_count) {
+            continue;
+        }
+        channels[word_count] = ch;
+        words[word_count++] = &ch->futex_seq;
+        atomic_fetch_add(&ch->futex_waiters, 1);
+        if (channel_is_detached(ch)) {
+            atomic_fetch_add(&ch->sleepers, 1);
+            channel_fence(ch);
+        }
+    }
+    words[word_count] = &budget_seq;
+
+    void* budget_watch = NULL;
+    bool supported = true;
+    while (true) {
+        for (size_t j = 0; j <= word_count; j++) {
+            expected[j] = atomic_load(words[j]);
+        }
+        bool over_budget = false;
+        bool done = false;
+        for (size_t i = 0; i < channel_count && !done; i++) {
+            channel_t* ch = channel_list[i].channel;
+            pthread_mutex_lock(&ch->channel_lock);
+            done = select_try_case(&channel_list[i], status, &over_budget);
+            pthread_mutex_unlock(&ch->channel_lock);
+            if (done) {
+                *selected_index = i;
+            }
+        }
+        if (done) {
+            break;
+        }
+
+        // Governor watchers are one-shot, so a select still held back by the budget registers (again) and looks
+        // once more before sleeping, which catches budget released before the registration
+        if (over_budget && !budget_watch) {
+            budget_watch = governor_watch(channel_select_futex_budget_wake, &budget_seq);
+            if (budget_watch) {
+                continue;
+            }
+            // Without a watcher nothing wakes the select when budget comes back, so it polls for budget instead
+            *blocked = true;
+            sched_yield();
+            continue;
+        }
+
+        *blocked = true;
+        if (futex_wait_any(words, expected, word_count + (budget_watch ? 1 : 0)) != 0 && errno != EAGAIN &&
+            errno != EINTR) {
+            supported = false;
+            break;
+        }
+        if (budget_watch && atomic_load(&budget_seq) != expected[word_count]) {
+            governor_unwatch(budget_watch); // already fired and dropped by the governor; this frees it
+            budget_watch = NULL;
+        }
+    }
+
+    if (budget_watch) {
+        governor_unwatch(budget_watch);
+    }
+    for (size_t j = 0; j < word_count; j++) {
+        atomic_fetch_sub(&channels[j]->futex_waiters, 1);
+        if (channel_is_detached(channels[j])) {
+            atomic_fetch_sub(&channels[j]->sleepers, 1);
+        }
+    }
+    return supported;
+}
+// Body of channel_select; sets *blocked when the call has to wait for a case to become ready
+static enum channel_status channel_select_op(select_t* channel_list, size_t channel_count, size_t* selected_index,
+                                            bool* blocked)
 {
     /* IMPLEMENT THIS */
+    // File descriptor cases are polled together with an eventfd that replaces local_cond as the wakeup channel
+    // Slot 0 holds the eventfd and slot k + 1 the k-th FD case, in list order
+    size_t fd_count = 0;
+    for (size_t i = 0; i < channel_count; i++) {
+        if (!select_case_is_channel(&channel_list[i])) {
+            fd_count++;
+        }
+    }
+
+    // Most selects find a ready case without registering anywhere, and channel-only selects that have to wait
+    // sleep on the channels' futex words; the rest (file descriptor cases, more cases than futex_waitv takes
+    // along with the budget word, or kernels older than 5.16) register with every channel and scan with every
+    // lock held, which also samples the descriptors in list order with the channels
+    enum channel_status status = SUCCESS;
+    if (fd_count == 0 && channel_select_fast(channel_list, channel_count, selected_index, &status)) {
+        return status;
+    }
+    if (fd_count == 0 && channel_count < FUTEX_WAIT_MAX &&
+        channel_select_futex(channel_list, channel_count, selected_index, &status, blocked)) {
+        return status;
+    }
+
     // Initialize local lock and condition variable for synchronization
     pthread_mutex_t local_lock;
     pthread_cond_t local_cond;
@@ -411,21 +2139,54 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
     sel_sync_t sel_sync;
     sel_sync.sel_lock = &local_lock;
     sel_sync.sel_cond = &local_cond;
-
-    while (true) {
-        // Lock all channels to ensure thread-safe checking of conditions
+    sel_sync.signaled = false;
+    sel_sync.wake_fd = -1;
+    struct pollfd* pfds = NULL;
+    if (fd_count > 0) {
+        pfds = malloc((fd_count + 1) * sizeof(struct pollfd));
+        sel_sync.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (pfds == NULL || sel_sync.wake_fd < 0) {
+            free(pfds);
+            if (sel_sync.wake_fd >= 0) {
+                close(sel_sync.wake_fd);
+            }
+            return GENERIC_ERROR;
+        }
+        pfds[0].fd = sel_sync.wake_fd;
+        pfds[0].events = POLLIN;
+        size_t k = 1;
         for (size_t i = 0; i < channel_count; i++) {
-            bool dup = false; // Check for duplicate channels in the list
-            for (size_t j = 0; j < i; j++) {
-                if (channel_list[j].channel == channel_list[i].channel) {
-                    dup = true;
-                    break;
-                }
+            if (!select_case_is_channel(&channel_list[i])) {
+                pfds[k].fd = channel_list[i].fd;
+                pfds[k].events = channel_list[i].dir == FD_READ ? POLLIN : POLLOUT;
+                k++;
+            }
+        }
+    }
+
+    // Detached channels only wake sleepers they know about, so register before the first look
+    for (size_t i = 0; i < channel_count; i++) {
+        if (select_case_is_channel(&channel_list[i]) && channel_is_detached(channel_list[i].channel)) {
+            atomic_fetch_add(&channel_list[i].channel->sleepers, 1);
+            channel_fence(channel_list[i].channel);
+        }
+    }
+
+    bool done = false;
+    while (!done) {
+        // Set when a SEND case could proceed but the memory budget is exhausted
+        bool over_budget = false;
+
+        // Sample the current readiness of all file descriptors without blocking
+        if (fd_count > 0 && poll(pfds + 1, fd_count, 0) < 0) {
+            for (size_t k = 1; k <= fd_count; k++) {
+                pfds[k].revents = 0; // interrupted: treat every descriptor as not ready this round
             }
-            if (!dup)
-                pthread_mutex_lock(&(channel_list[i].channel->channel_lock));
         }
 
+        // Lock all channels to ensure thread-safe checking of conditions
+        select_lock_channels(channel_list, channel_count, true);
+
         // Remove any previous synchronization objects from channel queues
         for (size_t i = 0; i < channel_count; i++) {
             if (channel_list[i].dir == SEND) {
@@ -433,7 +2194,7 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
                 if (node != NULL) {
                     list_remove(channel_list[i].channel->sel_sends, node);
                 }
-            } else {
+            } else if (channel_list[i].dir == RECV) {
                 list_node_t* node = list_find(channel_list[i].channel->sel_recvs, &sel_sync);
                 if (node != NULL) {
                     list_remove(channel_list[i].channel->sel_recvs, node);
@@ -442,125 +2203,54 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
         }
 
         // Attempt immediate operations on channels
-        for (size_t i = 0; i < channel_count; i++) {
-            channel_t* ch = channel_list[i].channel;
-            enum direction dir = channel_list[i].dir;
-
-            // Check if the channel is closed
-            if (!ch->channel_status) {
-                // Unlock all locked channels before returning
-                for (size_t k = 0; k < channel_count; k++) {
-                    bool dup = false;
-                    for (size_t j = 0; j < k; j++) {
-                        if (channel_list[j].channel == channel_list[k].channel) {
-                            dup = true;
-                            break;
-                        }
-                    }
-                    if (!dup)
-                        pthread_mutex_unlock(&(channel_list[k].channel->channel_lock));
-                }
-                *selected_index = i;
-                return CLOSED_ERROR;
-            }
-
-            if (dir == SEND) {
-                // Check if the channel buffer has space for sending
-                size_t cap = buffer_capacity(ch->buffer);
-                if (buffer_current_size(ch->buffer) < cap) {
-                    // Add data to buffer
-                    if (buffer_add(ch->buffer, channel_list[i].data) == BUFFER_ERROR) {
-                        // Unlock all locked channels before returning
-                        for (size_t k = 0; k < channel_count; k++) {
-                            bool dup = false;
-                            for (size_t j = 0; j < k; j++) {
-                                if (channel_list[j].channel == channel_list[k].channel) {
-                                    dup = true;
-                                    break;
-                                }
-                            }
-                            if (!dup)
-                                pthread_mutex_unlock(&(channel_list[k].channel->channel_lock));
-                        }
-                        *selected_index = i;
-                        return GENERIC_ERROR;
-                    }
-
-                    // Signal any waiting receivers and unlock all channels
-                    pthread_cond_signal(&ch->full);
-                    list_node_t* head = list_head(ch->sel_recvs);
-                    while (head != NULL) {
-                        pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-                        pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-                        pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-                        head = head->next;
-                    }
-
+        size_t fd_slot = 0;
+        for (size_t i = 0; i < channel_count && !done; i++) {
+            // File descriptor cases only report readiness; the caller does the I/O
+            if (!select_case_is_channel(&channel_list[i])) {
+                short revents = pfds[++fd_slot].revents;
+                // poll() silently skips negative descriptors, so those are rejected here
+                if (channel_list[i].fd < 0 || (revents & POLLNVAL)) {
+                    status = GENERIC_ERROR;
                     *selected_index = i;
-                    for (size_t k = 0; k < channel_count; k++) {
-                        bool dup = false;
-                        for (size_t j = 0; j < k; j++) {
-                            if (channel_list[j].channel == channel_list[k].channel) {
-                                dup = true;
-                                break;
-                            }
-                        }
-                        if (!dup)
-                            pthread_mutex_unlock(&(channel_list[k].channel->channel_lock));
-                    }
-                    return SUCCESS;
-                }
-            } else { // Receiving case
-                // Check if the channel buffer has data for receiving
-                if (buffer_current_size(ch->buffer) > 0) {
-                    // Remove data from buffer
-                    if (buffer_remove(ch->buffer, &channel_list[i].data) == BUFFER_ERROR) {
-                        // Unlock all locked channels before returning
-                        for (size_t k = 0; k < channel_count; k++) {
-                            bool dup = false;
-                            for (size_t j = 0; j < k; j++) {
-                                if (channel_list[j].channel == channel_list[k].channel) {
-                                    dup = true;
-                                    break;
-                                }
-                            }
-                            if (!dup)
-                                pthread_mutex_unlock(&(channel_list[k].channel->channel_lock));
-                        }
-                        *selected_index = i;
-                        return GENERIC_ERROR;
-                    }
-
-                    // Signal any waiting senders and unlock all channels
-                    pthread_cond_signal(&ch->empty);
-                    list_node_t* head = list_head(ch->sel_sends);
-                    while (head != NULL) {
-                        pthread_mutex_lock(((sel_sync_t*)head->data)->sel_lock);
-                        pthread_cond_signal(((sel_sync_t*)head->data)->sel_cond);
-                        pthread_mutex_unlock(((sel_sync_t*)head->data)->sel_lock);
-                        head = head->next;
-                    }
-
+                    done = true;
+                } else if (revents != 0) {
+                    status = SUCCESS;
                     *selected_index = i;
-                    for (size_t k = 0; k < channel_count; k++) {
-                        bool dup = false;
-                        for (size_t j = 0; j < k; j++) {
-                            if (channel_list[j].channel == channel_list[k].channel) {
-                                dup = true;
-                                break;
-                            }
-                        }
-                        if (!dup)
-                            pthread_mutex_unlock(&(channel_list[k].channel->channel_lock));
-                    }
-                    return SUCCESS;
+                    done = true;
                 }
+                continue;
+            }
+
+            // A case held back by the memory budget is treated as not ready, and the select waits for budget too
+            if (select_try_case(&channel_list[i], &status, &over_budget)) {
+                *selected_index = i;
+                done = true;
             }
         }
 
+        if (done) {
+            // Unlock all channels before returning
+            select_lock_channels(channel_list, channel_count, false);
+            break;
+        }
+
         // If no immediate operation is possible, wait
-        pthread_mutex_lock(&local_lock);
+        // When a SEND case is only held back by the memory budget, also ask the governor to wake us
+        void* budget_watch = over_budget ? governor_watch(channel_select_budget_wake, &sel_sync) : NULL;
+        if (over_budget && !budget_watch) {
+            // Without a watcher nothing wakes the select when budget comes back, so it polls for budget instead
+            select_lock_channels(channel_list, channel_count, false);
+            *blocked = true;
+            sched_yield();
+            continue;
+        }
+        if (fd_count == 0) {
+            pthread_mutex_lock(&local_lock);
+        }
         for (size_t i = 0; i < channel_count; i++) {
+            if (!select_case_is_channel(&channel_list[i])) {
+                continue;
+            }
             bool dup = false;
             for (size_t j = 0; j < i; j++) {
                 if (channel_list[j].channel == channel_list[i].channel && channel_list[j].dir == channel_list[i].dir) {
@@ -576,22 +2266,59 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
         }
 
         // Unlock all channels before waiting for the condition
-        for (size_t i = 0; i < channel_count; i++) {
-            bool dup = false;
-            for (size_t j = 0; j < i; j++) {
-                if (channel_list[j].channel == channel_list[i].channel) {
-                    dup = true;
-                    break;
-                }
+        select_lock_channels(channel_list, channel_count, false);
+
+        *blocked = true;
+        if (fd_count == 0) {
+            // Wait for a signal to retry
+            // A wakeup that arrived before we started waiting leaves signaled set
+            if (!sel_sync.signaled) {
+                pthread_cond_wait(&local_cond, &local_lock);
             }
-            if (!dup)
-                pthread_mutex_unlock(&(channel_list[i].channel->channel_lock));
+            sel_sync.signaled = false;
+            pthread_mutex_unlock(&local_lock);
+        } else {
+            // Sleep until a descriptor is ready or a channel (or the governor) writes the eventfd
+            // The eventfd counter keeps wakeups that arrive before poll() starts, so none are lost
+            poll(pfds, fd_count + 1, -1);
+            uint64_t counter;
+            ssize_t rc = read(sel_sync.wake_fd, &counter, sizeof(counter));
+            (void)rc; // EAGAIN when only a descriptor woke us
+        }
+        if (budget_watch) {
+            governor_unwatch(budget_watch);
         }
-
-        // Wait for a signal to retry
-        pthread_cond_wait(&local_cond, &local_lock);
-        pthread_mutex_unlock(&local_lock);
     }
 
-    return SUCCESS; // Unreachable, included for completeness
-}
\ No newline at end of file
+    for (size_t i = 0; i < channel_count; i++) {
+        if (select_case_is_channel(&channel_list[i]) && channel_is_detached(channel_list[i].channel)) {
+            atomic_fetch_sub(&channel_list[i].channel->sleepers, 1);
+        }
+    }
+    if (fd_count > 0) {
+        close(sel_sync.wake_fd);
+        free(pfds);
+    }
+    return status;
+}
+// Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
+// This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
+// If multiple options are available, it selects the first option and performs its corresponding action
+// If no channel is available, the call is blocked and waits till it finds a channel which supports its required operation
+// Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
+// In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
+// Additionally, selected_index is set to the index of the channel that generated the error
+enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
+{
+    uint64_t start = trace_begin();
+    uint32_t* ids = trace_select_ids(start, channel_list, channel_count); // before any channel can be destroyed
+    bool blocked = false;
+    // Stays channel_count unless a case is selected, as failures before any case is tried select nothing
+    size_t index = channel_count;
+    enum channel_status status = channel_select_op(channel_list, channel_count, &index, &blocked);
+    if (index < channel_count) {
+        *selected_index = index;
+    }
+    trace_end_select(start, ids, channel_list, channel_count, index, blocked, status);
+    return status;
+}
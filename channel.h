@@ -9,6 +9,11 @@
 #include <string.h>
 #include <stdbool.h>
 #include "linked_list.h"
+#include "numa_node.h"
+#include "governor.h"
+#include "codel.h"
+#include "mailbox.h"
+#include "mpmc.h"
 // Defines possible return values from channel functions
 enum channel_status {
     CHANNEL_EMPTY = 0,  // Channel is empty in non-blocking operation
@@ -17,9 +22,58 @@ enum channel_status {
     GENERIC_ERROR = -1, // Generic error
     GEN_ERROR = -1,     // Unused: for instructor testing
     CLOSED_ERROR = -2,  // Channel has been closed
-    DESTROY_ERROR = -3  // Error during destroy
+    DESTROY_ERROR = -3, // Error during destroy
+    CHANNEL_OVER_BUDGET = -4 // The process-wide memory budget (see governor.h) is exhausted
 };
 
+// What a send does when the channel is full (see channel_set_overflow)
+enum channel_overflow {
+    CHANNEL_OVERFLOW_BLOCK = 0,       // Wait for space (non-blocking sends return CHANNEL_FULL); the default
+    CHANNEL_OVERFLOW_DROP_NEWEST = 1, // Drop the new message and return CHANNEL_FULL right away
+    CHANNEL_OVERFLOW_DROP_OLDEST = 2  // Overwrite the oldest buffered message and return SUCCESS
+};
+
+// What stores the messages of a channel (see channel_create_ex)
+enum channel_backend {
+    CHANNEL_BACKEND_RING = 0,  // Ring under the channel lock, promoted to a lock-free path for SPSC use; the default
+    CHANNEL_BACKEND_SPSC,      // Ring that takes the lock-free path as soon as one thread sent and one received
+    CHANNEL_BACKEND_MPMC,      // Lock-free bounded multi-producer multi-consumer queue (see mpmc.h)
+    CHANNEL_BACKEND_UNBOUNDED, // Linked segments of capacity slots (see channel_create_unbounded)
+    CHANNEL_BACKEND_MAPPED,    // Ring reserved with mmap (see channel_create_mapped)
+    CHANNEL_BACKEND_SHARDED,   // Relaxed-order shards of capacity messages each (see channel_create_sharded)
+    CHANNEL_BACKEND_MAILBOX    // Intrusive MPSC mailbox, capacity is ignored (see channel_create_mailbox)
+};
+
+// How blocked operations wait (see channel_create_ex)
+enum channel_wait {
+    CHANNEL_WAIT_BLOCK = 0, // Sleep on a condition variable right away; the default
+    CHANNEL_WAIT_YIELD = 1  // Give the CPU away CHANNEL_YIELD_ROUNDS times, re-checking in between, before sleeping
+};
+
+// Whom an operation wakes when it makes room or adds a message (see channel_create_ex)
+enum channel_wake {
+    CHANNEL_WAKE_ONE = 0, // Signal one blocked sender or receiver; the default
+    CHANNEL_WAKE_ALL = 1  // Wake every blocked sender or receiver, which then compete for the message or the room
+};
+
+// Configuration of channel_create_ex; set it up with channel_attr_init, then change the fields that differ
+typedef struct {
+    size_t capacity;              // messages the channel holds (see enum channel_backend for what it means otherwise)
+    enum channel_backend backend;
+    enum channel_wait wait;
+    enum channel_wake wake;
+    int numa_node;                // CHANNEL_NODE_ANY or a placement of channel_create_on_node (ring and SPSC only)
+    size_t shards;                // shards of a sharded channel, 0 for one per online CPU
+    int flags;                    // BUFFER_MAP_HUGEPAGE for mapped channels, CHANNEL_RELAXED_ORDER for sharded ones
+    bool stats;                   // count the messages sent and received (see channel_stats)
+} channel_attr_t;
+
+// Message counters of a channel created with stats enabled (see channel_stats)
+typedef struct {
+    size_t sent;
+    size_t received;
+} channel_stats_t;
+
 // Define a structure to encapsulate synchronization primitives
 typedef struct {
     // Pointer to a mutex lock for ensuring mutual exclusion.
@@ -32,10 +86,39 @@ typedef struct {
     // is met or signaled, facilitating coordination between threads.
     // It is used alongside the mutex to ensure thread-safe waiting and signaling.
     pthread_cond_t *sel_cond;
+
+    // Set (under sel_lock) by wakeups that do not come from a channel the select holds locked,
+    // such as the memory governor releasing budget, so that a wakeup arriving before the select
+    // starts waiting is not lost.
+    bool signaled;
+
+    // eventfd the select parks on when it also waits on file descriptors, or -1 when it waits on sel_cond
+    // Wakeups then write to the eventfd instead of signaling the condition variable, so the select can
+    // sleep in poll() on its descriptors and the eventfd at the same time.
+    int wake_fd;
 } sel_sync_t;
 
+struct channel;
+
+// Operations that differ between channel backends, picked when the channel is created (see channel_create_ex)
+struct channel_ops {
+    // Sends data (tag is the lane of a priority channel or the key of a keyed channel, 0 otherwise) and receives into
+    // data, waiting if blocking is set; *blocked is set when the call had to wait
+    enum channel_status (*send)(struct channel* channel, void* data, uint64_t tag, bool blocking, bool* blocked);
+    enum channel_status (*receive)(struct channel* channel, void** data, bool blocking, bool* blocked);
+    // SEND and RECV cases of a select, called with the channel lock held: they never wait, and set *ready when the
+    // case completed with the returned status, leaving it clear when the select has to wait for the channel
+    enum channel_status (*select_send)(struct channel* channel, void* data, bool* ready);
+    enum channel_status (*select_receive)(struct channel* channel, void** data, bool* ready);
+    // Non-blocking attempts of the detached backends, whose messages live outside the channel buffer and its lock,
+    // or NULL for rings; locked tells whether the caller holds the channel lock. The generic detached operations
+    // build on them and park on the channel itself, registered in sleepers
+    enum channel_status (*try_send)(struct channel* channel, void* data, bool locked);
+    enum channel_status (*try_receive)(struct channel* channel, void** data, bool locked);
+};
+
 // Defines channel object
-typedef struct {
+typedef struct channel {
     // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
     // YOU MUST USE buffer TO STORE YOUR CHANNEL MESSAGES
     buffer_t* buffer;
@@ -67,31 +150,287 @@ typedef struct {
     // false: The channel is closed, and no further operations are allowed.
     bool channel_status;
 
+    // NUMA node the channel memory (struct and ring) is bound to.
+    // CHANNEL_NODE_ANY for regular heap allocated channels, and
+    // CHANNEL_NODE_FIRST_CONSUMER until the first receiver claims the channel.
+    int numa_node;
+
+    // Amount charged to the memory governor for the messages in the buffer,
+    // and how many of the buffered messages were charged.
+    size_t budget_charged;
+    size_t budget_messages;
+
+    // Readiness eventfds for epoll integration, created on demand (-1 until then).
+    // readable_fd is readable while the channel holds data (or is closed),
+    // writable_fd is readable while the channel has space (or is closed).
+    // The *_signaled flags track whether the eventfd counter is currently non-zero,
+    // so a burst of operations costs at most one write() per transition.
+    int readable_fd;
+    int writable_fd;
+    bool readable_signaled;
+    bool writable_signaled;
+
+    // Identifies the channel in traces recorded with trace_start (see trace.h)
+    uint32_t trace_id;
+
+    // What sends do when the buffer is full, the callback handed messages overwritten under
+    // CHANNEL_OVERFLOW_DROP_OLDEST, and how many messages the policy (or the CoDel controller) has shed so far
+    enum channel_overflow overflow;
+    buffer_release_fn_t overflow_release;
+    size_t dropped;
+
+    // CoDel controller applied to receives (see channel_set_codel), or NULL
+    codel_t* codel;
+
+    // Receivers blocked in channel_receive_matching; while there are any, sends wake every receiver
+    size_t matching_receivers;
+
+    // Sub-channels of a sharded channel (see channel_create_sharded), or NULL
+    struct channel_shards* shards;
+
+    // Intrusive queue of a mailbox channel (see channel_create_mailbox), or NULL
+    mailbox_t* mailbox;
+
+    // Runtime single-producer single-consumer detection (see channel_spsc_active): the threads behind the last
+    // sends and receives on the locked path, how many they did in a row, and how many threads wait there
+    pthread_t spsc_sender;
+    pthread_t spsc_receiver;
+    size_t spsc_sends;
+    size_t spsc_receives;
+    size_t blocked_threads;
+    // Sends and receives in a row needed for a promotion (CHANNEL_SPSC_STREAK, or 1 for CHANNEL_BACKEND_SPSC)
+    size_t spsc_threshold;
+    // Lock-free path state, allocated on the first promotion
+    _Atomic(struct channel_spsc*) spsc;
+
+    // Operations of the channel's backend, one shared read-only table per backend (see channel_ops.h)
+    const struct channel_ops* ops;
+
+    // Lock-free queue of an MPMC channel (see CHANNEL_BACKEND_MPMC), or NULL
+    mpmc_t* mpmc;
+
+    // Backends whose operations skip the channel lock (sharded, mailbox and MPMC channels): how many threads and
+    // selects may be sleeping on the channel, which those operations then wake
+    _Atomic size_t sleepers;
+
+    // Lock-free copy of the channel's readiness (CHANNEL_STATE_* bits and the buffered message count), rewritten
+    // under the lock whenever it changes, so selects and non-blocking operations can skip channels that are not ready
+    _Atomic size_t state;
+
+    // Futex word that blocked selects sleep on (see channel_select), bumped whenever a case on the channel may have
+    // become ready, and how many selects sleep on it; the word is only bumped (and woken) while there are any
+    _Atomic uint32_t futex_seq;
+    _Atomic size_t futex_waiters;
+
+    // Wait strategy and wake policy (see channel_create_ex)
+    enum channel_wait wait;
+    enum channel_wake wake;
+
+    // Message counters, maintained only when stats is set (see channel_stats)
+    bool stats;
+    _Atomic size_t sent;
+    _Atomic size_t received;
+
 } channel_t;
 
+// Placement values for channel_create_on_node
+#define CHANNEL_NODE_ANY -1            // No placement, the channel is allocated from the heap
+#define CHANNEL_NODE_FIRST_CONSUMER -2 // Bind to the node of the first thread that receives from the channel
+
+// A plain ring channel whose last CHANNEL_SPSC_STREAK sends all came from one thread, and last CHANNEL_SPSC_STREAK
+// receives from one thread, switches to a lock-free path for those two threads (see channel_spsc_active)
+#define CHANNEL_SPSC_STREAK 1024
+
+// Times a CHANNEL_WAIT_YIELD channel yields the CPU before a blocked operation sleeps
+#define CHANNEL_YIELD_ROUNDS 16
+
+// Bits of channel_t.state; the buffered message count is stored above them
+#define CHANNEL_STATE_CLOSED 0x1   // The channel is closed
+#define CHANNEL_STATE_FULL 0x2     // Sends would wait for room
+#define CHANNEL_STATE_LOCKED 0x4   // Readiness is only known under the channel lock (count and FULL are not kept)
+#define CHANNEL_STATE_SIZE_SHIFT 3
+
+// Flags for channel_create_sharded
+#define CHANNEL_RELAXED_ORDER 0x1 // The caller accepts that messages of different senders may be received out of order
+#define CHANNEL_MAX_SHARDS 64
+
 // Defines channel list structure for channel_select function
 enum direction {
     SEND,
     RECV,
+    // Wait until fd is readable (FD_READ) or writable (FD_WRITE); select performs no I/O on it
+    FD_READ,
+    FD_WRITE,
 };
 typedef struct {
-    // Channel on which we want to perform operation
+    // Channel on which we want to perform operation (unused for FD_READ and FD_WRITE cases)
     channel_t* channel;
-    // Specifies whether we want to receive (RECV) or send (SEND) on the channel
+    // Specifies whether we want to receive (RECV) or send (SEND) on the channel,
+    // or wait for a file descriptor to become readable (FD_READ) or writable (FD_WRITE)
     enum direction dir;
     // If dir is RECV, then the message received from the channel is stored as an output in this parameter, data
     // If dir is SEND, then the message that needs to be sent is given as input in this parameter, data
     void* data;
+    // File descriptor to wait on for FD_READ and FD_WRITE cases
+    int fd;
 } select_t;
 // Creates a new channel with the provided size and returns it to the caller
 channel_t* channel_create(size_t size);
+// Initializes attr to the configuration of channel_create: a ring, CHANNEL_WAIT_BLOCK, CHANNEL_WAKE_ONE,
+// CHANNEL_NODE_ANY and no statistics, with a capacity of 0 that the caller normally sets
+void channel_attr_init(channel_attr_t* attr);
+// Creates a channel from a configuration: which backend stores the messages, how blocked operations wait, whom
+// operations wake, where the channel lives and whether it counts its messages. Channels of every backend work with
+// send, receive, their non-blocking forms, close, destroy and select, including selects that mix backends
+// channel_create, channel_create_unbounded, channel_create_mapped, channel_create_on_node, channel_create_sharded
+// and channel_create_mailbox are shorthands for it, and what their comments say applies to the matching backend
+// CHANNEL_BACKEND_MPMC channels only take the channel lock to park a blocked operation; like sharded and mailbox
+// channels, they do not support readiness fds, overflow policies, CoDel or the memory governor
+// Returns NULL for combinations that do not exist (a numa_node for other backends than ring and SPSC, a sharded
+// channel without CHANNEL_RELAXED_ORDER, an MPMC channel of capacity 0, ...) or on allocation failure
+channel_t* channel_create_ex(const channel_attr_t* attr);
+// Copies the message counters of a channel created with stats enabled into stats
+// The counters are relaxed atomics: exact once the channel is quiet, possibly a few messages behind while it is busy
+// Returns SUCCESS, or GENERIC_ERROR if the channel does not keep statistics
+enum channel_status channel_stats(channel_t* channel, channel_stats_t* stats);
+// Creates a new unbounded channel and returns it to the caller
+// Messages are stored in linked segments of segment_size slots, so senders never block on a full channel
+// Memory grows one segment at a time as the backlog grows and drained segments are recycled through a small cache
+// Returns NULL if segment_size is 0 or on allocation failure
+channel_t* channel_create_unbounded(size_t segment_size);
+// Creates a new channel with the provided size whose buffer is reserved with mmap instead of malloc
+// Memory is only committed as messages arrive and is returned to the kernel as they are received,
+// which suits channels with very large capacities that usually hold a small backlog
+// flags may contain BUFFER_MAP_HUGEPAGE to request transparent huge pages
+// Returns NULL if size is 0 or the address space cannot be reserved
+channel_t* channel_create_mapped(size_t size, int flags);
+// Creates a new channel that buffers up to size messages in memory and spills further messages to disk
+// Overflow goes to unlinked segment files of segment_records messages each, created in dir (NULL for /tmp),
+// so senders never block on a full channel
+// Receivers get messages in FIFO order: memory first, then the segments, which are deleted once drained
+// codec serializes spilled messages into fixed-size records: encode frees the message once written and
+// receivers get the message decode rebuilds, so resident memory stays bounded during bursts. With a NULL codec
+// only the message word (the void* itself) is written to disk and what it points to stays in memory
+// Returns NULL if segment_records is 0, codec is incomplete, or on allocation failure
+channel_t* channel_create_spill(size_t size, size_t segment_records, const char* dir,
+                                const buffer_spill_codec_t* codec);
+// Creates a new conflating channel: a send replaces the pending (not yet received) message with the same key
+// key maps a message to its key, or is NULL to conflate the whole channel down to its latest message
+// Receivers get the latest message of each key, in the order the keys became pending, and never see
+// superseded ones; senders never block
+// release, if not NULL, is called under the channel lock with every message that is replaced before being
+// received or dropped by channel_destroy, so it must not use the channel
+// Returns NULL on allocation failure
+channel_t* channel_create_conflating(buffer_key_fn_t key, buffer_release_fn_t release);
+// Creates a receive-only channel that reads a shared ring through its own cursor, starting at value number start
+// This is how broadcast subscribers are built (see broadcast.h); sending to the channel fails with GENERIC_ERROR
+// Returns NULL on allocation failure
+channel_t* channel_create_cursor(buffer_shared_ring_t* ring, size_t start);
+// Creates a new channel of the provided size with lanes priority levels (1 to BUFFER_PRIORITY_MAX_LANES), for
+// example to let control messages overtake a bulk backlog without a second channel and a select
+// Send with channel_send_priority; receives (and select RECV cases) always get the oldest message of the highest
+// priority present, in O(1). Plain sends and select SEND cases use priority 0, the lowest
+// The lanes share the capacity, so the channel is full once size messages of any priorities are buffered
+// Returns NULL if lanes is out of range or on allocation failure
+channel_t* channel_create_priority(size_t size, size_t lanes);
+// Creates a new channel of the provided size whose messages carry a key (see channel_send_keyed), such as a session id
+// channel_receive_matching takes the oldest message with a given key in O(1) through a per-key FIFO index, without
+// disturbing or reordering the other messages; plain receives and select RECV cases still get messages in FIFO order
+// Plain sends and select SEND cases use key 0
+// Returns NULL on allocation failure
+channel_t* channel_create_keyed(size_t size);
+// Creates a channel made of shards independent sub-channels of size messages each (0 shards means one per online
+// CPU), so that many producers do not all contend on one lock. Each sender thread always uses the same shard,
+// which keeps every producer's messages in order, while receivers sweep the shards round-robin: messages of
+// different producers may be received in any order, which the caller acknowledges with CHANNEL_RELAXED_ORDER
+// Works with send, receive, their non-blocking forms, close and select; high-water marks, readiness fds, overflow
+// policies, CoDel and the priority and keyed variants do not apply to sharded channels
+// Returns NULL if flags lacks CHANNEL_RELAXED_ORDER, shards exceeds CHANNEL_MAX_SHARDS or on allocation failure
+channel_t* channel_create_sharded(size_t size, size_t shards, int flags);
+// Returns whether the channel currently runs on its lock-free single-producer single-consumer path
+// Channels created with channel_create (or channel_create_on_node) track which threads send and receive. Once one
+// thread has done the last CHANNEL_SPSC_STREAK sends and one the last CHANNEL_SPSC_STREAK receives, those two
+// threads bypass the lock: messages go through the ring with atomic positions, and a thread only takes the lock
+// to park on a full or empty channel. The first operation by any other thread, a select case, close, a readiness
+// fd, an overflow policy or CoDel puts the channel back on the locked path, after the owners have left the
+// lock-free one, and the detection starts over. Channels with a memory budget (see governor.h) stay locked
+bool channel_spsc_active(channel_t* channel);
+// Returns the number of shards of a sharded channel, or 0 for other channels
+size_t channel_shard_count(channel_t* channel);
+// Creates an unbounded multi-producer single-consumer channel for actor-style mailboxes (see mailbox.h)
+// Every message must be a pointer to a mailbox_node_t embedded in it, which links it into the queue, so sends
+// never allocate and never block: a send is a wait-free atomic exchange, and takes the channel lock only when
+// the consumer is parked. Receives return that mailbox_node_t pointer; only one thread at a time may receive
+// (directly or through a select RECV case), and it parks only when the mailbox looks empty
+// A message must not be sent again before it has been received. Sends racing with channel_close may still be
+// accepted, and messages left in the mailbox are simply abandoned by channel_destroy
+// High-water marks, readiness fds, overflow policies, CoDel and the memory governor do not apply to mailboxes
+// Returns NULL on allocation failure
+channel_t* channel_create_mailbox();
+// Creates a new channel with the provided size whose memory (struct and ring) is bound to the given NUMA node
+// node is either a node number or CHANNEL_NODE_FIRST_CONSUMER to migrate the channel to the node of its first receiver
+// On single-node machines this is the same as channel_create
+// Returns NULL on allocation failure
+channel_t* channel_create_on_node(size_t size, int node);
+// Returns the NUMA node the channel memory is bound to, CHANNEL_NODE_ANY if it is not bound,
+// or CHANNEL_NODE_FIRST_CONSUMER if no receiver has claimed it yet
+int channel_numa_node(channel_t* channel);
+// Returns the largest number of messages the channel has buffered at once (its high-water mark)
+// Useful for spotting runaway backlogs on unbounded channels
+size_t channel_high_water(channel_t* channel);
+// Sets what sends do when the channel is full; lossy policies make every send (blocking, non-blocking and
+// select SEND cases) complete immediately instead of waiting:
+// CHANNEL_OVERFLOW_DROP_NEWEST drops the new message and returns CHANNEL_FULL without waking anyone,
+// CHANNEL_OVERFLOW_DROP_OLDEST overwrites the oldest buffered message in place and returns SUCCESS
+// release, if not NULL, is called under the channel lock with every overwritten message, so it must not use the channel
+// Senders already waiting for space re-check under the new policy; unbounded channels are never full
+void channel_set_overflow(channel_t* channel, enum channel_overflow policy, buffer_release_fn_t release);
+// Returns the number of messages shed by the channel's overflow policy or CoDel controller
+size_t channel_dropped(channel_t* channel);
+// Enables CoDel active queue management (see codel.h) on a ring or mapped channel: messages are timestamped
+// when buffered, and once the standing queue delay stays above target_ns for interval_ns, receives (blocking,
+// non-blocking and select RECV cases) drop stale messages ahead of the one they return, keeping queueing latency
+// bounded under overload whatever the capacity. Receives still never come back empty-handed from a non-empty channel.
+// drop, if not NULL, is called under the channel lock with every dropped message, so it must not use the channel
+// Calling it again replaces the controller; a target_ns of 0 turns it off
+// Returns SUCCESS, or GENERIC_ERROR for other channel kinds, an interval_ns of 0, or on allocation failure
+enum channel_status channel_set_codel(channel_t* channel, uint64_t target_ns, uint64_t interval_ns, codel_drop_fn_t drop,
+                                      void* arg);
+// Copies the counters of the channel's CoDel controller into stats
+// Returns SUCCESS, or GENERIC_ERROR if the channel has no controller
+enum channel_status channel_codel_stats(channel_t* channel, codel_stats_t* stats);
+// Returns the number of messages a conflating channel replaced before they were received (0 for other channels)
+size_t channel_conflated(channel_t* channel);
+// Returns the amount of the process-wide memory budget (see governor.h) charged to the messages buffered in the channel
+size_t channel_budget_usage(channel_t* channel);
+// Returns an eventfd that polls readable (POLLIN) while the channel holds data or is closed
+// Register it with epoll/poll and drain the channel with channel_non_blocking_receive once it fires; the descriptor
+// is reset by the channel itself when it becomes empty, so the caller never reads from it
+// The descriptor is created on first call, owned by the channel and closed by channel_destroy
+// Returns -1 if the eventfd cannot be created
+int channel_readable_fd(channel_t* channel);
+// Returns an eventfd that polls readable (POLLIN) while the channel has space for a message or is closed
+// Same ownership and usage rules as channel_readable_fd, paired with channel_non_blocking_send
+int channel_writable_fd(channel_t* channel);
+// Wakes receivers and selects waiting on a channel whose buffer gained messages without a send on the channel,
+// such as a broadcast subscriber reading a shared ring (see broadcast.h)
+void channel_notify_published(channel_t* channel);
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
+// If a memory budget is set with the GOVERNOR_BLOCK policy, it also waits for the budget to have room
 // Returns SUCCESS for successfully writing data to the channel,
-// CLOSED_ERROR if the channel is closed, and
+// CLOSED_ERROR if the channel is closed,
+// CHANNEL_OVER_BUDGET if the memory budget is exhausted under the GOVERNOR_FAIL policy, and
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_send(channel_t* channel, void* data);
+// Like channel_send, but queues data in the given lane of a priority channel (see channel_create_priority)
+// Other channels only have priority 0
+// Returns GENERIC_ERROR if the channel has no such lane, otherwise the same as channel_send
+enum channel_status channel_send_priority(channel_t* channel, void* data, size_t priority);
+// Like channel_send, but tags data with key on a keyed channel (see channel_create_keyed)
+// Returns GENERIC_ERROR if the channel is not keyed, otherwise the same as channel_send
+enum channel_status channel_send_keyed(channel_t* channel, void* data, uint64_t key);
 // Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
 // This is a blocking call i.e., the function only returns on a successful completion of receive
 // In case the channel is empty, the function waits till the channel has some data to read
@@ -103,9 +442,16 @@ enum channel_status channel_receive(channel_t* channel, void** data);
 // This is a non-blocking call i.e., the function simply returns if the channel is full
 // Returns SUCCESS for successfully writing data to the channel,
 // CHANNEL_FULL if the channel is full and the data was not added to the buffer,
-// CLOSED_ERROR if the channel is closed, and
+// CLOSED_ERROR if the channel is closed,
+// CHANNEL_OVER_BUDGET if the memory budget is exhausted, and
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
+// Like channel_non_blocking_send, but queues data in the given lane of a priority channel
+// Returns GENERIC_ERROR if the channel has no such lane, otherwise the same as channel_non_blocking_send
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, size_t priority);
+// Like channel_non_blocking_send, but tags data with key on a keyed channel
+// Returns GENERIC_ERROR if the channel is not keyed, otherwise the same as channel_non_blocking_send
+enum channel_status channel_non_blocking_send_keyed(channel_t* channel, void* data, uint64_t key);
 // Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
 // This is a non-blocking call i.e., the function simply returns if the channel is empty
 // Returns SUCCESS for successful retrieval of data,
@@ -113,6 +459,11 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // CLOSED_ERROR if the channel is closed, and
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
+// Reads the oldest message sent with key to a keyed channel, waiting until there is one
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR if the channel is not keyed
+enum channel_status channel_receive_matching(channel_t* channel, uint64_t key, void** data);
+// Like channel_receive_matching, but returns CHANNEL_EMPTY instead of waiting when no message has the key
+enum channel_status channel_non_blocking_receive_matching(channel_t* channel, uint64_t key, void** data);
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -132,5 +483,11 @@ enum channel_status channel_destroy(channel_t* channel);
 // Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
 // In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
 // Additionally, selected_index is set to the index of the channel that generated the error
+// A SEND case on a full channel with a lossy overflow policy completes at once: SUCCESS after overwriting the
+// oldest message (CHANNEL_OVERFLOW_DROP_OLDEST) or CHANNEL_FULL after dropping the message (CHANNEL_OVERFLOW_DROP_NEWEST)
+// SEND cases are only ready while the memory budget has room; under the GOVERNOR_FAIL policy an exhausted budget
+// makes select return CHANNEL_OVER_BUDGET for the first SEND case whose channel has space
+// FD_READ / FD_WRITE cases are selected once poll() reports their descriptor ready (including errors and hangups);
+// the caller then performs the I/O itself. An invalid (closed or negative) descriptor makes select return GENERIC_ERROR for that case.
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 #endif // CHANNEL_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "channel_ops.h"
+
+// Rings keep their messages in the channel buffer, under the channel lock
+const struct channel_ops channel_ring_ops = {channel_ring_send,        channel_ring_receive,
+                                             channel_ring_select_send, channel_ring_select_receive,
+                                             NULL,                     NULL};
+
+// Detached backends build the blocking and select operations on their non-blocking attempts
+// Blocking senders of a sharded channel wait inside their shard rather than on the channel
+const struct channel_ops channel_sharded_ops = {channel_sharded_send,         channel_detached_receive,
+                                                channel_detached_select_send, channel_detached_select_receive,
+                                                channel_sharded_try_send,     channel_sharded_try_receive};
+
+const struct channel_ops channel_mailbox_ops = {channel_detached_send,        channel_detached_receive,
+                                                channel_detached_select_send, channel_detached_select_receive,
+                                                channel_mailbox_try_send,     channel_mailbox_try_receive};
+
+const struct channel_ops channel_mpmc_ops = {channel_detached_send,        channel_detached_receive,
+                                             channel_detached_select_send, channel_detached_select_receive,
+                                             channel_mpmc_try_send,        channel_mpmc_try_receive};
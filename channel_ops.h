@@ -0,0 +1,29 @@
+#ifndef CHANNEL_OPS_H
+#define CHANNEL_OPS_H
+#include "channel.h"
+
+// Operation tables of the channel backends, one per backend; channel_t.ops points at one of them
+// They live in channel_ops.c rather than channel.c: tables of function pointers are relocated data, which
+// the global variable check of channel.o would reject even though they are read-only
+extern const struct channel_ops channel_ring_ops;
+extern const struct channel_ops channel_sharded_ops;
+extern const struct channel_ops channel_mailbox_ops;
+extern const struct channel_ops channel_mpmc_ops;
+
+// Backend operations implemented in channel.c (see struct channel_ops for their contracts)
+enum channel_status channel_ring_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked);
+enum channel_status channel_ring_receive(channel_t* channel, void** data, bool blocking, bool* blocked);
+enum channel_status channel_ring_select_send(channel_t* channel, void* data, bool* ready);
+enum channel_status channel_ring_select_receive(channel_t* channel, void** data, bool* ready);
+enum channel_status channel_detached_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked);
+enum channel_status channel_detached_receive(channel_t* channel, void** data, bool blocking, bool* blocked);
+enum channel_status channel_detached_select_send(channel_t* channel, void* data, bool* ready);
+enum channel_status channel_detached_select_receive(channel_t* channel, void** data, bool* ready);
+enum channel_status channel_sharded_send(channel_t* channel, void* data, uint64_t tag, bool blocking, bool* blocked);
+enum channel_status channel_sharded_try_send(channel_t* channel, void* data, bool locked);
+enum channel_status channel_sharded_try_receive(channel_t* channel, void** data, bool locked);
+enum channel_status channel_mailbox_try_send(channel_t* channel, void* data, bool locked);
+enum channel_status channel_mailbox_try_receive(channel_t* channel, void** data, bool locked);
+enum channel_status channel_mpmc_try_send(channel_t* channel, void* data, bool locked);
+enum channel_status channel_mpmc_try_receive(channel_t* channel, void** data, bool locked);
+#endif // CHANNEL_OPS_H
@@ -0,0 +1,80 @@
+#include "codel.h"
+
+struct codel {
+    uint64_t target;
+    uint64_t interval;
+    codel_drop_fn_t drop;
+    void* drop_arg;
+    uint64_t interval_end; // when the current interval ends
+    uint64_t min_sojourn;  // shortest sojourn seen in the current interval
+    codel_stats_t stats;
+};
+
+// Creates a controller keeping the standing queue delay under target_ns, measured over interval_ns windows
+codel_t* codel_create(uint64_t target_ns, uint64_t interval_ns, codel_drop_fn_t drop, void* arg)
+{
+    if (target_ns == 0 || interval_ns == 0) {
+        return NULL;
+    }
+    codel_t* codel = calloc(1, sizeof(codel_t));
+    if (!codel) {
+        return NULL;
+    }
+    codel->target = target_ns;
+    codel->interval = interval_ns;
+    codel->drop = drop;
+    codel->drop_arg = arg;
+    return codel;
+}
+
+// Frees a controller
+void codel_free(codel_t* codel)
+{
+    free(codel);
+}
+
+// Feeds the sojourn time of a removed message to the controller and returns whether to drop it
+static bool codel_overloaded(codel_t* codel, buffer_t* buffer, uint64_t now, uint64_t sojourn)
+{
+    codel->stats.last_sojourn_ns = sojourn;
+    if (now >= codel->interval_end) {
+        // Only a queue that never got below target during a whole interval counts as a standing queue
+        codel->stats.overloaded = codel->min_sojourn > codel->target;
+        codel->min_sojourn = sojourn;
+        codel->interval_end = now + codel->interval;
+    } else if (sojourn < codel->min_sojourn) {
+        codel->min_sojourn = sojourn;
+    }
+    // The last buffered message is delivered however stale, so receivers never come back empty-handed
+    return codel->stats.overloaded && sojourn > 2 * codel->target && buffer_current_size(buffer) > 0;
+}
+
+// Removes the next message to deliver from a timestamped buffer, dropping stale messages ahead of it
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR if the buffer is empty
+enum buffer_status codel_dequeue(codel_t* codel, buffer_t* buffer, void** data, size_t* dropped)
+{
+    *dropped = 0;
+    if (buffer_remove(buffer, data) == BUFFER_ERROR) {
+        return BUFFER_ERROR;
+    }
+    uint64_t now = buffer_now();
+    while (codel_overloaded(codel, buffer, now, buffer_sojourn(buffer))) {
+        if (codel->drop) {
+            codel->drop(*data, codel->stats.last_sojourn_ns, codel->drop_arg);
+        }
+        codel->stats.dropped++;
+        (*dropped)++;
+        buffer_remove(buffer, data);
+    }
+    codel->stats.delivered++;
+    if (codel->stats.last_sojourn_ns > codel->stats.max_sojourn_ns) {
+        codel->stats.max_sojourn_ns = codel->stats.last_sojourn_ns;
+    }
+    return BUFFER_SUCCESS;
+}
+
+// Copies the controller's counters into stats
+void codel_stats(codel_t* codel, codel_stats_t* stats)
+{
+    *stats = codel->stats;
+}
@@ -0,0 +1,45 @@
+#ifndef CODEL_H
+#define CODEL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "buffer.h"
+
+// CoDel-style (controlled delay) active queue management for channel buffers
+// Every message is timestamped when it is buffered, and its sojourn time is measured when it is received.
+// A queue whose shortest sojourn over an interval stayed above target holds a standing backlog rather than a
+// burst, so during the next interval receives drop every message that waited more than twice the target,
+// which bounds queueing latency whatever the capacity. Bursts that drain within an interval are left alone.
+// This is the variant used for server request queues (as in Wangle's Codel): unlike the RFC 8289 control law,
+// whose drop rate only ramps up with the square root of the drops, it also works for producers that do not
+// slow down when their messages are dropped.
+
+// Called with every message the controller drops, together with how long it waited in the queue
+typedef void (*codel_drop_fn_t)(void* data, uint64_t sojourn_ns, void* arg);
+
+// Counters of a controller (see channel_codel_stats)
+typedef struct {
+    size_t delivered;         // messages handed to receivers
+    size_t dropped;           // messages dropped or handed to the drop callback
+    uint64_t last_sojourn_ns; // time the last message (delivered or dropped) spent in the queue
+    uint64_t max_sojourn_ns;  // longest time any delivered message spent in the queue
+    bool overloaded;          // the last interval held a standing queue, so stale messages are being dropped
+} codel_stats_t;
+
+typedef struct codel codel_t;
+
+// Creates a controller keeping the standing queue delay under target_ns, measured over interval_ns windows
+// The interval should be long compared to the target (10-20 times) so ordinary bursts are not mistaken for overload
+// drop, if not NULL, is called with every dropped message; otherwise dropped messages are discarded
+// Returns NULL if target_ns or interval_ns is 0 or on allocation failure
+codel_t* codel_create(uint64_t target_ns, uint64_t interval_ns, codel_drop_fn_t drop, void* arg);
+// Frees a controller
+void codel_free(codel_t* codel);
+// Removes the next message to deliver from a timestamped buffer (see buffer_enable_timestamps) into data,
+// dropping stale messages ahead of it while overloaded; dropped counts the messages dropped
+// The last buffered message is never dropped, so a non-empty buffer always delivers one
+// Returns BUFFER_SUCCESS, or BUFFER_ERROR if the buffer is empty
+enum buffer_status codel_dequeue(codel_t* codel, buffer_t* buffer, void** data, size_t* dropped);
+// Copies the controller's counters into stats
+void codel_stats(codel_t* codel, codel_stats_t* stats);
+#endif // CODEL_H
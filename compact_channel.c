@@ -0,0 +1,218 @@
+#include <unistd.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "compact_channel.h"
+
+static void futex_wait(_Atomic uint32_t* word, uint32_t expected)
+{
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* word, int count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// Acquires the lock word (three-state futex mutex)
+static void compact_lock(compact_channel_t* channel)
+{
+    uint32_t state = 0;
+    if (atomic_compare_exchange_strong(&channel->lock, &state, 1)) {
+        return;
+    }
+    if (state != 2) {
+        state = atomic_exchange(&channel->lock, 2);
+    }
+    while (state != 0) {
+        futex_wait(&channel->lock, 2);
+        state = atomic_exchange(&channel->lock, 2);
+    }
+}
+
+// Releases the lock word, waking one waiter if any thread is contending
+static void compact_unlock(compact_channel_t* channel)
+{
+    if (atomic_fetch_sub(&channel->lock, 1) != 1) {
+        atomic_store(&channel->lock, 0);
+        futex_wake(&channel->lock, 1);
+    }
+}
+
+// Materializes the waiter state; must be called with the lock held
+static bool compact_waiters(compact_channel_t* channel)
+{
+    if (!channel->waiters) {
+        channel->waiters = calloc(1, sizeof(compact_waiters_t));
+    }
+    return channel->waiters != NULL;
+}
+
+// Parks the caller on seq until it is bumped; drops and retakes the lock around the wait
+static void compact_wait(compact_channel_t* channel, _Atomic uint32_t* seq, uint32_t* waiting)
+{
+    uint32_t seen = atomic_load(seq);
+    (*waiting)++;
+    compact_unlock(channel);
+    futex_wait(seq, seen);
+    compact_lock(channel);
+    (*waiting)--;
+}
+
+// Wakes up to count threads parked on seq; must be called with the lock held
+static void compact_wake(_Atomic uint32_t* seq, uint32_t waiting, int count)
+{
+    if (waiting > 0) {
+        atomic_fetch_add(seq, 1);
+        futex_wake(seq, count);
+    }
+}
+
+// Creates a new compact channel with the provided size and returns it to the caller
+compact_channel_t* compact_channel_create(size_t size)
+{
+    compact_channel_t* channel = malloc(sizeof(compact_channel_t));
+    if (!channel) {
+        return NULL;
+    }
+    atomic_init(&channel->lock, 0);
+    channel->closed = false;
+    channel->capacity = size;
+    channel->buffer = NULL;
+    channel->waiters = NULL;
+    return channel;
+}
+
+// Adds data to the channel; must be called with the lock held, on an open channel with room
+static enum channel_status compact_add(compact_channel_t* channel, void* data)
+{
+    if (!channel->buffer) {
+        channel->buffer = buffer_create(channel->capacity);
+        if (!channel->buffer) {
+            return GENERIC_ERROR;
+        }
+    }
+    if (buffer_add(channel->buffer, data) == BUFFER_ERROR) {
+        return GENERIC_ERROR;
+    }
+    if (channel->waiters) {
+        compact_wake(&channel->waiters->recv_seq, channel->waiters->recv_waiting, 1);
+    }
+    return SUCCESS;
+}
+
+// Removes data from the channel; must be called with the lock held, on an open channel holding data
+static enum channel_status compact_remove(compact_channel_t* channel, void** data)
+{
+    if (buffer_remove(channel->buffer, data) == BUFFER_ERROR) {
+        return GENERIC_ERROR;
+    }
+    if (channel->waiters) {
+        compact_wake(&channel->waiters->send_seq, channel->waiters->send_waiting, 1);
+    }
+    return SUCCESS;
+}
+
+static size_t compact_size(compact_channel_t* channel)
+{
+    return channel->buffer ? buffer_current_size(channel->buffer) : 0;
+}
+
+// Writes data to the given channel, waiting while the channel is full
+enum channel_status compact_channel_send(compact_channel_t* channel, void* data)
+{
+    compact_lock(channel);
+    while (!channel->closed && compact_size(channel) == channel->capacity) {
+        if (!compact_waiters(channel)) {
+            compact_unlock(channel);
+            return GENERIC_ERROR;
+        }
+        compact_wait(channel, &channel->waiters->send_seq, &channel->waiters->send_waiting);
+    }
+    enum channel_status status = channel->closed ? CLOSED_ERROR : compact_add(channel, data);
+    compact_unlock(channel);
+    return status;
+}
+
+// Reads data from the given channel into data, waiting while the channel is empty
+enum channel_status compact_channel_receive(compact_channel_t* channel, void** data)
+{
+    compact_lock(channel);
+    while (!channel->closed && compact_size(channel) == 0) {
+        if (!compact_waiters(channel)) {
+            compact_unlock(channel);
+            return GENERIC_ERROR;
+        }
+        compact_wait(channel, &channel->waiters->recv_seq, &channel->waiters->recv_waiting);
+    }
+    enum channel_status status = channel->closed ? CLOSED_ERROR : compact_remove(channel, data);
+    compact_unlock(channel);
+    return status;
+}
+
+// Writes data to the given channel without waiting
+enum channel_status compact_channel_non_blocking_send(compact_channel_t* channel, void* data)
+{
+    compact_lock(channel);
+    enum channel_status status;
+    if (channel->closed) {
+        status = CLOSED_ERROR;
+    } else if (compact_size(channel) == channel->capacity) {
+        status = CHANNEL_FULL;
+    } else {
+        status = compact_add(channel, data);
+    }
+    compact_unlock(channel);
+    return status;
+}
+
+// Reads data from the given channel into data without waiting
+enum channel_status compact_channel_non_blocking_receive(compact_channel_t* channel, void** data)
+{
+    compact_lock(channel);
+    enum channel_status status;
+    if (channel->closed) {
+        status = CLOSED_ERROR;
+    } else if (compact_size(channel) == 0) {
+        status = CHANNEL_EMPTY;
+    } else {
+        status = compact_remove(channel, data);
+    }
+    compact_unlock(channel);
+    return status;
+}
+
+// Closes the channel and wakes every blocked send/receive so they return CLOSED_ERROR
+enum channel_status compact_channel_close(compact_channel_t* channel)
+{
+    compact_lock(channel);
+    if (channel->closed) {
+        compact_unlock(channel);
+        return CLOSED_ERROR;
+    }
+    channel->closed = true;
+    if (channel->waiters) {
+        compact_wake(&channel->waiters->recv_seq, channel->waiters->recv_waiting, INT_MAX);
+        compact_wake(&channel->waiters->send_seq, channel->waiters->send_waiting, INT_MAX);
+    }
+    compact_unlock(channel);
+    return SUCCESS;
+}
+
+// Frees all the memory allocated to the channel
+enum channel_status compact_channel_destroy(compact_channel_t* channel)
+{
+    compact_lock(channel);
+    if (!channel->closed) {
+        compact_unlock(channel);
+        return DESTROY_ERROR;
+    }
+    compact_unlock(channel);
+    if (channel->buffer) {
+        buffer_free(channel->buffer);
+    }
+    free(channel->waiters);
+    free(channel);
+    return SUCCESS;
+}
@@ -0,0 +1,57 @@
+#ifndef COMPACT_CHANNEL_H
+#define COMPACT_CHANNEL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "buffer.h"
+#include "channel.h"
+
+// Futex words used by threads blocked on a compact channel
+// Only allocated once some thread actually has to wait
+typedef struct {
+    _Atomic uint32_t recv_seq; // bumped to wake receivers waiting for data
+    _Atomic uint32_t send_seq; // bumped to wake senders waiting for space
+    uint32_t recv_waiting;     // receivers currently parked on recv_seq
+    uint32_t send_waiting;     // senders currently parked on send_seq
+} compact_waiters_t;
+
+// Defines a compact channel object for programs that keep very many mostly idle channels
+// An idle compact channel costs sizeof(compact_channel_t) bytes: the lock is a single futex word,
+// and the ring buffer and waiter state are only allocated on first use
+// Compact channels have the same blocking, non-blocking and close semantics as channel_t,
+// but cannot be used in channel_select
+typedef struct {
+    // Lock word: 0 unlocked, 1 locked, 2 locked with threads waiting for it
+    _Atomic uint32_t lock;
+    // true once the channel has been closed
+    bool closed;
+    // Capacity of the ring buffer once it is materialized
+    size_t capacity;
+    // Message storage, created by the first send
+    buffer_t* buffer;
+    // Waiter state, created by the first thread that blocks
+    compact_waiters_t* waiters;
+} compact_channel_t;
+
+// Creates a new compact channel with the provided size and returns it to the caller
+// Returns NULL on allocation failure
+compact_channel_t* compact_channel_create(size_t size);
+// Writes data to the given channel, waiting while the channel is full
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR on any other error
+enum channel_status compact_channel_send(compact_channel_t* channel, void* data);
+// Reads data from the given channel into data, waiting while the channel is empty
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR on any other error
+enum channel_status compact_channel_receive(compact_channel_t* channel, void** data);
+// Writes data to the given channel without waiting
+// Returns SUCCESS, CHANNEL_FULL, CLOSED_ERROR, or GENERIC_ERROR
+enum channel_status compact_channel_non_blocking_send(compact_channel_t* channel, void* data);
+// Reads data from the given channel into data without waiting
+// Returns SUCCESS, CHANNEL_EMPTY, CLOSED_ERROR, or GENERIC_ERROR
+enum channel_status compact_channel_non_blocking_receive(compact_channel_t* channel, void** data);
+// Closes the channel and wakes every blocked send/receive so they return CLOSED_ERROR
+// Returns SUCCESS, or CLOSED_ERROR if the channel is already closed
+enum channel_status compact_channel_close(compact_channel_t* channel);
+// Frees all the memory allocated to the channel
+// Returns SUCCESS, or DESTROY_ERROR if the channel is still open
+enum channel_status compact_channel_destroy(compact_channel_t* channel);
+
+#endif // COMPACT_CHANNEL_H
@@ -0,0 +1,47 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "futex.h"
+
+// Kernel headers older than 5.16 lack futex_waitv; its number is the same on every architecture
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+#ifndef FUTEX_32
+#define FUTEX_32 2
+struct futex_waitv {
+    uint64_t val;
+    uint64_t uaddr;
+    uint32_t flags;
+    uint32_t __reserved;
+};
+#endif
+
+// Sleeps until one of the count words is woken by futex_wake_all, unless one of them no longer holds its
+// expected value
+int futex_wait_any(_Atomic uint32_t* const* words, const uint32_t* expected, size_t count)
+{
+    if (count == 0 || count > FUTEX_WAIT_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct futex_waitv waiters[FUTEX_WAIT_MAX];
+    for (size_t i = 0; i < count; i++) {
+        waiters[i].val = expected[i];
+        waiters[i].uaddr = (uint64_t)(uintptr_t)words[i];
+        waiters[i].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+        waiters[i].__reserved = 0;
+    }
+    // No timeout: the call only returns when woken, interrupted, or when a word already changed
+    long rc = syscall(SYS_futex_waitv, waiters, (unsigned int)count, 0, NULL, 0);
+    return rc < 0 ? -1 : 0;
+}
+
+// Wakes every thread sleeping on word
+void futex_wake_all(_Atomic uint32_t* word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
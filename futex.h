@@ -0,0 +1,23 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Thin helpers around the Linux futex syscalls, including futex_waitv (Linux 5.16), which sleeps on several
+// words at once. Words are process-private.
+
+// Most words futex_wait_any accepts (the kernel's FUTEX_WAITV_MAX)
+#define FUTEX_WAIT_MAX 128
+
+// Sleeps until one of the count words is woken by futex_wake_all, unless one of them no longer holds its
+// expected value
+// Returns 0 when woken (possibly spuriously), or -1 with errno set: EAGAIN if a word already changed, EINTR on a
+// signal, ENOSYS on kernels without futex_waitv, or EINVAL if count is 0 or above FUTEX_WAIT_MAX
+int futex_wait_any(_Atomic uint32_t* const* words, const uint32_t* expected, size_t count);
+
+// Wakes every thread sleeping on word
+void futex_wake_all(_Atomic uint32_t* word);
+
+#endif // FUTEX_H
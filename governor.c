@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "linked_list.h"
+#include "governor.h"
+
+typedef struct {
+    void (*wake)(void*);
+    void* arg;
+} governor_watcher_t;
+
+static _Atomic size_t budget;
+static _Atomic size_t used;
+static _Atomic size_t cost = 1;
+static _Atomic int policy;
+static _Atomic size_t waiters;
+static unsigned long generation;
+static list_t watchers; // statically allocated so the governor never owns heap memory while idle
+static pthread_mutex_t governor_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t governor_cond = PTHREAD_COND_INITIALIZER;
+
+// Sets the process-wide budget; a budget of 0 disables the governor
+void governor_set_budget(size_t new_budget, enum governor_unit unit, enum governor_policy new_policy)
+{
+    atomic_store(&cost, unit == GOVERNOR_BYTES ? sizeof(void*) : 1);
+    atomic_store(&policy, (int)new_policy);
+    atomic_store(&budget, new_budget);
+    // A larger budget (or none) may let waiting senders through
+    governor_notify();
+}
+
+// Returns the configured budget (0 when disabled)
+size_t governor_budget(void)
+{
+    return atomic_load(&budget);
+}
+
+// Returns the amount of the budget currently charged across all channels
+size_t governor_usage(void)
+{
+    return atomic_load(&used);
+}
+
+// Returns the current policy
+enum governor_policy governor_policy(void)
+{
+    return (enum governor_policy)atomic_load(&policy);
+}
+
+// Tries to charge one message against the budget without waiting
+bool governor_try_charge(size_t* charged)
+{
+    size_t limit = atomic_load(&budget);
+    if (limit == 0) {
+        *charged = 0;
+        return true;
+    }
+    size_t amount = atomic_load(&cost);
+    size_t current = atomic_load(&used);
+    do {
+        if (current + amount > limit) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&used, &current, current + amount));
+    *charged = amount;
+    return true;
+}
+
+// Bumps the generation and wakes blocked senders and select watchers
+void governor_notify(void)
+{
+    pthread_mutex_lock(&governor_lock);
+    generation++;
+    pthread_cond_broadcast(&governor_cond);
+    // Watchers are one-shot: select re-registers if it still has to wait
+    list_node_t* node = list_head(&watchers);
+    while (node != NULL) {
+        list_node_t* next = list_next(node);
+        governor_watcher_t* watcher = list_data(node);
+        watcher->wake(watcher->arg);
+        list_remove(&watchers, node);
+        node = next;
+    }
+    pthread_mutex_unlock(&governor_lock);
+}
+
+// Returns amount to the budget and wakes senders waiting for room
+void governor_release(size_t amount)
+{
+    if (amount == 0) {
+        return;
+    }
+    atomic_fetch_sub(&used, amount);
+    // Waiters announce themselves before checking the budget, so anyone who could have missed this release is
+    // visible here
+    if (atomic_load(&waiters) > 0) {
+        governor_notify();
+    }
+}
+
+// Returns a counter that changes every time waiting senders should re-check the budget
+unsigned long governor_generation(void)
+{
+    pthread_mutex_lock(&governor_lock);
+    unsigned long current = generation;
+    pthread_mutex_unlock(&governor_lock);
+    return current;
+}
+
+// Blocks until the generation differs from seen
+void governor_wait(unsigned long seen)
+{
+    pthread_mutex_lock(&governor_lock);
+    while (generation == seen) {
+        pthread_cond_wait(&governor_cond, &governor_lock);
+    }
+    pthread_mutex_unlock(&governor_lock);
+}
+
+// Announces that the caller is about to check the budget and possibly wait for it
+void governor_enter_wait(void)
+{
+    atomic_fetch_add(&waiters, 1);
+}
+
+// Announces that the caller no longer waits for the budget
+void governor_leave_wait(void)
+{
+    atomic_fetch_sub(&waiters, 1);
+}
+
+// Registers a one-shot callback invoked the next time budget is released
+void* governor_watch(void (*wake)(void*), void* arg)
+{
+    governor_watcher_t* watcher = malloc(sizeof(governor_watcher_t));
+    if (!watcher) {
+        return NULL;
+    }
+    watcher->wake = wake;
+    watcher->arg = arg;
+    governor_enter_wait();
+    pthread_mutex_lock(&governor_lock);
+    list_insert(&watchers, watcher);
+    pthread_mutex_unlock(&governor_lock);
+    return watcher;
+}
+
+// Removes a callback registered with governor_watch
+void governor_unwatch(void* handle)
+{
+    pthread_mutex_lock(&governor_lock);
+    list_node_t* node = list_find(&watchers, handle);
+    if (node != NULL) {
+        list_remove(&watchers, node);
+    }
+    pthread_mutex_unlock(&governor_lock);
+    governor_leave_wait();
+    free(handle);
+}
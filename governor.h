@@ -0,0 +1,71 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Process-wide memory governor shared by every channel
+// When a budget is set, each buffered message is charged against it on send and released on receive
+// Senders either block until other channels drain or fail fast, depending on the policy
+
+// Units the budget is expressed in
+// Channels only hold pointers to messages, whose memory belongs to the caller and is not counted: GOVERNOR_BYTES
+// charges each buffered message the sizeof(void*) bytes of the slot that holds its pointer, so a byte budget
+// is an entry budget of budget / sizeof(void*) messages
+enum governor_unit {
+    GOVERNOR_ENTRIES, // Number of buffered messages
+    GOVERNOR_BYTES    // Bytes of buffer slots used by buffered messages (sizeof(void*) each)
+};
+
+// What senders do when the budget is exhausted
+enum governor_policy {
+    GOVERNOR_BLOCK, // Wait until messages are received from any channel
+    GOVERNOR_FAIL   // Return CHANNEL_OVER_BUDGET immediately
+};
+
+// Sets the process-wide budget; a budget of 0 disables the governor
+// Messages buffered before the budget was set are not accounted for
+void governor_set_budget(size_t budget, enum governor_unit unit, enum governor_policy policy);
+
+// Returns the configured budget (0 when disabled)
+size_t governor_budget(void);
+
+// Returns the amount of the budget currently charged across all channels
+size_t governor_usage(void);
+
+// Returns the current policy
+enum governor_policy governor_policy(void);
+
+// Tries to charge one message against the budget without waiting
+// On success stores the amount charged (0 when the governor is disabled) and returns true
+bool governor_try_charge(size_t* charged);
+
+// Returns amount to the budget and wakes senders waiting for room
+void governor_release(size_t amount);
+
+// Returns a counter that changes every time waiting senders should re-check the budget
+unsigned long governor_generation(void);
+
+// Blocks until the generation differs from seen (i.e. budget was released or governor_notify was called)
+// Callers bracket the check-then-wait sequence with governor_enter_wait/governor_leave_wait
+void governor_wait(unsigned long seen);
+
+// Announces that the caller is about to check the budget and possibly wait for it
+void governor_enter_wait(void);
+
+// Announces that the caller no longer waits for the budget
+void governor_leave_wait(void);
+
+// Wakes every sender waiting for the budget so it can re-check its channel (e.g. after a close)
+void governor_notify(void);
+
+// Registers a callback invoked (from the releasing thread) the next time budget is released
+// Used by channel_select to wait for the budget together with its channels
+// Returns a handle for governor_unwatch, or NULL on allocation failure, in which case channel_select polls for
+// budget instead of sleeping
+void* governor_watch(void (*wake)(void*), void* arg);
+
+// Removes a callback registered with governor_watch
+void governor_unwatch(void* handle);
+
+#endif // GOVERNOR_H
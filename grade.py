@@ -80,6 +80,31 @@ add_test_cases("test_select_response_time", iters_one, timeout_response_time)
 add_test_cases("test_cpu_utilization_select", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_one, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
+add_test_cases("test_unbounded_channel", iters_slow)
+add_test_cases("test_mapped_channel", iters_slow)
+add_test_cases("test_numa_channel", iters_one)
+add_test_cases("test_compact_channel", iters_slow)
+add_test_cases("test_memory_governor", iters_slow)
+add_test_cases("test_shared_channel", iters_slow)
+add_test_cases("test_channel_readiness_fds", iters_slow)
+add_test_cases("test_select_fd_cases", iters_slow)
+add_test_cases("test_uring_stage", iters_slow)
+add_test_cases("test_mmap_source", iters_slow)
+add_test_cases("test_spill_channel", iters_slow)
+add_test_cases("test_shared_channel_snapshot", iters_slow)
+add_test_cases("test_trace_replay", iters_slow)
+add_test_cases("test_broadcast_channel", iters_slow)
+add_test_cases("test_conflating_channel", iters_slow)
+add_test_cases("test_overflow_policies", iters_slow)
+add_test_cases("test_codel_channel", iters_slow)
+add_test_cases("test_priority_channel", iters_slow)
+add_test_cases("test_keyed_channel", iters_slow)
+add_test_cases("test_sharded_channel", iters_slow)
+add_test_cases("test_mailbox_channel", iters_slow)
+add_test_cases("test_spsc_detection", iters_slow)
+add_test_cases("test_channel_attr", iters_slow)
+add_test_cases("test_channel_state", iters_slow)
+add_test_cases("test_select_futex", iters_slow)
 
 # Score distribution
 point_breakdown = [
@@ -0,0 +1,49 @@
+#include "mailbox.h"
+
+// Initializes an empty mailbox
+void mailbox_init(mailbox_t* mailbox)
+{
+    atomic_init(&mailbox->stub.next, NULL);
+    atomic_init(&mailbox->tail, &mailbox->stub);
+    mailbox->head = &mailbox->stub;
+}
+
+// Appends node; safe to call from any number of threads at once
+void mailbox_push(mailbox_t* mailbox, mailbox_node_t* node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    mailbox_node_t* prev = atomic_exchange_explicit(&mailbox->tail, node, memory_order_acq_rel);
+    // Until this store the consumer sees the list end at prev
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+// Removes the oldest node, or returns NULL if the mailbox is (or looks) empty
+mailbox_node_t* mailbox_pop(mailbox_t* mailbox)
+{
+    mailbox_node_t* head = mailbox->head;
+    mailbox_node_t* next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (head == &mailbox->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        mailbox->head = next;
+        head = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        mailbox->head = next;
+        return head;
+    }
+    // head is the last linked node: unless a producer is halfway through a push, it is also the tail
+    if (head != atomic_load_explicit(&mailbox->tail, memory_order_acquire)) {
+        return NULL;
+    }
+    // Put the stub back behind it, so head can be handed out while the list stays non-empty
+    mailbox_push(mailbox, &mailbox->stub);
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next != NULL) {
+        mailbox->head = next;
+        return head;
+    }
+    return NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Intrusive multi-producer single-consumer queue (Dmitry Vyukov's non-blocking MPSC queue)
+// Messages embed a mailbox_node_t, so enqueueing never allocates. A push is a single atomic exchange on the
+// tail followed by a store that links the previous node, so producers are wait-free; only the consumer walks
+// the list. A producer preempted between those two steps briefly hides the messages pushed after it: pops
+// report the queue empty until it links its node, so emptiness is only a hint (see channel_create_mailbox)
+
+// Link field to embed in every message sent through a mailbox
+typedef struct mailbox_node {
+    _Atomic(struct mailbox_node*) next;
+} mailbox_node_t;
+
+typedef struct mailbox {
+    _Atomic(mailbox_node_t*) tail; // last pushed node, exchanged by producers
+    mailbox_node_t* head;          // next node to pop, owned by the consumer
+    mailbox_node_t stub;           // keeps the list non-empty, so producers never touch head
+} mailbox_t;
+
+// Initializes an empty mailbox
+void mailbox_init(mailbox_t* mailbox);
+// Appends node; safe to call from any number of threads at once
+// The link is published with a release store only: a caller that then checks whether the consumer is asleep needs a
+// full fence in between, or the consumer may register and look at the list before seeing node (a lost wakeup)
+void mailbox_push(mailbox_t* mailbox, mailbox_node_t* node);
+// Removes the oldest node, or returns NULL if the mailbox is (or looks) empty
+// Must only be called by one thread at a time
+mailbox_node_t* mailbox_pop(mailbox_t* mailbox);
+#endif // MAILBOX_H
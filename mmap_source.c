@@ -0,0 +1,170 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mmap_source.h"
+
+// Number of chunks ahead of the one being sent for which readahead is requested
+#define MMAP_SOURCE_READAHEAD_CHUNKS 4
+
+struct mmap_source {
+    char* data;               // start of the mapping, NULL for an empty file
+    size_t size;              // file size in bytes
+    size_t chunk_size;
+    int delimiter;            // record delimiter, or -1 for fixed-size chunks
+    _Atomic size_t refs;      // outstanding chunks plus one for the source itself
+    file_chunk_t* chunks;     // MMAP_SOURCE_CHUNKS descriptors
+    channel_t* free_chunks;   // descriptors not handed out, like the free channel of a uring source
+};
+
+// Frees the descriptor pool and the source itself
+static void mmap_source_free(mmap_source_t* source)
+{
+    if (source->free_chunks) {
+        channel_close(source->free_chunks);
+        channel_destroy(source->free_chunks);
+    }
+    free(source->chunks);
+    free(source);
+}
+
+mmap_source_t* mmap_source_open(const char* path, size_t chunk_size, int delimiter)
+{
+    if (chunk_size == 0 || delimiter > 255) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    mmap_source_t* source = calloc(1, sizeof(mmap_source_t));
+    if (source) {
+        source->chunks = calloc(MMAP_SOURCE_CHUNKS, sizeof(file_chunk_t));
+        source->free_chunks = channel_create(MMAP_SOURCE_CHUNKS);
+    }
+    if (!source || !source->chunks || !source->free_chunks) {
+        if (source) {
+            mmap_source_free(source);
+        }
+        close(fd);
+        return NULL;
+    }
+    for (size_t i = 0; i < MMAP_SOURCE_CHUNKS; i++) {
+        source->chunks[i].source = source;
+        channel_send(source->free_chunks, &source->chunks[i]);
+    }
+    source->size = (size_t)st.st_size;
+    source->chunk_size = chunk_size;
+    source->delimiter = delimiter;
+    atomic_init(&source->refs, 1);
+    source->data = NULL;
+    // mmap rejects zero-length mappings; an empty file only produces the end-of-file chunk
+    if (source->size > 0) {
+        void* map = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            mmap_source_free(source);
+            return NULL;
+        }
+        source->data = map;
+        // The file is consumed front to back: let the kernel read ahead aggressively and drop pages behind us
+        madvise(source->data, source->size, MADV_SEQUENTIAL);
+    }
+    // The mapping keeps the file alive
+    close(fd);
+    return source;
+}
+
+size_t mmap_source_size(mmap_source_t* source)
+{
+    return source->size;
+}
+
+// Drops one reference; the last one unmaps the file and frees the source
+static void mmap_source_unref(mmap_source_t* source)
+{
+    if (atomic_fetch_sub(&source->refs, 1) != 1) {
+        return;
+    }
+    if (source->data) {
+        munmap(source->data, source->size);
+    }
+    mmap_source_free(source);
+}
+
+// Returns the end offset of the chunk starting at offset
+static size_t mmap_source_chunk_end(mmap_source_t* source, size_t offset)
+{
+    size_t end = source->size - offset > source->chunk_size ? offset + source->chunk_size : source->size;
+    if (source->delimiter >= 0 && end < source->size) {
+        const char* found = memchr(source->data + end, source->delimiter, source->size - end);
+        end = found ? (size_t)(found - source->data) + 1 : source->size;
+    }
+    return end;
+}
+
+enum channel_status mmap_source_run(mmap_source_t* source, channel_t* out)
+{
+    enum channel_status status = SUCCESS;
+    size_t advised = 0; // readahead has been requested for [0, advised)
+    size_t offset = 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    while (status == SUCCESS) {
+        // Waits while consumers hold every descriptor, which also bounds how far the source runs ahead
+        void* data = NULL;
+        if (channel_receive(source->free_chunks, &data) != SUCCESS) {
+            status = GENERIC_ERROR;
+            break;
+        }
+        file_chunk_t* chunk = data;
+        size_t end = offset < source->size ? mmap_source_chunk_end(source, offset) : offset;
+        chunk->data = source->data ? source->data + offset : NULL;
+        chunk->length = end - offset;
+        chunk->offset = offset;
+
+        // Keep a window of MMAP_SOURCE_READAHEAD_CHUNKS chunks in flight ahead of the consumers
+        size_t window = offset + MMAP_SOURCE_READAHEAD_CHUNKS * source->chunk_size;
+        if (window > source->size) {
+            window = source->size;
+        }
+        if (window > advised) {
+            size_t start = advised & ~(page - 1); // madvise needs a page-aligned start
+            madvise(source->data + start, window - start, MADV_WILLNEED);
+            advised = window;
+        }
+
+        atomic_fetch_add(&source->refs, 1);
+        status = channel_send(out, chunk);
+        if (status != SUCCESS) {
+            mmap_source_release(chunk);
+            break;
+        }
+        if (end == offset) {
+            break; // the end-of-file chunk has been sent
+        }
+        offset = end;
+    }
+    mmap_source_unref(source);
+    return status;
+}
+
+void mmap_source_release(file_chunk_t* chunk)
+{
+    mmap_source_t* source = chunk->source;
+    // The free channel holds every descriptor, so this never waits
+    channel_send(source->free_chunks, chunk);
+    mmap_source_unref(source);
+}
+
+void mmap_source_close(mmap_source_t* source)
+{
+    mmap_source_unref(source);
+}
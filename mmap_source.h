@@ -0,0 +1,44 @@
+#ifndef MMAP_SOURCE_H
+#define MMAP_SOURCE_H
+#include <stddef.h>
+#include "channel.h"
+
+// Reads a file through a private read-only mapping and sends chunk descriptors instead of copies
+typedef struct mmap_source mmap_source_t;
+
+// Chunk descriptors per source; they are recycled through an internal free channel, so at most this many
+// chunks are out at once and mmap_source_run waits for a release when consumers hold all of them
+#define MMAP_SOURCE_CHUNKS 64
+
+// Describes a read-only slice of the mapped file
+// Consumers must hand every chunk they receive back with mmap_source_release
+typedef struct {
+    // Start of the slice inside the mapping
+    const char* data;
+    // Number of bytes in the slice; a chunk with length 0 marks the end of the file
+    size_t length;
+    // Offset of the slice in the file
+    size_t offset;
+    // Source the chunk belongs to
+    mmap_source_t* source;
+} file_chunk_t;
+
+// Maps the file at path for reading in chunks of chunk_size bytes
+// If delimiter is a byte value (0-255), each chunk is extended up to and including the next delimiter
+// so records (for example lines with '\n') never straddle two chunks; pass -1 for fixed-size chunks
+// Returns NULL if the file cannot be opened or mapped, if chunk_size is 0, or on allocation failure
+mmap_source_t* mmap_source_open(const char* path, size_t chunk_size, int delimiter);
+// Returns the size of the mapped file in bytes
+size_t mmap_source_size(mmap_source_t* source);
+// Sends every chunk of the file to out in file order, followed by a zero-length chunk
+// Readahead is requested a few chunks ahead of the chunk being sent
+// The source is released by this call: the mapping is unmapped once consumers have released every chunk,
+// and the source must not be used afterwards (chunks keep it alive until then)
+// Returns SUCCESS, or the channel error if out was closed (unsent chunks are released)
+enum channel_status mmap_source_run(mmap_source_t* source, channel_t* out);
+// Releases a chunk received from an mmap source, handing its descriptor back to the source; the last release
+// unmaps the file
+void mmap_source_release(file_chunk_t* chunk);
+// Drops a source without running it; the file is unmapped right away
+void mmap_source_close(mmap_source_t* source);
+#endif // MMAP_SOURCE_H
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "mpmc.h"
+
+// Creates a queue of capacity slots
+mpmc_t* mpmc_create(size_t capacity)
+{
+    if (capacity == 0 || capacity > SIZE_MAX / sizeof(mpmc_slot_t)) {
+        return NULL;
+    }
+    mpmc_t* mpmc = malloc(sizeof(mpmc_t));
+    mpmc_slot_t* slots = malloc(capacity * sizeof(mpmc_slot_t));
+    if (!mpmc || !slots) {
+        free(mpmc);
+        free(slots);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&slots[i].sequence, 2 * i);
+        slots[i].data = NULL;
+    }
+    atomic_init(&mpmc->tail, 0);
+    atomic_init(&mpmc->head, 0);
+    mpmc->capacity = capacity;
+    mpmc->slots = slots;
+    return mpmc;
+}
+
+// Frees a queue
+void mpmc_free(mpmc_t* mpmc)
+{
+    free(mpmc->slots);
+    free(mpmc);
+}
+
+// Appends data; returns false if the queue is full
+bool mpmc_push(mpmc_t* mpmc, void* data)
+{
+    size_t pos = atomic_load_explicit(&mpmc->tail, memory_order_relaxed);
+    while (true) {
+        mpmc_slot_t* slot = &mpmc->slots[pos % mpmc->capacity];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == 2 * pos) {
+            // The slot is free for this position: claim the position, then publish the value
+            if (atomic_compare_exchange_weak_explicit(&mpmc->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                slot->data = data;
+                atomic_store_explicit(&slot->sequence, 2 * pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (sequence < 2 * pos) {
+            // The slot still holds the value from one lap ago: the queue is full
+            return false;
+        } else {
+            pos = atomic_load_explicit(&mpmc->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// Removes the oldest value into data; returns false if the queue is empty
+bool mpmc_pop(mpmc_t* mpmc, void** data)
+{
+    size_t pos = atomic_load_explicit(&mpmc->head, memory_order_relaxed);
+    while (true) {
+        mpmc_slot_t* slot = &mpmc->slots[pos % mpmc->capacity];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == 2 * pos + 1) {
+            if (atomic_compare_exchange_weak_explicit(&mpmc->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *data = slot->data;
+                // Free the slot for the producer one lap ahead
+                atomic_store_explicit(&slot->sequence, 2 * (pos + mpmc->capacity), memory_order_release);
+                return true;
+            }
+        } else if (sequence < 2 * pos + 1) {
+            // Nothing written at this position yet: the queue is empty
+            return false;
+        } else {
+            pos = atomic_load_explicit(&mpmc->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Returns the number of queued values
+size_t mpmc_size(mpmc_t* mpmc)
+{
+    size_t head = atomic_load(&mpmc->head);
+    size_t tail = atomic_load(&mpmc->tail);
+    return tail > head ? tail - head : 0;
+}
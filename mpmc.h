@@ -0,0 +1,36 @@
+#ifndef MPMC_H
+#define MPMC_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's bounded MPMC queue)
+// Every slot carries a sequence number telling whether it is ready for the producer or the consumer of a given
+// position, so producers and consumers only contend on their own position counter (one compare-and-swap each)
+// and never on each other. Pushes and pops are lock-free; neither blocks (see channel_create_ex for the parking)
+
+typedef struct {
+    // 2 * pos while the slot is free for the producer of position pos, 2 * pos + 1 once that producer wrote it
+    // (doubling keeps the two states apart even when a single slot is reused for every position)
+    _Atomic size_t sequence;
+    void* data;
+} mpmc_slot_t;
+
+typedef struct mpmc {
+    _Atomic size_t tail;  // next position to write, advanced by producers
+    _Atomic size_t head;  // next position to read, advanced by consumers
+    size_t capacity;
+    mpmc_slot_t* slots;
+} mpmc_t;
+
+// Creates a queue of capacity slots; returns NULL if capacity is 0 or on allocation failure
+mpmc_t* mpmc_create(size_t capacity);
+// Frees a queue; values still queued are dropped
+void mpmc_free(mpmc_t* mpmc);
+// Appends data; returns false if the queue is full
+bool mpmc_push(mpmc_t* mpmc, void* data);
+// Removes the oldest value into data; returns false if the queue is empty
+bool mpmc_pop(mpmc_t* mpmc, void** data);
+// Returns the number of queued values (a snapshot that may be stale by the time it is used)
+size_t mpmc_size(mpmc_t* mpmc);
+#endif // MPMC_H
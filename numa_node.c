@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "numa_node.h"
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+
+// Returns the number of NUMA nodes with memory, or 1 if the topology is unknown
+int numa_node_count(void)
+{
+    DIR* dir = opendir(NUMA_SYSFS);
+    if (!dir) {
+        return 1;
+    }
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned node;
+        char tail;
+        if (sscanf(entry->d_name, "node%u%c", &node, &tail) == 1) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count > 0 ? count : 1;
+}
+
+// Returns the node of the CPU the calling thread is running on, or 0 if unknown
+int numa_current_node(void)
+{
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return 0;
+    }
+    return (int)node;
+}
+
+// Binds the page-aligned range [addr, addr + len) to the given node and migrates pages already placed elsewhere
+// Returns 0 on success and -1 on failure
+int numa_bind_range(void* addr, size_t len, int node)
+{
+    if (node < 0) {
+        return -1;
+    }
+    if (numa_node_count() <= 1) {
+        return 0;
+    }
+    unsigned long mask[4] = {0};
+    size_t bits = sizeof(mask) * 8;
+    if ((size_t)node >= bits) {
+        return -1;
+    }
+    mask[(size_t)node / (sizeof(unsigned long) * 8)] = 1UL << ((size_t)node % (sizeof(unsigned long) * 8));
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    len = (len + page - 1) & ~(page - 1);
+    if (syscall(SYS_mbind, addr, len, MPOL_BIND, mask, bits + 1, MPOL_MF_MOVE) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Allocates zeroed, page-aligned memory bound to the given node
+// Returns NULL on failure
+void* numa_alloc_node_memory(size_t size, int node)
+{
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    // Bind before the first touch so the pages are faulted in on the right node
+    if (node >= 0 && numa_bind_range(addr, size, node) != 0) {
+        munmap(addr, size);
+        return NULL;
+    }
+    return addr;
+}
+
+// Frees memory allocated by numa_alloc_node_memory
+void numa_free_node_memory(void* addr, size_t size)
+{
+    munmap(addr, size);
+}
+
+// Restricts the calling thread to the CPUs of the given node
+// Returns 0 on success and -1 on failure
+int numa_pin_thread(int node)
+{
+    if (node < 0) {
+        return -1;
+    }
+    if (numa_node_count() <= 1) {
+        return 0;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    // cpulist looks like "0-7,16-23"
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    unsigned first, last;
+    int scanned;
+    while ((scanned = fscanf(file, "%u", &first)) == 1) {
+        last = first;
+        int sep = fgetc(file);
+        if (sep == '-') {
+            if (fscanf(file, "%u", &last) != 1) {
+                break;
+            }
+            sep = fgetc(file);
+        }
+        for (unsigned cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+        if (sep != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    if (CPU_COUNT(&set) == 0) {
+        return -1;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
@@ -0,0 +1,32 @@
+#ifndef NUMA_NODE_H
+#define NUMA_NODE_H
+
+#include <stddef.h>
+
+// Thin helpers around the Linux NUMA syscalls (no libnuma dependency)
+// Every helper degrades to a successful no-op on machines with a single node
+
+// Returns the number of NUMA nodes with memory, or 1 if the topology is unknown
+int numa_node_count(void);
+
+// Returns the node of the CPU the calling thread is running on, or 0 if unknown
+int numa_current_node(void);
+
+// Binds the page-aligned range [addr, addr + len) to the given node and migrates pages already placed elsewhere
+// Returns 0 on success and -1 on failure
+int numa_bind_range(void* addr, size_t len, int node);
+
+// Allocates zeroed, page-aligned memory bound to the given node
+// A negative node leaves placement to the kernel's default policy
+// Must be released with numa_free_node_memory using the same size
+// Returns NULL on failure
+void* numa_alloc_node_memory(size_t size, int node);
+
+// Frees memory allocated by numa_alloc_node_memory
+void numa_free_node_memory(void* addr, size_t size);
+
+// Restricts the calling thread to the CPUs of the given node
+// Returns 0 on success and -1 on failure
+int numa_pin_thread(int node);
+
+#endif // NUMA_NODE_H
@@ -0,0 +1,511 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shared_channel.h"
+
+#define SHARED_CHANNEL_MAGIC 0x4348414e // "CHAN"
+#define SHARED_CHANNEL_VERSION 1
+#define SHARED_SNAPSHOT_MAGIC 0x50414e53 // "SNAP"
+#define SHARED_SNAPSHOT_VERSION 1
+
+// Snapshot file layout: the file header, one entry per channel, then the messages of every channel back to back
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t channels;
+} shared_snapshot_header_t;
+
+typedef struct {
+    uint64_t elem_size;
+    uint64_t messages;
+} shared_snapshot_entry_t;
+
+// Maps a shared memory object and wraps it into a handle
+static shared_channel_t* shared_map(int fd, size_t map_size, const char* name)
+{
+    void* addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    shared_channel_t* channel = malloc(sizeof(shared_channel_t));
+    if (!channel) {
+        munmap(addr, map_size);
+        return NULL;
+    }
+    channel->header = addr;
+    channel->map_size = map_size;
+    channel->name = name ? strdup(name) : NULL;
+    return channel;
+}
+
+// Creates a channel in shared memory that other processes can open by name
+shared_channel_t* channel_create_shared(const char* name, size_t capacity, size_t elem_size)
+{
+    if (capacity == 0 || elem_size == 0 || capacity > (SIZE_MAX - sizeof(shared_channel_header_t)) / elem_size) {
+        return NULL;
+    }
+    size_t map_size = sizeof(shared_channel_header_t) + capacity * elem_size;
+    int fd = name ? shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600) : memfd_create("shared_channel", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)map_size) != 0) {
+        close(fd);
+        if (name) {
+            shm_unlink(name);
+        }
+        return NULL;
+    }
+    shared_channel_t* channel = shared_map(fd, map_size, name);
+    close(fd);
+    if (!channel) {
+        if (name) {
+            shm_unlink(name);
+        }
+        return NULL;
+    }
+
+    shared_channel_header_t* header = channel->header;
+    header->capacity = capacity;
+    header->elem_size = elem_size;
+    header->size = 0;
+    header->next = 0;
+    header->closed = false;
+
+    // The lock is robust so a process dying inside a critical section does not wedge the others
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->lock, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&header->not_empty, &cond_attr);
+    pthread_cond_init(&header->not_full, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    // Publish the channel last: openers check the magic before touching anything else
+    __atomic_store_n(&header->version, SHARED_CHANNEL_VERSION, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->magic, SHARED_CHANNEL_MAGIC, __ATOMIC_RELEASE);
+    return channel;
+}
+
+// Opens a shared channel created by another process with channel_create_shared
+shared_channel_t* channel_open_shared(const char* name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shared_channel_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    shared_channel_t* channel = shared_map(fd, (size_t)st.st_size, name);
+    close(fd);
+    if (!channel) {
+        return NULL;
+    }
+    shared_channel_header_t* header = channel->header;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_CHANNEL_MAGIC ||
+        header->version != SHARED_CHANNEL_VERSION ||
+        sizeof(shared_channel_header_t) + header->capacity * header->elem_size > channel->map_size) {
+        shared_channel_detach(channel);
+        return NULL;
+    }
+    return channel;
+}
+
+// Takes the channel lock, recovering it if its previous owner died while holding it
+static int shared_lock(shared_channel_header_t* header)
+{
+    int rc = pthread_mutex_lock(&header->lock);
+    if (rc == EOWNERDEAD) {
+        // Ring updates are a single memcpy followed by index updates, so the state is usable as is
+        pthread_mutex_consistent(&header->lock);
+        rc = 0;
+    }
+    return rc;
+}
+
+// Waits on a shared condition variable, recovering the lock like shared_lock
+static int shared_wait(shared_channel_header_t* header, pthread_cond_t* cond)
+{
+    int rc = pthread_cond_wait(cond, &header->lock);
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(&header->lock);
+        rc = 0;
+    }
+    return rc;
+}
+
+// Copies a message into the ring; must be called with the lock held and room available
+static void shared_add(shared_channel_header_t* header, const void* data)
+{
+    size_t pos = header->next + header->size;
+    if (pos >= header->capacity) {
+        pos -= header->capacity;
+    }
+    memcpy(header->data + pos * header->elem_size, data, header->elem_size);
+    header->size++;
+    pthread_cond_signal(&header->not_empty);
+}
+
+// Copies the oldest message out of the ring; must be called with the lock held and a message available
+static void shared_remove(shared_channel_header_t* header, void* data)
+{
+    memcpy(data, header->data + header->next * header->elem_size, header->elem_size);
+    header->size--;
+    header->next++;
+    if (header->next >= header->capacity) {
+        header->next = 0;
+    }
+    pthread_cond_signal(&header->not_full);
+}
+
+// Copies elem_size bytes from data into the channel, waiting while the channel is full
+enum channel_status shared_channel_send(shared_channel_t* channel, const void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    while (!header->closed && header->size == header->capacity) {
+        if (shared_wait(header, &header->not_full) != 0) {
+            pthread_mutex_unlock(&header->lock);
+            return GENERIC_ERROR;
+        }
+    }
+    if (header->closed) {
+        pthread_mutex_unlock(&header->lock);
+        return CLOSED_ERROR;
+    }
+    shared_add(header, data);
+    pthread_mutex_unlock(&header->lock);
+    return SUCCESS;
+}
+
+// Copies the oldest message into data (elem_size bytes), waiting while the channel is empty
+enum channel_status shared_channel_receive(shared_channel_t* channel, void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    while (!header->closed && header->size == 0) {
+        if (shared_wait(header, &header->not_empty) != 0) {
+            pthread_mutex_unlock(&header->lock);
+            return GENERIC_ERROR;
+        }
+    }
+    if (header->closed) {
+        pthread_mutex_unlock(&header->lock);
+        return CLOSED_ERROR;
+    }
+    shared_remove(header, data);
+    pthread_mutex_unlock(&header->lock);
+    return SUCCESS;
+}
+
+// Copies elem_size bytes from data into the channel without waiting
+enum channel_status shared_channel_non_blocking_send(shared_channel_t* channel, const void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    enum channel_status status = SUCCESS;
+    if (header->closed) {
+        status = CLOSED_ERROR;
+    } else if (header->size == header->capacity) {
+        status = CHANNEL_FULL;
+    } else {
+        shared_add(header, data);
+    }
+    pthread_mutex_unlock(&header->lock);
+    return status;
+}
+
+// Copies the oldest message into data without waiting
+enum channel_status shared_channel_non_blocking_receive(shared_channel_t* channel, void* data)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    enum channel_status status = SUCCESS;
+    if (header->closed) {
+        status = CLOSED_ERROR;
+    } else if (header->size == 0) {
+        status = CHANNEL_EMPTY;
+    } else {
+        shared_remove(header, data);
+    }
+    pthread_mutex_unlock(&header->lock);
+    return status;
+}
+
+// Closes the channel for every process and wakes all blocked senders and receivers
+enum channel_status shared_channel_close(shared_channel_t* channel)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    if (header->closed) {
+        pthread_mutex_unlock(&header->lock);
+        return CLOSED_ERROR;
+    }
+    header->closed = true;
+    pthread_cond_broadcast(&header->not_empty);
+    pthread_cond_broadcast(&header->not_full);
+    pthread_mutex_unlock(&header->lock);
+    return SUCCESS;
+}
+
+// Unmaps the channel from this process and frees the handle
+void shared_channel_detach(shared_channel_t* channel)
+{
+    munmap(channel->header, channel->map_size);
+    free(channel->name);
+    free(channel);
+}
+
+// Removes the channel name so no new process can open it, then detaches
+enum channel_status shared_channel_destroy(shared_channel_t* channel)
+{
+    shared_channel_header_t* header = channel->header;
+    if (shared_lock(header) != 0) {
+        return GENERIC_ERROR;
+    }
+    bool closed = header->closed;
+    pthread_mutex_unlock(&header->lock);
+    if (!closed) {
+        return DESTROY_ERROR;
+    }
+    if (channel->name) {
+        shm_unlink(channel->name);
+    }
+    shared_channel_detach(channel);
+    return SUCCESS;
+}
+
+static double shared_elapsed(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int shared_compare_headers(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t)(*(shared_channel_t* const*)a)->header;
+    uintptr_t y = (uintptr_t)(*(shared_channel_t* const*)b)->header;
+    return x < y ? -1 : x > y;
+}
+
+// Locks every channel in address order, so concurrent snapshots and restores of overlapping sets cannot deadlock
+// Returns the sorted handles to pass to shared_unlock_all, or NULL if a channel is listed twice or cannot be locked
+static shared_channel_t** shared_lock_all(shared_channel_t** channels, size_t count)
+{
+    shared_channel_t** sorted = malloc((count > 0 ? count : 1) * sizeof(shared_channel_t*));
+    if (!sorted) {
+        return NULL;
+    }
+    memcpy(sorted, channels, count * sizeof(shared_channel_t*));
+    qsort(sorted, count, sizeof(shared_channel_t*), shared_compare_headers);
+    for (size_t i = 0; i < count; i++) {
+        if ((i > 0 && sorted[i]->header == sorted[i - 1]->header) || shared_lock(sorted[i]->header) != 0) {
+            while (i-- > 0) {
+                pthread_mutex_unlock(&sorted[i]->header->lock);
+            }
+            free(sorted);
+            return NULL;
+        }
+    }
+    return sorted;
+}
+
+static void shared_unlock_all(shared_channel_t** sorted, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_unlock(&sorted[i]->header->lock);
+    }
+    free(sorted);
+}
+
+// Copies the buffered messages of a locked channel to out in FIFO order
+static void shared_copy_out(shared_channel_header_t* header, unsigned char* out)
+{
+    size_t first = header->capacity - header->next < header->size ? header->capacity - header->next : header->size;
+    memcpy(out, header->data + header->next * header->elem_size, first * header->elem_size);
+    memcpy(out + first * header->elem_size, header->data, (header->size - first) * header->elem_size);
+}
+
+// Quiesces the channels and writes the messages buffered in them to a compact snapshot file at path
+enum channel_status shared_channel_snapshot(shared_channel_t** channels, size_t count, const char* path,
+                                            shared_snapshot_stats_t* stats)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    char* tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+    if (!tmp_path) {
+        return GENERIC_ERROR;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+    shared_channel_t** locked = shared_lock_all(channels, count);
+    if (!locked) {
+        free(tmp_path);
+        return GENERIC_ERROR;
+    }
+
+    size_t messages = 0;
+    size_t file_size = sizeof(shared_snapshot_header_t) + count * sizeof(shared_snapshot_entry_t);
+    for (size_t i = 0; i < count; i++) {
+        messages += channels[i]->header->size;
+        file_size += channels[i]->header->size * channels[i]->header->elem_size;
+    }
+
+    // The whole file is laid out in one mapping and filled with one or two memcpy calls per channel
+    enum channel_status status = GENERIC_ERROR;
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    unsigned char* map = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, (off_t)file_size) == 0) {
+        map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map != MAP_FAILED) {
+        shared_snapshot_header_t* file_header = (shared_snapshot_header_t*)map;
+        shared_snapshot_entry_t* entries = (shared_snapshot_entry_t*)(file_header + 1);
+        unsigned char* out = (unsigned char*)(entries + count);
+        file_header->magic = SHARED_SNAPSHOT_MAGIC;
+        file_header->version = SHARED_SNAPSHOT_VERSION;
+        file_header->channels = count;
+        for (size_t i = 0; i < count; i++) {
+            shared_channel_header_t* header = channels[i]->header;
+            entries[i].elem_size = header->elem_size;
+            entries[i].messages = header->size;
+            shared_copy_out(header, out);
+            out += header->size * header->elem_size;
+        }
+        status = SUCCESS;
+    }
+    // The channels only need to stay quiet while their contents are copied
+    shared_unlock_all(locked, count);
+
+    if (map != MAP_FAILED && msync(map, file_size, MS_SYNC) != 0) {
+        status = GENERIC_ERROR;
+    }
+    if (map != MAP_FAILED) {
+        munmap(map, file_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    // Only a complete snapshot replaces the previous one
+    if (status == SUCCESS && rename(tmp_path, path) != 0) {
+        status = GENERIC_ERROR;
+    }
+    if (status != SUCCESS) {
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    if (status == SUCCESS && stats) {
+        stats->channels = count;
+        stats->messages = messages;
+        stats->bytes = file_size;
+        stats->seconds = shared_elapsed(&start);
+    }
+    return status;
+}
+
+// Loads a snapshot written by shared_channel_snapshot into channels, given in the same order as when it was taken
+enum channel_status shared_channel_restore(shared_channel_t** channels, size_t count, const char* path,
+                                           shared_snapshot_stats_t* stats)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return GENERIC_ERROR;
+    }
+    struct stat st;
+    size_t file_size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    unsigned char* map = MAP_FAILED;
+    if (file_size >= sizeof(shared_snapshot_header_t)) {
+        map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return GENERIC_ERROR;
+    }
+
+    // Validate the file against itself before touching any channel
+    shared_snapshot_header_t* file_header = (shared_snapshot_header_t*)map;
+    shared_snapshot_entry_t* entries = (shared_snapshot_entry_t*)(file_header + 1);
+    bool valid = file_header->magic == SHARED_SNAPSHOT_MAGIC && file_header->version == SHARED_SNAPSHOT_VERSION &&
+                 file_header->channels == count &&
+                 count <= (file_size - sizeof(shared_snapshot_header_t)) / sizeof(shared_snapshot_entry_t);
+    size_t expected = sizeof(shared_snapshot_header_t) + count * sizeof(shared_snapshot_entry_t);
+    size_t messages = 0;
+    for (size_t i = 0; valid && i < count; i++) {
+        uint64_t elem_size = entries[i].elem_size;
+        valid = elem_size > 0 && entries[i].messages <= (file_size - expected) / elem_size;
+        if (valid) {
+            expected += entries[i].messages * elem_size;
+            messages += entries[i].messages;
+        }
+    }
+    if (!valid || expected != file_size) {
+        munmap(map, file_size);
+        return GENERIC_ERROR;
+    }
+
+    shared_channel_t** locked = shared_lock_all(channels, count);
+    if (!locked) {
+        munmap(map, file_size);
+        return GENERIC_ERROR;
+    }
+    enum channel_status status = SUCCESS;
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        shared_channel_header_t* header = channels[i]->header;
+        if (header->closed) {
+            status = CLOSED_ERROR;
+        } else if (header->size != 0 || header->elem_size != entries[i].elem_size ||
+                   header->capacity < entries[i].messages) {
+            status = GENERIC_ERROR;
+        }
+    }
+    unsigned char* in = (unsigned char*)(entries + count);
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        // An empty ring is rewound so the messages land in one contiguous copy
+        shared_channel_header_t* header = channels[i]->header;
+        size_t bytes = entries[i].messages * header->elem_size;
+        memcpy(header->data, in, bytes);
+        header->next = 0;
+        header->size = entries[i].messages;
+        in += bytes;
+        if (header->size > 0) {
+            pthread_cond_broadcast(&header->not_empty);
+        }
+    }
+    shared_unlock_all(locked, count);
+    munmap(map, file_size);
+    if (status == SUCCESS && stats) {
+        stats->channels = count;
+        stats->messages = messages;
+        stats->bytes = file_size;
+        stats->seconds = shared_elapsed(&start);
+    }
+    return status;
+}
@@ -0,0 +1,85 @@
+#ifndef SHARED_CHANNEL_H
+#define SHARED_CHANNEL_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "channel.h"
+
+// Layout of a shared channel inside its shared memory object
+// Messages are copied inline into the ring since pointers cannot cross address spaces
+typedef struct {
+    uint32_t magic;           // identifies an initialized shared channel
+    uint32_t version;         // layout version
+    size_t capacity;          // number of messages the ring holds
+    size_t elem_size;         // size in bytes of every message
+    size_t size;              // number of messages currently in the ring
+    size_t next;              // ring index of the oldest message
+    bool closed;              // set once any process closes the channel
+    pthread_mutex_t lock;     // process-shared, robust mutex protecting the fields above
+    pthread_cond_t not_empty; // process-shared, signaled when a message is added
+    pthread_cond_t not_full;  // process-shared, signaled when a message is removed
+    unsigned char data[];     // capacity * elem_size bytes of message storage
+} shared_channel_header_t;
+
+// Per-process handle to a shared channel
+typedef struct {
+    shared_channel_header_t* header; // mapping of the shared memory object
+    size_t map_size;                 // size of the mapping
+    char* name;                      // shm_open name, or NULL for an anonymous (memfd) channel
+} shared_channel_t;
+
+// Creates a channel in shared memory that other processes can open by name
+// name follows shm_open rules (e.g. "/my_channel"); a NULL name creates an anonymous memfd-backed channel that is
+// shared with child processes created by fork
+// Returns NULL if the name already exists, on invalid sizes, or on any other error
+shared_channel_t* channel_create_shared(const char* name, size_t capacity, size_t elem_size);
+// Opens a shared channel created by another process with channel_create_shared
+// Returns NULL if it does not exist or is not a shared channel
+shared_channel_t* channel_open_shared(const char* name);
+// Copies elem_size bytes from data into the channel, waiting while the channel is full
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR on any other error
+enum channel_status shared_channel_send(shared_channel_t* channel, const void* data);
+// Copies the oldest message into data (elem_size bytes), waiting while the channel is empty
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR on any other error
+enum channel_status shared_channel_receive(shared_channel_t* channel, void* data);
+// Copies elem_size bytes from data into the channel without waiting
+// Returns SUCCESS, CHANNEL_FULL, CLOSED_ERROR, or GENERIC_ERROR
+enum channel_status shared_channel_non_blocking_send(shared_channel_t* channel, const void* data);
+// Copies the oldest message into data without waiting
+// Returns SUCCESS, CHANNEL_EMPTY, CLOSED_ERROR, or GENERIC_ERROR
+enum channel_status shared_channel_non_blocking_receive(shared_channel_t* channel, void* data);
+// Closes the channel for every process and wakes all blocked senders and receivers
+// Returns SUCCESS, or CLOSED_ERROR if the channel is already closed
+enum channel_status shared_channel_close(shared_channel_t* channel);
+// Unmaps the channel from this process and frees the handle; the channel stays alive for other processes
+void shared_channel_detach(shared_channel_t* channel);
+// Removes the channel name so no new process can open it, then detaches
+// Returns SUCCESS, or DESTROY_ERROR if the channel is still open
+enum channel_status shared_channel_destroy(shared_channel_t* channel);
+
+// Throughput figures reported by shared_channel_snapshot and shared_channel_restore
+typedef struct {
+    size_t channels;  // channels written or loaded
+    size_t messages;  // messages written or loaded
+    size_t bytes;     // size of the snapshot file
+    double seconds;   // wall time, including the time spent waiting to quiesce the channels
+} shared_snapshot_stats_t;
+
+// Quiesces the channels and writes the messages buffered in them to a compact snapshot file at path
+// Every channel is locked for the duration, so the snapshot is a consistent cut across all of them;
+// the messages stay in the channels. The file is built at path.tmp, synced, and renamed over path.
+// stats may be NULL
+// Returns SUCCESS, or GENERIC_ERROR on an I/O error or if a channel is listed twice
+enum channel_status shared_channel_snapshot(shared_channel_t** channels, size_t count, const char* path,
+                                            shared_snapshot_stats_t* stats);
+// Loads a snapshot written by shared_channel_snapshot into channels, given in the same order as when it was taken
+// The file is mapped once and each channel is bulk loaded with a single memcpy
+// Every channel must be open and empty, with the same elem_size and at least enough capacity for its messages;
+// nothing is loaded unless all of them qualify. stats may be NULL
+// Returns SUCCESS, CLOSED_ERROR if a channel is closed, or GENERIC_ERROR if the file is missing, malformed,
+// or does not match the channels
+enum channel_status shared_channel_restore(shared_channel_t** channels, size_t count, const char* path,
+                                           shared_snapshot_stats_t* stats);
+
+#endif // SHARED_CHANNEL_H
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "channel.h"
 #include "stress.h"
 
@@ -10,6 +11,7 @@ typedef unsigned int distance_t;
 typedef struct {
     size_t src;
     size_t epoch;
+    atomic_size_t refs; // neighbors still holding a sent copy (conflating mode only)
     distance_t dist[0];
 } distance_vector_t;
 
@@ -20,6 +22,8 @@ static size_t num_channel;
 static channel_t** channels;
 static channel_t* done_channel;
 static channel_t* completed_channel;
+static bool conflating;
+static atomic_size_t vectors_processed;
 
 distance_t get_link_distance(size_t src, size_t dst) {
     return topology[src * num_channel + dst];
@@ -122,6 +126,36 @@ void destroy_topology()
     free(solution);
 }
 
+// Conflation key of a message on a router channel: the sending router, with the convergence probe on its own key
+static uint64_t vector_key(void* data)
+{
+    return data ? ((distance_vector_t*)data)->src : UINT64_MAX;
+}
+
+// Drops one reference to a sent copy of a router state (conflating mode)
+static void vector_release(void* data)
+{
+    distance_vector_t* vector = data;
+    if (vector && atomic_fetch_sub(&vector->refs, 1) == 1) {
+        free(vector);
+    }
+}
+
+// Returns the state to hand to the send cases: the state itself, or in conflating mode an immutable copy
+// shared by the neighbors (sends never block there, so the router may reuse its buffers before they read them)
+static distance_vector_t* vector_to_send(distance_vector_t* state, size_t neighbors)
+{
+    if (!conflating || neighbors == 0) {
+        return state;
+    }
+    size_t size = sizeof(distance_vector_t) + sizeof(distance_t) * num_channel;
+    distance_vector_t* copy = malloc(size);
+    assert(copy != NULL);
+    memcpy(copy, state, size);
+    atomic_init(&copy->refs, neighbors);
+    return copy;
+}
+
 void* router(void* arg)
 {
     bool changed = false;
@@ -166,11 +200,12 @@ void* router(void* arg)
     select_list[select_count].dir = RECV;
     select_list[select_count].data = NULL;
     select_count++;
+    distance_vector_t* sent_state = vector_to_send(curr_state, total_select_count - 2);
     for (size_t i = 0; i < num_channel; i++) {
         if ((i != index) && get_link_distance(index, i) != inf_distance) {
             select_list[select_count].channel = channels[i];
             select_list[select_count].dir = SEND;
-            select_list[select_count].data = curr_state;
+            select_list[select_count].data = sent_state;
             select_count++;
         }
     }
@@ -191,6 +226,10 @@ void* router(void* arg)
                             changed = true;
                         }
                     }
+                    atomic_fetch_add(&vectors_processed, 1);
+                    if (conflating) {
+                        vector_release(neighbor_state);
+                    }
                 } else {
                     // special message sent to test convergence
                     bool converged = (select_count == 2) && !changed;
@@ -220,8 +259,9 @@ void* router(void* arg)
                     }
                     // reset to broadcast again
                     select_count = total_select_count;
+                    sent_state = vector_to_send(curr_state, total_select_count - 2);
                     for (size_t i = 2; i < select_count; i++) {
-                        select_list[i].data = curr_state;
+                        select_list[i].data = sent_state;
                     }
                     changed = false;
                 }
@@ -233,6 +273,11 @@ void* router(void* arg)
             break;
         }
     }
+    // The copy still owes a reference for every neighbor it was not sent to
+    while (sent_state != curr_state && select_count > 2) {
+        vector_release(sent_state);
+        select_count--;
+    }
     free(select_list);
     free(prev_prev_state);
     free(prev_state);
@@ -300,9 +345,17 @@ bool check_done()
 }
 
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename)
+{
+    run_stress_routers(main_buffer_size, secondary_buffer_size, filename, false, NULL);
+}
+
+size_t run_stress_routers(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, bool conflate,
+                          size_t* superseded)
 {
     assert(main_buffer_size <= 1); // only support up to a buffer size of 1
     assert(secondary_buffer_size <= 1); // only support up to a buffer size of 1
+    conflating = conflate;
+    atomic_store(&vectors_processed, 0);
     int pthread_status;
     enum channel_status status;
     bool initialized = create_topology(filename);
@@ -310,7 +363,8 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(main_buffer_size);
+        // Routers only care about the newest vector of each neighbor, which a conflating channel keeps per sender
+        channels[i] = conflating ? channel_create_conflating(vector_key, vector_release) : channel_create(main_buffer_size);
         assert(channels[i] != NULL);
     }
     done_channel = channel_create(secondary_buffer_size);
@@ -344,6 +398,12 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     assert(status == SUCCESS);
     status = channel_destroy(completed_channel);
     assert(status == SUCCESS);
+    if (superseded) {
+        *superseded = 0;
+        for (size_t i = 0; i < num_channel; i++) {
+            *superseded += channel_conflated(channels[i]);
+        }
+    }
     for (size_t i = 0; i < num_channel; i++) {
         status = channel_close(channels[i]);
         assert(status == SUCCESS);
@@ -353,4 +413,5 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     free(pid);
     free(channels);
     destroy_topology();
+    return atomic_load(&vectors_processed);
 }
@@ -1,6 +1,15 @@
 #ifndef STRESS_H
 #define STRESS_H
 
+#include <stddef.h>
+#include <stdbool.h>
+
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename);
+// Runs the distance-vector routers of run_stress and returns how many neighbor vectors they processed
+// With conflate, router channels are conflating channels keyed by sender (main_buffer_size is then unused),
+// so a router only ever processes the newest vector of each neighbor; superseded (if not NULL) receives the number
+// of vectors that were replaced before being processed
+size_t run_stress_routers(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, bool conflate,
+                          size_t* superseded);
 
 #endif // STRESS_H
@@ -11,6 +11,7 @@ static size_t num_channel;
 static channel_t** channels;
 static atomic_bool done;
 static channel_t* main_channel;
+static int thread_node;
 
 void* worker_thread(void* arg)
 {
@@ -21,6 +22,10 @@ void* worker_thread(void* arg)
     }
     channel_t* my_channel = channels[index];
     channel_t* next_channel = channels[next_index];
+    if (thread_node != CHANNEL_NODE_ANY) {
+        numa_pin_thread(thread_node);
+    }
+    size_t hops = 0;
     bool start = true;
     enum channel_status status;
     while (true) {
@@ -49,16 +54,25 @@ void* worker_thread(void* arg)
             // Pass along message to next thread in ring
             status = channel_send(next_channel, data);
             assert(status == SUCCESS);
+            hops++;
         }
     }
-    return NULL;
+    return (void*)hops;
 }
 
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
+{
+    run_stress_send_recv_on_node(buffer_size, num_threads, load, duration_usec, CHANNEL_NODE_ANY, CHANNEL_NODE_ANY);
+}
+
+size_t run_stress_send_recv_on_node(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec,
+                                    int channel_node, int worker_node)
 {
     enum channel_status status;
+    size_t hops = 0;
     // setup
     num_channel = num_threads;
+    thread_node = worker_node;
     atomic_store(&done, false);
     size_t num_msgs = (size_t)(((double)(num_channel * (buffer_size + 1))) * load);
     bool* msg_check = calloc(num_msgs + 1, sizeof(bool));
@@ -67,7 +81,8 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
     for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(buffer_size);
+        channels[i] = channel_node == CHANNEL_NODE_ANY ? channel_create(buffer_size)
+                                                       : channel_create_on_node(buffer_size, channel_node);
         assert(channels[i] != NULL);
     }
     main_channel = channel_create(buffer_size);
@@ -116,7 +131,9 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     }
     for (size_t i = 0; i < num_channel; i++) {
         // join threads
-        pthread_join(pid[i], NULL);
+        void* thread_hops = NULL;
+        pthread_join(pid[i], &thread_hops);
+        hops += (size_t)thread_hops;
     }
 
     // cleanup
@@ -133,4 +150,5 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     free(msg_check);
     free(pid);
     free(channels);
+    return hops;
 }
@@ -3,4 +3,9 @@
 
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
 
+// Same ring as run_stress_send_recv, with the ring channels placed on channel_node and the workers pinned to
+// worker_node (either may be CHANNEL_NODE_ANY). Returns the number of hops messages made around the ring.
+size_t run_stress_send_recv_on_node(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec,
+                                    int channel_node, int worker_node);
+
 #endif // STRESS_SEND_RECV_H
@@ -1,13 +1,31 @@
 #include <stdio.h>
 #include "channel.h"
+#include "compact_channel.h"
+#include "shared_channel.h"
+#include "uring_stage.h"
+#include "mmap_source.h"
+#include "trace.h"
+#include "broadcast.h"
+#include "futex.h"
 #include <assert.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <stddef.h>
+#include <poll.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "stress.h"
 #include "stress_send_recv.h"
 
@@ -1634,6 +1652,2197 @@ char* test_select_with_duplicate_channel_size1() {
 }
 
 
+char* test_unbounded_channel() {
+    print_test_details(__func__, "Testing unbounded segmented channel");
+
+    size_t segment_size = 4;
+    size_t count = 1000;
+    channel_t* channel = channel_create_unbounded(segment_size);
+    mu_assert("test_unbounded_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_unbounded_channel: Zero segment size should fail\n", channel_create_unbounded(0) == NULL);
+
+    // Senders never block: fill the channel far past one segment without any receiver
+    for (size_t i = 1; i <= count; i++) {
+        mu_assert("test_unbounded_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_unbounded_channel: Non-blocking send failed\n", channel_non_blocking_send(channel, (void*)(count + 1)) == SUCCESS);
+    mu_assert("test_unbounded_channel: Buffer size is not as expected\n", buffer_current_size(channel->buffer) == count + 1);
+    mu_assert("test_unbounded_channel: Peek is not as expected\n", peek_buffer(channel->buffer, 5) == (void*)6);
+
+    // Select with a send case must also complete immediately
+    select_t list[1];
+    list[0].channel = channel;
+    list[0].dir = SEND;
+    list[0].data = (void*)(count + 2);
+    size_t index = 1;
+    mu_assert("test_unbounded_channel: Select send failed\n", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    mu_assert("test_unbounded_channel: High-water mark is not as expected\n", channel_high_water(channel) == count + 2);
+
+    // Messages come back in FIFO order across segment boundaries
+    for (size_t i = 1; i <= count + 2; i++) {
+        void* data = NULL;
+        mu_assert("test_unbounded_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_unbounded_channel: Out of order message\n", data == (void*)i);
+    }
+    void* data = NULL;
+    mu_assert("test_unbounded_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_unbounded_channel: High-water mark should persist\n", channel_high_water(channel) == count + 2);
+
+    // Reuse after draining
+    mu_assert("test_unbounded_channel: Send after drain failed\n", channel_send(channel, "Message") == SUCCESS);
+    mu_assert("test_unbounded_channel: Receive after drain failed\n", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_unbounded_channel: Invalid message\n", string_equal(data, "Message"));
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_mapped_channel() {
+    print_test_details(__func__, "Testing mmap-backed channel buffers");
+
+    // Reserve far more than we ever touch; only the backlog should become resident
+    // The backlog only has to reach the release threshold for the drain to hand its pages back
+    size_t capacity = (size_t)1 << 24;
+    size_t count = BUFFER_MAP_RELEASE_BYTES / sizeof(void*) + 1;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned char resident = 0;
+    channel_t* channel = channel_create_mapped(capacity, BUFFER_MAP_HUGEPAGE);
+    mu_assert("test_mapped_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_mapped_channel: Zero capacity should fail\n", channel_create_mapped(0, 0) == NULL);
+    mu_assert("test_mapped_channel: Buffer capacity is not as expected\n", buffer_capacity(channel->buffer) == capacity);
+
+    for (size_t i = 1; i <= count; i++) {
+        mu_assert("test_mapped_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_mapped_channel: Buffer size is not as expected\n", buffer_current_size(channel->buffer) == count);
+    mu_assert("test_mapped_channel: mincore failed\n", mincore(channel->buffer->data, page, &resident) == 0);
+    mu_assert("test_mapped_channel: Touched page should be resident\n", (resident & 1) == 1);
+
+    for (size_t i = 1; i <= count; i++) {
+        void* data = NULL;
+        mu_assert("test_mapped_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_mapped_channel: Out of order message\n", data == (void*)i);
+    }
+    // Draining the channel hands the touched pages back to the kernel
+    mu_assert("test_mapped_channel: mincore failed\n", mincore(channel->buffer->data, page, &resident) == 0);
+    mu_assert("test_mapped_channel: Drained page should be released\n", (resident & 1) == 0);
+
+    // The ring keeps working after a release
+    void* data = NULL;
+    mu_assert("test_mapped_channel: Send after drain failed\n", channel_send(channel, "Message") == SUCCESS);
+    mu_assert("test_mapped_channel: Receive after drain failed\n", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_mapped_channel: Invalid message\n", string_equal(data, "Message"));
+
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // A steady backlog that never drains still hands the consumed pages back as the head moves past them,
+    // including across wraparound; the ring spans two release chunks and is pushed through one and a half times
+    size_t chunk = BUFFER_MAP_RELEASE_BYTES / sizeof(void*);
+    size_t slots = 2 * chunk;
+    size_t backlog = 16;
+    size_t pages = slots * sizeof(void*) / page;
+    unsigned char* residency = malloc(pages);
+    buffer_t* ring = buffer_create_mapped(slots, 0);
+    mu_assert("test_mapped_channel: Could not create buffer\n", ring != NULL && residency != NULL);
+    size_t sent = 0, received = 0;
+    for (; sent < backlog; sent++) {
+        mu_assert("test_mapped_channel: Add failed\n", buffer_add(ring, (void*)(sent + 1)) == BUFFER_SUCCESS);
+    }
+    while (received < 3 * chunk) {
+        mu_assert("test_mapped_channel: Add failed\n", buffer_add(ring, (void*)(++sent)) == BUFFER_SUCCESS);
+        mu_assert("test_mapped_channel: Remove failed\n", buffer_remove(ring, &data) == BUFFER_SUCCESS);
+        mu_assert("test_mapped_channel: Out of order message\n", data == (void*)(++received));
+    }
+    mu_assert("test_mapped_channel: mincore failed\n", mincore(ring->data, pages * page, residency) == 0);
+    size_t resident_pages = 0;
+    for (size_t i = 0; i < pages; i++) {
+        resident_pages += residency[i] & 1;
+    }
+    mu_assert("test_mapped_channel: Backlog residency should stay bounded\n",
+              resident_pages <= BUFFER_MAP_RELEASE_BYTES / page + 2);
+
+    // A backlog that wraps into the consumed slots keeps its values
+    for (; sent - received < slots - backlog; sent++) {
+        mu_assert("test_mapped_channel: Add failed\n", buffer_add(ring, (void*)(sent + 1)) == BUFFER_SUCCESS);
+    }
+    while (received < 5 * chunk + backlog) {
+        mu_assert("test_mapped_channel: Remove failed\n", buffer_remove(ring, &data) == BUFFER_SUCCESS);
+        mu_assert("test_mapped_channel: Out of order message\n", data == (void*)(++received));
+        mu_assert("test_mapped_channel: Add failed\n", buffer_add(ring, (void*)(++sent)) == BUFFER_SUCCESS);
+    }
+    buffer_free(ring);
+    free(residency);
+
+    // A small mapped channel wraps around like a regular one
+    channel = channel_create_mapped(2, 0);
+    mu_assert("test_mapped_channel: Could not create channel\n", channel != NULL);
+    for (size_t i = 1; i <= 10; i++) {
+        mu_assert("test_mapped_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+        if (i % 2 == 0) {
+            mu_assert("test_mapped_channel: Channel should be full\n", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+            mu_assert("test_mapped_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && data == (void*)(i - 1));
+            mu_assert("test_mapped_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && data == (void*)i);
+        }
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_numa_channel() {
+    print_test_details(__func__, "Testing NUMA placed channels");
+
+    bool multi_node = numa_node_count() > 1;
+    void* data = NULL;
+
+    // Bound to an explicit node (a no-op on single-node machines)
+    channel_t* channel = channel_create_on_node(4, 0);
+    mu_assert("test_numa_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_numa_channel: Unexpected node\n", channel_numa_node(channel) == (multi_node ? 0 : CHANNEL_NODE_ANY));
+    mu_assert("test_numa_channel: Buffer capacity is not as expected\n", buffer_capacity(channel->buffer) == 4);
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_numa_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_numa_channel: Channel should be full\n", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_numa_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && data == (void*)i);
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // CHANNEL_NODE_ANY asks for no placement: a heap channel, which channel_destroy frees as such
+    channel = channel_create_on_node(4, CHANNEL_NODE_ANY);
+    mu_assert("test_numa_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_numa_channel: Unplaced channel got a node\n", channel_numa_node(channel) == CHANNEL_NODE_ANY);
+    mu_assert("test_numa_channel: Send failed\n", channel_send(channel, "Message") == SUCCESS);
+    mu_assert("test_numa_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+    channel_close(channel);
+    mu_assert("test_numa_channel: Destroy failed\n", channel_destroy(channel) == SUCCESS);
+
+    // Bound to whichever node the first receiver runs on
+    channel = channel_create_on_node(4, CHANNEL_NODE_FIRST_CONSUMER);
+    mu_assert("test_numa_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_numa_channel: Send failed\n", channel_send(channel, "Message") == SUCCESS);
+    if (multi_node) {
+        mu_assert("test_numa_channel: Channel claimed before first receive\n", channel_numa_node(channel) == CHANNEL_NODE_FIRST_CONSUMER);
+    }
+    mu_assert("test_numa_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_numa_channel: Invalid message\n", string_equal(data, "Message"));
+    mu_assert("test_numa_channel: Channel not claimed by first receive\n", channel_numa_node(channel) >= (multi_node ? 0 : CHANNEL_NODE_ANY));
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Pinned ring workers still pass every message around
+    mu_assert("test_numa_channel: Pinning failed\n", numa_pin_thread(0) == 0);
+    run_stress_send_recv_on_node(2, 4, 0.5, 10000, 0, 0);
+    return NULL;
+}
+
+typedef struct {
+    compact_channel_t *channel;
+    void *data;
+    enum channel_status out;
+} compact_args;
+
+void* helper_compact_receive(compact_args* myargs) {
+    myargs->out = compact_channel_receive(myargs->channel, &myargs->data);
+    return NULL;
+}
+
+void* helper_compact_send(compact_args* myargs) {
+    myargs->out = compact_channel_send(myargs->channel, myargs->data);
+    return NULL;
+}
+
+char* test_compact_channel() {
+    print_test_details(__func__, "Testing compact channels");
+
+    mu_assert("test_compact_channel: Compact channel is too large\n", sizeof(compact_channel_t) <= 64);
+    compact_channel_t* channel = compact_channel_create(1);
+    mu_assert("test_compact_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_compact_channel: Idle channel should not allocate\n", channel->buffer == NULL && channel->waiters == NULL);
+
+    void* data = NULL;
+    mu_assert("test_compact_channel: Channel should be empty\n", compact_channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_compact_channel: Send failed\n", compact_channel_non_blocking_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_compact_channel: Channel should be full\n", compact_channel_non_blocking_send(channel, "Message2") == CHANNEL_FULL);
+    mu_assert("test_compact_channel: Non-blocking ops should not allocate waiters\n", channel->waiters == NULL);
+
+    // Blocked sender is released by a receive
+    pthread_t pid;
+    compact_args args = {channel, "Message2", GENERIC_ERROR};
+    pthread_create(&pid, NULL, (void*)helper_compact_send, &args);
+    usleep(10000);
+    mu_assert("test_compact_channel: Receive failed\n", compact_channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_compact_channel: Invalid message\n", string_equal(data, "Message1"));
+    pthread_join(pid, NULL);
+    mu_assert("test_compact_channel: Blocked send failed\n", args.out == SUCCESS);
+    mu_assert("test_compact_channel: Receive failed\n", compact_channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_compact_channel: Invalid message\n", string_equal(data, "Message2"));
+
+    // Blocked receiver is released by a send
+    args.data = NULL;
+    pthread_create(&pid, NULL, (void*)helper_compact_receive, &args);
+    usleep(10000);
+    mu_assert("test_compact_channel: Send failed\n", compact_channel_send(channel, "Message3") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_compact_channel: Blocked receive failed\n", args.out == SUCCESS && string_equal(args.data, "Message3"));
+
+    // Close releases blocked receivers
+    mu_assert("test_compact_channel: Destroy on open channel should fail\n", compact_channel_destroy(channel) == DESTROY_ERROR);
+    pthread_create(&pid, NULL, (void*)helper_compact_receive, &args);
+    usleep(10000);
+    mu_assert("test_compact_channel: Close failed\n", compact_channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_compact_channel: Blocked receive should see close\n", args.out == CLOSED_ERROR);
+    mu_assert("test_compact_channel: Second close should fail\n", compact_channel_close(channel) == CLOSED_ERROR);
+    mu_assert("test_compact_channel: Send on closed channel should fail\n", compact_channel_send(channel, "Message") == CLOSED_ERROR);
+    mu_assert("test_compact_channel: Destroy failed\n", compact_channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+char* test_memory_governor() {
+    print_test_details(__func__, "Testing the process-wide memory governor");
+
+    channel_t* channel_a = channel_create(10);
+    channel_t* channel_b = channel_create(10);
+    void* data = NULL;
+    size_t index = 2;
+    governor_set_budget(4, GOVERNOR_ENTRIES, GOVERNOR_FAIL);
+
+    // Exhaust the budget across two channels
+    for (size_t i = 0; i < 3; i++) {
+        mu_assert("test_memory_governor: Send failed\n", channel_send(channel_a, "Message") == SUCCESS);
+    }
+    mu_assert("test_memory_governor: Send failed\n", channel_non_blocking_send(channel_b, "Message") == SUCCESS);
+    mu_assert("test_memory_governor: Global usage is not as expected\n", governor_usage() == 4);
+    mu_assert("test_memory_governor: Channel usage is not as expected\n", channel_budget_usage(channel_a) == 3);
+    mu_assert("test_memory_governor: Channel usage is not as expected\n", channel_budget_usage(channel_b) == 1);
+
+    // Fail policy: every kind of send reports the exhausted budget
+    mu_assert("test_memory_governor: Send should be over budget\n", channel_send(channel_b, "Message") == CHANNEL_OVER_BUDGET);
+    mu_assert("test_memory_governor: Non-blocking send should be over budget\n", channel_non_blocking_send(channel_b, "Message") == CHANNEL_OVER_BUDGET);
+    select_t list[2];
+    list[0].channel = channel_b;
+    list[0].dir = RECV;
+    list[1].channel = channel_a;
+    list[1].dir = SEND;
+    list[1].data = "Message";
+    mu_assert("test_memory_governor: Select should receive\n", channel_select(list, 2, &index) == SUCCESS && index == 0);
+    mu_assert("test_memory_governor: Send failed\n", channel_send(channel_b, "Message") == SUCCESS);
+    mu_assert("test_memory_governor: Select should be over budget\n", channel_select(&list[1], 1, &index) == CHANNEL_OVER_BUDGET && index == 0);
+
+    // Receiving gives budget back to every channel
+    mu_assert("test_memory_governor: Receive failed\n", channel_receive(channel_a, &data) == SUCCESS);
+    mu_assert("test_memory_governor: Global usage is not as expected\n", governor_usage() == 3);
+    mu_assert("test_memory_governor: Send failed\n", channel_send(channel_b, "Message") == SUCCESS);
+
+    // Block policy: a sender waits until another channel drains
+    governor_set_budget(4, GOVERNOR_ENTRIES, GOVERNOR_BLOCK);
+    pthread_t pid;
+    sem_t done;
+    sem_init(&done, 0, 0);
+    send_args send;
+    init_object_for_send_api(&send, channel_b, "Blocked", &done);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    mu_assert("test_memory_governor: Send should be blocked\n", sem_trywait(&done) == -1);
+    mu_assert("test_memory_governor: Receive failed\n", channel_receive(channel_a, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_memory_governor: Blocked send failed\n", send.out == SUCCESS);
+
+    // Block policy: select waits for budget as well
+    select_args args;
+    init_object_for_select_api(&args, &list[1], 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_memory_governor: Receive failed\n", channel_receive(channel_b, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_memory_governor: Blocked select failed\n", args.out == SUCCESS && args.index == 0);
+
+    // Closing a channel releases its senders that wait for budget
+    init_object_for_send_api(&send, channel_b, "Blocked", &done);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    mu_assert("test_memory_governor: Close failed\n", channel_close(channel_b) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_memory_governor: Blocked send should see close\n", send.out == CLOSED_ERROR);
+
+    // Destroying channels returns what their buffers still hold
+    channel_close(channel_a);
+    channel_destroy(channel_a);
+    channel_destroy(channel_b);
+    mu_assert("test_memory_governor: Budget not fully released\n", governor_usage() == 0);
+    governor_set_budget(0, GOVERNOR_ENTRIES, GOVERNOR_BLOCK);
+    sem_destroy(&done);
+    return NULL;
+}
+
+char* test_shared_channel() {
+    print_test_details(__func__, "Testing cross-process shared memory channels");
+
+    char name[64];
+    snprintf(name, sizeof(name), "/channel_test_%d", (int)getpid());
+    size_t count = 100;
+    shared_channel_t* channel = channel_create_shared(name, 4, sizeof(size_t));
+    mu_assert("test_shared_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_shared_channel: Duplicate name should fail\n", channel_create_shared(name, 4, sizeof(size_t)) == NULL);
+    mu_assert("test_shared_channel: Invalid size should fail\n", channel_create_shared(NULL, 4, 0) == NULL);
+
+    // Non-blocking semantics in a single process
+    size_t value = 0;
+    mu_assert("test_shared_channel: Channel should be empty\n", shared_channel_non_blocking_receive(channel, &value) == CHANNEL_EMPTY);
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_shared_channel: Send failed\n", shared_channel_non_blocking_send(channel, &i) == SUCCESS);
+    }
+    mu_assert("test_shared_channel: Channel should be full\n", shared_channel_non_blocking_send(channel, &value) == CHANNEL_FULL);
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_shared_channel: Receive failed\n", shared_channel_non_blocking_receive(channel, &value) == SUCCESS && value == i);
+    }
+
+    // A child process opens the channel by name, drains it and then observes the close
+    pid_t child = fork();
+    if (child == 0) {
+        shared_channel_t* peer = channel_open_shared(name);
+        int failed = peer == NULL;
+        for (size_t i = 0; !failed && i < count; i++) {
+            size_t received = 0;
+            failed = shared_channel_receive(peer, &received) != SUCCESS || received != i;
+        }
+        if (!failed) {
+            failed = shared_channel_receive(peer, &value) != CLOSED_ERROR;
+            shared_channel_detach(peer);
+        }
+        _exit(failed);
+    }
+    mu_assert("test_shared_channel: Fork failed\n", child > 0);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("test_shared_channel: Send failed\n", shared_channel_send(channel, &i) == SUCCESS);
+    }
+    // Wait until the child has consumed everything before closing
+    while (true) {
+        pthread_mutex_lock(&channel->header->lock);
+        size_t size = channel->header->size;
+        pthread_mutex_unlock(&channel->header->lock);
+        if (size == 0) {
+            break;
+        }
+        usleep(1000);
+    }
+    usleep(10000);
+    mu_assert("test_shared_channel: Destroy on open channel should fail\n", shared_channel_destroy(channel) == DESTROY_ERROR);
+    mu_assert("test_shared_channel: Close failed\n", shared_channel_close(channel) == SUCCESS);
+    int status = 0;
+    waitpid(child, &status, 0);
+    mu_assert("test_shared_channel: Child process failed\n", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    mu_assert("test_shared_channel: Send on closed channel should fail\n", shared_channel_send(channel, &value) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Destroy failed\n", shared_channel_destroy(channel) == SUCCESS);
+    mu_assert("test_shared_channel: Destroyed channel should not open\n", channel_open_shared(name) == NULL);
+    return NULL;
+}
+
+// Returns true if fd polls readable right now
+bool fd_is_ready(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+typedef struct {
+    channel_t *channel;
+    int epoll_fd;
+    size_t received;
+    size_t expected;
+} epoll_consumer_args;
+
+// Drives a channel consumer from an epoll loop without ever blocking in channel_receive
+void* helper_epoll_consumer(epoll_consumer_args* myargs) {
+    while (myargs->received < myargs->expected) {
+        struct epoll_event event;
+        if (epoll_wait(myargs->epoll_fd, &event, 1, -1) != 1) {
+            continue;
+        }
+        void* data = NULL;
+        while (channel_non_blocking_receive(myargs->channel, &data) == SUCCESS) {
+            myargs->received++;
+        }
+    }
+    return NULL;
+}
+
+char* test_channel_readiness_fds() {
+    print_test_details(__func__, "Testing eventfd readiness descriptors");
+
+    channel_t* channel = channel_create(2);
+    void* data = NULL;
+    int readable = channel_readable_fd(channel);
+    int writable = channel_writable_fd(channel);
+    mu_assert("test_channel_readiness_fds: Could not create descriptors\n", readable >= 0 && writable >= 0);
+    mu_assert("test_channel_readiness_fds: Descriptors should be cached\n", channel_readable_fd(channel) == readable);
+    mu_assert("test_channel_readiness_fds: Empty channel should not be readable\n", !fd_is_ready(readable));
+    mu_assert("test_channel_readiness_fds: Empty channel should be writable\n", fd_is_ready(writable));
+
+    // Edge transitions: empty -> non-empty -> full -> non-full -> empty
+    channel_send(channel, "Message1");
+    mu_assert("test_channel_readiness_fds: Channel should be readable\n", fd_is_ready(readable));
+    channel_send(channel, "Message2");
+    mu_assert("test_channel_readiness_fds: Full channel should not be writable\n", !fd_is_ready(writable));
+    channel_receive(channel, &data);
+    mu_assert("test_channel_readiness_fds: Channel should be writable again\n", fd_is_ready(writable));
+    mu_assert("test_channel_readiness_fds: Channel should still be readable\n", fd_is_ready(readable));
+    channel_receive(channel, &data);
+    mu_assert("test_channel_readiness_fds: Drained channel should not be readable\n", !fd_is_ready(readable));
+
+    // A burst of sends is coalesced into a single eventfd write
+    channel_send(channel, "Message1");
+    channel_send(channel, "Message2");
+    uint64_t counter = 0;
+    mu_assert("test_channel_readiness_fds: Read failed\n", read(readable, &counter, sizeof(counter)) == sizeof(counter));
+    mu_assert("test_channel_readiness_fds: Burst was not coalesced\n", counter == 1);
+    channel_receive(channel, &data);
+    channel_receive(channel, &data);
+
+    // An epoll loop consumes the channel with no polling
+    epoll_consumer_args args = {channel, epoll_create1(0), 0, 100};
+    struct epoll_event event = {EPOLLIN, {0}};
+    mu_assert("test_channel_readiness_fds: epoll_ctl failed\n", epoll_ctl(args.epoll_fd, EPOLL_CTL_ADD, readable, &event) == 0);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_epoll_consumer, &args);
+    for (size_t i = 0; i < args.expected; i++) {
+        mu_assert("test_channel_readiness_fds: Send failed\n", channel_send(channel, "Message") == SUCCESS);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_readiness_fds: Consumer missed messages\n", args.received == args.expected);
+    close(args.epoll_fd);
+
+    // Closing makes both descriptors fire
+    channel_send(channel, "Message1");
+    channel_send(channel, "Message2");
+    channel_close(channel);
+    mu_assert("test_channel_readiness_fds: Closed channel should be readable\n", fd_is_ready(readable));
+    mu_assert("test_channel_readiness_fds: Closed channel should be writable\n", fd_is_ready(writable));
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_select_fd_cases() {
+    print_test_details(__func__, "Testing select on a mix of channels and file descriptors");
+
+    channel_t* channel = channel_create(1);
+    int pipe_fds[2];
+    mu_assert("test_select_fd_cases: pipe failed\n", pipe(pipe_fds) == 0);
+
+    select_t list[2];
+    list[0].channel = channel;
+    list[0].dir = RECV;
+    list[1].channel = NULL;
+    list[1].dir = FD_READ;
+    list[1].fd = pipe_fds[0];
+
+    sem_t done;
+    sem_init(&done, 0, 0);
+    pthread_t pid;
+
+    // Blocked select is woken by the pipe becoming readable
+    // Nothing orders args.out with a pipe write, so whether the select still waits is read from the semaphore
+    select_args args;
+    init_object_for_select_api(&args, list, 2, &done);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_fd_cases: It isn't blocked as expected\n", sem_trywait(&done) != 0);
+    char byte = 'x';
+    mu_assert("test_select_fd_cases: write failed\n", write(pipe_fds[1], &byte, 1) == 1);
+    sem_wait(&done);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_fd_cases: FD case was not selected\n", args.out == SUCCESS && args.index == 1);
+    mu_assert("test_select_fd_cases: Select should not consume fd data\n", read(pipe_fds[0], &byte, 1) == 1);
+
+    // Blocked select is woken by a channel send
+    init_object_for_select_api(&args, list, 2, &done);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_fd_cases: It isn't blocked as expected\n", sem_trywait(&done) != 0);
+    channel_send(channel, "Message1");
+    sem_wait(&done);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_fd_cases: Channel case was not selected\n", args.out == SUCCESS && args.index == 0);
+    mu_assert("test_select_fd_cases: Received value doesn't match\n", string_equal(list[0].data, "Message1"));
+
+    // The first ready case wins when both are ready
+    channel_send(channel, "Message2");
+    mu_assert("test_select_fd_cases: write failed\n", write(pipe_fds[1], &byte, 1) == 1);
+    size_t index = 2;
+    mu_assert("test_select_fd_cases: Select failed\n", channel_select(list, 2, &index) == SUCCESS);
+    mu_assert("test_select_fd_cases: Wrong case selected\n", index == 0);
+    mu_assert("test_select_fd_cases: Select failed\n", channel_select(list, 2, &index) == SUCCESS);
+    mu_assert("test_select_fd_cases: Wrong case selected\n", index == 1);
+    mu_assert("test_select_fd_cases: read failed\n", read(pipe_fds[0], &byte, 1) == 1);
+
+    // FD_WRITE on the write end of an empty pipe is ready straight away
+    select_t write_list[1];
+    write_list[0].channel = NULL;
+    write_list[0].dir = FD_WRITE;
+    write_list[0].fd = pipe_fds[1];
+    mu_assert("test_select_fd_cases: FD_WRITE not ready\n", channel_select(write_list, 1, &index) == SUCCESS && index == 0);
+
+    // An invalid descriptor is reported as an error for its case
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    list[1].fd = -1;
+    mu_assert("test_select_fd_cases: Invalid fd should fail\n", channel_select(list, 2, &index) == GENERIC_ERROR);
+    mu_assert("test_select_fd_cases: Wrong error index\n", index == 1);
+
+    channel_close(channel);
+    mu_assert("test_select_fd_cases: Closed channel should be reported first\n", channel_select(list, 2, &index) == CLOSED_ERROR && index == 0);
+    channel_destroy(channel);
+    sem_destroy(&done);
+    return NULL;
+}
+
+// Runs a uring source on its own thread
+void* helper_uring_source(uring_source_t* source) {
+    return (void*)(intptr_t)uring_source_run(source);
+}
+
+typedef struct {
+    channel_t* in;
+    int fd;
+    channel_t* release;
+    enum channel_status status;
+} uring_sink_args;
+
+// Runs a uring sink on a thread whose io_uring_enter calls are all rejected, so every submission fails
+void* helper_rejecting_uring_sink(uring_sink_args* myargs) {
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_enter, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | EBUSY),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog program = {.len = sizeof(filter) / sizeof(filter[0]), .filter = filter};
+    prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+    prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program);
+    myargs->status = uring_sink_run(myargs->in, myargs->fd, 8, myargs->release);
+    return NULL;
+}
+
+char* test_uring_stage() {
+    print_test_details(__func__, "Testing io_uring source and sink stages");
+
+    // An input file that does not end on a buffer boundary, plus an empty one
+    char in_name[] = "/tmp/uring_in_XXXXXX";
+    char out_name[] = "/tmp/uring_out_XXXXXX";
+    char empty_name[] = "/tmp/uring_empty_XXXXXX";
+    int in_fd = mkstemp(in_name);
+    int out_fd = mkstemp(out_name);
+    int empty_fd = mkstemp(empty_name);
+    mu_assert("test_uring_stage: mkstemp failed\n", in_fd >= 0 && out_fd >= 0 && empty_fd >= 0);
+    unlink(in_name);
+    unlink(out_name);
+    unlink(empty_name);
+    const size_t file_size = 1000 * 1000 + 123;
+    char* contents = malloc(file_size);
+    for (size_t i = 0; i < file_size; i++) {
+        contents[i] = (char)(i * 31 + i / 4096);
+    }
+    mu_assert("test_uring_stage: write failed\n", write(in_fd, contents, file_size) == (ssize_t)file_size);
+
+    // Buffers that would not fit in the address space are refused up front
+    mu_assert("test_uring_stage: Oversized buffers should fail\n", uring_source_create(SIZE_MAX / 1024, 64 * 1024, 8) == NULL);
+
+    // File -> channel -> file copy, with the sink recycling buffers straight into the source
+    uring_source_t* source = uring_source_create(8, 64 * 1024, 8);
+    mu_assert("test_uring_stage: Could not create source\n", source != NULL);
+    channel_t* chunks = channel_create(8);
+    mu_assert("test_uring_stage: add_file failed\n", uring_source_add_file(source, in_fd, chunks) == 0);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_uring_source, source);
+    mu_assert("test_uring_stage: Sink failed\n", uring_sink_run(chunks, out_fd, 8, uring_source_free_channel(source)) == SUCCESS);
+    void* source_status;
+    pthread_join(pid, &source_status);
+    mu_assert("test_uring_stage: Source failed\n", (intptr_t)source_status == SUCCESS);
+    char* copy = malloc(file_size + 1);
+    mu_assert("test_uring_stage: Copy has wrong size\n", pread(out_fd, copy, file_size + 1, 0) == (ssize_t)file_size);
+    mu_assert("test_uring_stage: Copy differs\n", memcmp(copy, contents, file_size) == 0);
+    uring_source_destroy(source);
+
+    // A sink whose submissions are rejected still writes every chunk and hands each buffer back,
+    // so the source is not left waiting for free buffers
+    mu_assert("test_uring_stage: ftruncate failed\n", ftruncate(out_fd, 0) == 0);
+    source = uring_source_create(8, 64 * 1024, 8);
+    mu_assert("test_uring_stage: Could not create source\n", source != NULL);
+    mu_assert("test_uring_stage: add_file failed\n", uring_source_add_file(source, in_fd, chunks) == 0);
+    uring_sink_args sink_args = {chunks, out_fd, uring_source_free_channel(source), GENERIC_ERROR};
+    pthread_t sink_pid;
+    pthread_create(&pid, NULL, (void *)helper_uring_source, source);
+    pthread_create(&sink_pid, NULL, (void *)helper_rejecting_uring_sink, &sink_args);
+    pthread_join(sink_pid, NULL);
+    pthread_join(pid, &source_status);
+    mu_assert("test_uring_stage: Rejected sink failed\n", sink_args.status == SUCCESS);
+    mu_assert("test_uring_stage: Source failed\n", (intptr_t)source_status == SUCCESS);
+    mu_assert("test_uring_stage: Copy has wrong size\n", pread(out_fd, copy, file_size + 1, 0) == (ssize_t)file_size);
+    mu_assert("test_uring_stage: Copy differs\n", memcmp(copy, contents, file_size) == 0);
+    uring_source_destroy(source);
+
+    // Two files into one channel: every byte arrives once and each file ends with one zero-length chunk
+    source = uring_source_create(4, 100 * 1000, 4);
+    uring_source_add_file(source, in_fd, chunks);
+    uring_source_add_file(source, empty_fd, chunks);
+    pthread_create(&pid, NULL, (void *)helper_uring_source, source);
+    size_t bytes = 0;
+    size_t markers = 0;
+    bool matches = true;
+    while (markers < 2) {
+        void* data = NULL;
+        mu_assert("test_uring_stage: Receive failed\n", channel_receive(chunks, &data) == SUCCESS);
+        io_chunk_t* chunk = data;
+        if (chunk->length == 0) {
+            mu_assert("test_uring_stage: Unexpected read error\n", chunk->error == 0);
+            markers++;
+        } else {
+            mu_assert("test_uring_stage: Data from empty file\n", chunk->fd == in_fd);
+            matches &= memcmp(chunk->data, contents + chunk->offset, chunk->length) == 0;
+            bytes += chunk->length;
+        }
+        uring_source_release(source, chunk);
+    }
+    pthread_join(pid, &source_status);
+    mu_assert("test_uring_stage: Source failed\n", (intptr_t)source_status == SUCCESS);
+    mu_assert("test_uring_stage: Byte count doesn't match\n", bytes == file_size);
+    mu_assert("test_uring_stage: Chunk contents don't match\n", matches);
+    uring_source_destroy(source);
+
+    channel_close(chunks);
+    channel_destroy(chunks);
+    free(contents);
+    free(copy);
+    close(in_fd);
+    close(out_fd);
+    close(empty_fd);
+    return NULL;
+}
+
+typedef struct {
+    mmap_source_t* source;
+    channel_t* out;
+    enum channel_status status;
+} mmap_source_args;
+
+void* helper_mmap_source(mmap_source_args* myargs) {
+    myargs->status = mmap_source_run(myargs->source, myargs->out);
+    return NULL;
+}
+
+// Returns true if path is currently mapped into this process
+bool file_is_mapped(const char* path) {
+    FILE* maps = fopen("/proc/self/maps", "r");
+    char line[512];
+    bool found = false;
+    while (maps && fgets(line, sizeof(line), maps)) {
+        found |= strstr(line, path) != NULL;
+    }
+    if (maps) {
+        fclose(maps);
+    }
+    return found;
+}
+
+char* test_mmap_source() {
+    print_test_details(__func__, "Testing the zero-copy mmap file source");
+
+    char name[] = "/tmp/mmap_source_XXXXXX";
+    int fd = mkstemp(name);
+    mu_assert("test_mmap_source: mkstemp failed\n", fd >= 0);
+    const size_t lines = 5000;
+    size_t file_size = 0;
+    char* contents = malloc(lines * 32);
+    for (size_t i = 0; i < lines; i++) {
+        file_size += (size_t)sprintf(contents + file_size, "line %zu of the file\n", i * 7919);
+    }
+    mu_assert("test_mmap_source: write failed\n", write(fd, contents, file_size) == (ssize_t)file_size);
+    close(fd);
+
+    // Line-delimited chunks cover the file exactly once, in order, and never split a line
+    mmap_source_args args = {mmap_source_open(name, 1000, '\n'), channel_create(4), GENERIC_ERROR};
+    mu_assert("test_mmap_source: Could not open source\n", args.source != NULL);
+    mu_assert("test_mmap_source: Wrong size\n", mmap_source_size(args.source) == file_size);
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_mmap_source, &args);
+    size_t expected_offset = 0;
+    size_t chunks = 0;
+    file_chunk_t* held = NULL;
+    while (true) {
+        void* data = NULL;
+        mu_assert("test_mmap_source: Receive failed\n", channel_receive(args.out, &data) == SUCCESS);
+        file_chunk_t* chunk = data;
+        mu_assert("test_mmap_source: Chunk out of order\n", chunk->offset == expected_offset);
+        if (chunk->length == 0) {
+            mmap_source_release(chunk);
+            break;
+        }
+        mu_assert("test_mmap_source: Chunk smaller than requested\n", chunk->length >= 1000 || chunk->offset + chunk->length == file_size);
+        mu_assert("test_mmap_source: Chunk splits a line\n", chunk->data[chunk->length - 1] == '\n');
+        mu_assert("test_mmap_source: Chunk contents differ\n", memcmp(chunk->data, contents + chunk->offset, chunk->length) == 0);
+        expected_offset += chunk->length;
+        chunks++;
+        // Hold on to the first chunk to check it keeps the mapping alive
+        if (held == NULL) {
+            held = chunk;
+        } else {
+            mmap_source_release(chunk);
+        }
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_mmap_source: Run failed\n", args.status == SUCCESS);
+    mu_assert("test_mmap_source: Chunks do not cover the file\n", expected_offset == file_size);
+    mu_assert("test_mmap_source: Descriptors were not recycled\n", chunks > MMAP_SOURCE_CHUNKS);
+    mu_assert("test_mmap_source: Unmapped while a chunk is held\n", file_is_mapped(name));
+    mu_assert("test_mmap_source: Held chunk unreadable\n", memcmp(held->data, contents, held->length) == 0);
+    mmap_source_release(held);
+    mu_assert("test_mmap_source: Still mapped after the last release\n", !file_is_mapped(name));
+
+    // A source that is never run is unmapped by close
+    mmap_source_t* source = mmap_source_open(name, 4096, -1);
+    mu_assert("test_mmap_source: Could not reopen source\n", source != NULL && file_is_mapped(name));
+    mmap_source_close(source);
+    mu_assert("test_mmap_source: Close did not unmap\n", !file_is_mapped(name));
+
+    unlink(name);
+    mu_assert("test_mmap_source: Missing file should fail\n", mmap_source_open(name, 4096, -1) == NULL);
+    channel_close(args.out);
+    channel_destroy(args.out);
+    free(contents);
+    return NULL;
+}
+
+// Payload of the messages test_spill_channel spills through a codec
+typedef struct {
+    uint64_t value;
+    uint64_t square;
+} spill_payload_t;
+
+static atomic_size_t spill_live; // payloads currently allocated
+
+static void spill_test_encode(void* value, void* record) {
+    memcpy(record, value, sizeof(spill_payload_t));
+    free(value);
+    atomic_fetch_sub(&spill_live, 1);
+}
+
+static void* spill_test_decode(const void* record) {
+    spill_payload_t* payload = malloc(sizeof(spill_payload_t));
+    memcpy(payload, record, sizeof(spill_payload_t));
+    atomic_fetch_add(&spill_live, 1);
+    return payload;
+}
+
+char* test_spill_channel() {
+    print_test_details(__func__, "Testing disk spill-over for full channels");
+
+    char dir[] = "/tmp/channel_spill_XXXXXX";
+    mu_assert("test_spill_channel: mkdtemp failed\n", mkdtemp(dir) != NULL);
+    size_t size = 8;
+    size_t count = 1000;
+    channel_t* channel = channel_create_spill(size, 100, dir, NULL);
+    mu_assert("test_spill_channel: Could not create channel\n", channel != NULL);
+    mu_assert("test_spill_channel: Zero segment size should fail\n", channel_create_spill(size, 0, dir, NULL) == NULL);
+
+    // Senders never block: the first size messages stay in memory, the rest go to segment files
+    for (size_t i = 1; i <= count; i++) {
+        mu_assert("test_spill_channel: Send failed\n", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_spill_channel: Buffer size is not as expected\n", buffer_current_size(channel->buffer) == count);
+    mu_assert("test_spill_channel: Spilled count is not as expected\n", buffer_spilled(channel->buffer) == count - size);
+    mu_assert("test_spill_channel: Segments should be mapped\n", file_is_mapped(dir));
+    mu_assert("test_spill_channel: Peek is not as expected\n", peek_buffer(channel->buffer, 500) == (void*)501);
+
+    // Room in memory does not let new messages overtake spilled ones
+    void* data = NULL;
+    channel_receive(channel, &data);
+    mu_assert("test_spill_channel: Out of order message\n", data == (void*)1);
+    mu_assert("test_spill_channel: Send failed\n", channel_send(channel, (void*)(count + 1)) == SUCCESS);
+    mu_assert("test_spill_channel: Spilled count is not as expected\n", buffer_spilled(channel->buffer) == count - size + 1);
+
+    // Memory drains first, then the segments, in FIFO order
+    for (size_t i = 2; i <= count + 1; i++) {
+        mu_assert("test_spill_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spill_channel: Out of order message\n", data == (void*)i);
+    }
+    mu_assert("test_spill_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_spill_channel: Drained segments should be deleted\n", !file_is_mapped(dir));
+    mu_assert("test_spill_channel: High-water mark is not as expected\n", channel_high_water(channel) == count);
+
+    // Once drained, messages are kept in memory again
+    mu_assert("test_spill_channel: Send after drain failed\n", channel_send(channel, "Message") == SUCCESS);
+    mu_assert("test_spill_channel: Message should stay in memory\n", buffer_spilled(channel->buffer) == 0);
+    mu_assert("test_spill_channel: Receive after drain failed\n", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_spill_channel: Invalid message\n", string_equal(data, "Message"));
+
+    // A codec moves the payloads to disk as well: spilled messages are freed and rebuilt on receive
+    buffer_spill_codec_t codec = {sizeof(spill_payload_t), spill_test_encode, spill_test_decode};
+    buffer_spill_codec_t partial = {sizeof(spill_payload_t), spill_test_encode, NULL};
+    mu_assert("test_spill_channel: Incomplete codec should fail\n", channel_create_spill(size, 100, dir, &partial) == NULL);
+    channel_t* coded = channel_create_spill(size, 100, dir, &codec);
+    mu_assert("test_spill_channel: Could not create channel\n", coded != NULL);
+    atomic_store(&spill_live, 0);
+    for (uint64_t i = 1; i <= count; i++) {
+        spill_payload_t* payload = malloc(sizeof(spill_payload_t));
+        *payload = (spill_payload_t){i, i * i};
+        atomic_fetch_add(&spill_live, 1);
+        mu_assert("test_spill_channel: Send failed\n", channel_send(coded, payload) == SUCCESS);
+    }
+    mu_assert("test_spill_channel: Only in-memory payloads should be allocated\n", atomic_load(&spill_live) == size);
+    mu_assert("test_spill_channel: Spilled payloads are not peekable\n", peek_buffer(coded->buffer, size) == NULL);
+    for (uint64_t i = 1; i <= count; i++) {
+        mu_assert("test_spill_channel: Receive failed\n", channel_receive(coded, &data) == SUCCESS);
+        spill_payload_t* payload = data;
+        mu_assert("test_spill_channel: Wrong payload\n", payload->value == i && payload->square == i * i);
+        free(payload);
+        atomic_fetch_sub(&spill_live, 1);
+    }
+    mu_assert("test_spill_channel: Payloads leaked\n", atomic_load(&spill_live) == 0);
+    channel_close(coded);
+    channel_destroy(coded);
+
+    // Segments still holding messages are released by destroy
+    for (size_t i = 1; i <= count; i++) {
+        channel_send(channel, (void*)i);
+    }
+    channel_close(channel);
+    mu_assert("test_spill_channel: Destroy failed\n", channel_destroy(channel) == SUCCESS);
+    mu_assert("test_spill_channel: Destroy should delete segments\n", !file_is_mapped(dir));
+    mu_assert("test_spill_channel: Segment files should be unlinked\n", rmdir(dir) == 0);
+    mu_assert("test_spill_channel: Could not create channel\n", (channel = channel_create_spill(0, 100, dir, NULL)) != NULL);
+    mu_assert("test_spill_channel: Send without a spill directory should fail\n", channel_send(channel, "Message") == GENERIC_ERROR);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_shared_channel_snapshot() {
+    print_test_details(__func__, "Testing snapshot and restore of shared channels");
+
+    const size_t count = 3;
+    const size_t capacity = 64;
+    shared_channel_t* channels[3];
+    shared_channel_t* restored[3];
+    uint64_t value[2] = {0, 0};
+    for (size_t i = 0; i < count; i++) {
+        channels[i] = channel_create_shared(NULL, capacity, sizeof(value));
+        restored[i] = channel_create_shared(NULL, capacity, sizeof(value));
+        mu_assert("test_shared_channel_snapshot: Could not create channels\n", channels[i] && restored[i]);
+    }
+    // Channel 0 wraps around its ring, channel 1 is empty, channel 2 is full
+    for (uint64_t n = 0; n < 50; n++) {
+        value[0] = n;
+        shared_channel_send(channels[0], value);
+    }
+    for (size_t n = 0; n < 40; n++) {
+        shared_channel_receive(channels[0], value);
+    }
+    for (uint64_t n = 50; n < 80; n++) {
+        value[0] = n;
+        shared_channel_send(channels[0], value);
+    }
+    for (uint64_t n = 0; n < capacity; n++) {
+        value[0] = 1000 + n;
+        value[1] = n * n;
+        shared_channel_send(channels[2], value);
+    }
+
+    char path[] = "/tmp/channel_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    mu_assert("test_shared_channel_snapshot: mkstemp failed\n", fd >= 0);
+    close(fd);
+    shared_snapshot_stats_t stats;
+    mu_assert("test_shared_channel_snapshot: Snapshot failed\n", shared_channel_snapshot(channels, count, path, &stats) == SUCCESS);
+    mu_assert("test_shared_channel_snapshot: Wrong message count\n", stats.channels == count && stats.messages == 40 + capacity);
+    mu_assert("test_shared_channel_snapshot: Snapshot should leave messages in place\n", shared_channel_non_blocking_send(channels[2], value) == CHANNEL_FULL);
+
+    // Restore rejects mismatched channel lists before touching anything
+    mu_assert("test_shared_channel_snapshot: Wrong channel count should fail\n", shared_channel_restore(restored, 2, path, NULL) == GENERIC_ERROR);
+    shared_channel_t* duplicate[3] = {restored[0], restored[0], restored[2]};
+    mu_assert("test_shared_channel_snapshot: Duplicate channel should fail\n", shared_channel_restore(duplicate, count, path, NULL) == GENERIC_ERROR);
+    mu_assert("test_shared_channel_snapshot: Non-empty channel should fail\n", shared_channel_restore(channels, count, path, NULL) == GENERIC_ERROR);
+    mu_assert("test_shared_channel_snapshot: Failed restore should load nothing\n", shared_channel_non_blocking_receive(restored[0], value) == CHANNEL_EMPTY);
+
+    mu_assert("test_shared_channel_snapshot: Restore failed\n", shared_channel_restore(restored, count, path, &stats) == SUCCESS);
+    mu_assert("test_shared_channel_snapshot: Wrong restored count\n", stats.messages == 40 + capacity);
+    for (uint64_t n = 40; n < 80; n++) {
+        mu_assert("test_shared_channel_snapshot: Receive failed\n", shared_channel_non_blocking_receive(restored[0], value) == SUCCESS);
+        mu_assert("test_shared_channel_snapshot: Out of order message\n", value[0] == n);
+    }
+    mu_assert("test_shared_channel_snapshot: Channel 0 should be drained\n", shared_channel_non_blocking_receive(restored[0], value) == CHANNEL_EMPTY);
+    mu_assert("test_shared_channel_snapshot: Channel 1 should be empty\n", shared_channel_non_blocking_receive(restored[1], value) == CHANNEL_EMPTY);
+    for (uint64_t n = 0; n < capacity; n++) {
+        mu_assert("test_shared_channel_snapshot: Receive failed\n", shared_channel_non_blocking_receive(restored[2], value) == SUCCESS);
+        mu_assert("test_shared_channel_snapshot: Wrong message\n", value[0] == 1000 + n && value[1] == n * n);
+    }
+
+    unlink(path);
+    mu_assert("test_shared_channel_snapshot: Missing snapshot should fail\n", shared_channel_restore(restored, count, path, NULL) == GENERIC_ERROR);
+    for (size_t i = 0; i < count; i++) {
+        shared_channel_close(channels[i]);
+        shared_channel_destroy(channels[i]);
+        shared_channel_close(restored[i]);
+        shared_channel_destroy(restored[i]);
+    }
+    return NULL;
+}
+
+// Replay factory that records the capacity asked for the channel with the largest possible id
+channel_t* helper_trace_factory(uint32_t id, size_t capacity, void* arg) {
+    if (id == UINT32_MAX) {
+        *(size_t*)arg = capacity;
+    }
+    return capacity == TRACE_CAPACITY_UNKNOWN ? channel_create_unbounded(64) : channel_create(capacity);
+}
+
+char* test_trace_replay() {
+    print_test_details(__func__, "Testing traffic capture and replay");
+
+    char path[] = "/tmp/channel_trace_XXXXXX";
+    int fd = mkstemp(path);
+    mu_assert("test_trace_replay: mkstemp failed\n", fd >= 0);
+    close(fd);
+    // Each message gets a producer thread at capture and again in both replays, so keep this small
+    const size_t messages = 50;
+
+    // Capture: a producer thread feeding a size-1 channel, a consumer using receive and select
+    mu_assert("test_trace_replay: trace_start failed\n", trace_start(path) == 0);
+    mu_assert("test_trace_replay: Second trace_start should fail\n", trace_start(path) == -1);
+    channel_t* channel = channel_create(1);
+    channel_t* idle = channel_create(4);
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, channel, "Message", NULL);
+    for (size_t i = 0; i < messages; i++) {
+        pthread_create(&pid, NULL, (void *)helper_send, &args);
+        void* data = NULL;
+        if (i % 2 == 0) {
+            channel_receive(channel, &data);
+        } else {
+            select_t list[2] = {{idle, RECV, NULL, 0}, {channel, RECV, NULL, 0}};
+            size_t index;
+            channel_select(list, 2, &index);
+        }
+        pthread_join(pid, NULL);
+    }
+    void* data = NULL;
+    mu_assert("test_trace_replay: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    channel_close(channel);
+    channel_close(idle);
+    trace_stop();
+
+    // The trace holds one fixed-size record per operation
+    FILE* file = fopen(path, "rb");
+    mu_assert("test_trace_replay: Could not open trace\n", file != NULL);
+    fseek(file, 16, SEEK_SET); // skip the file header
+    trace_event_t event;
+    size_t counts[TRACE_CLOSE + 1] = {0};
+    size_t blocked = 0;
+    while (fread(&event, sizeof(event), 1, file) == 1) {
+        mu_assert("test_trace_replay: Unknown op\n", event.op <= TRACE_CLOSE);
+        counts[event.op]++;
+        blocked += event.blocked;
+        if (event.op == TRACE_SEND || event.op == TRACE_RECV) {
+            mu_assert("test_trace_replay: Wrong channel id\n", event.channel == channel->trace_id);
+            mu_assert("test_trace_replay: Wrong status\n", event.status == SUCCESS);
+        }
+        if (event.op == TRACE_SELECT) {
+            mu_assert("test_trace_replay: Select should record the selected channel\n", event.channel == channel->trace_id);
+        }
+        if (event.op == TRACE_CREATE && event.channel == channel->trace_id) {
+            mu_assert("test_trace_replay: Wrong capacity\n", event.arg == 1);
+        }
+    }
+    fclose(file);
+    mu_assert("test_trace_replay: Wrong create count\n", counts[TRACE_CREATE] == 2);
+    mu_assert("test_trace_replay: Wrong send count\n", counts[TRACE_SEND] == messages);
+    mu_assert("test_trace_replay: Wrong receive count\n", counts[TRACE_RECV] == messages / 2);
+    mu_assert("test_trace_replay: Wrong select count\n", counts[TRACE_SELECT] == messages / 2 && counts[TRACE_SELECT_CASE] == messages);
+    mu_assert("test_trace_replay: Wrong other counts\n", counts[TRACE_NB_RECV] == 1 && counts[TRACE_CLOSE] == 2);
+    mu_assert("test_trace_replay: Receives should have blocked\n", blocked > 0);
+
+    // Replay as fast as possible against the default backend: every operation reproduces its recorded result
+    trace_replay_stats_t stats;
+    mu_assert("test_trace_replay: Replay failed\n", trace_replay(path, 0, NULL, NULL, &stats) == 0);
+    mu_assert("test_trace_replay: Wrong channel count\n", stats.channels == 2);
+    mu_assert("test_trace_replay: Wrong thread count\n", stats.threads == messages + 1);
+    mu_assert("test_trace_replay: Wrong operation count\n", stats.operations == 2 * messages + 3);
+    mu_assert("test_trace_replay: Replay diverged\n", stats.diverged == 0);
+
+    // Replay at the original timing takes about as long as the capture
+    mu_assert("test_trace_replay: Timed replay failed\n", trace_replay(path, 1, NULL, NULL, &stats) == 0);
+    mu_assert("test_trace_replay: Timed replay diverged\n", stats.diverged == 0);
+
+    // Ids are remapped on replay, so a trace recorded after billions of channels still replays
+    file = fopen(path, "wb");
+    mu_assert("test_trace_replay: Could not rewrite trace\n", file != NULL);
+    uint32_t header[4] = {0x45435254, 1, 0, 0};
+    trace_event_t events[] = {
+        {0, 1, UINT32_MAX, 2, TRACE_CREATE, 0, SUCCESS, 0},
+        {1, 1, UINT32_MAX, 0, TRACE_SEND, 0, SUCCESS, 0},
+        {2, 1, UINT32_MAX, 0, TRACE_RECV, 0, SUCCESS, 0},
+        {3, 1, 7, 0, TRACE_NB_RECV, 0, CHANNEL_EMPTY, 0},
+    };
+    mu_assert("test_trace_replay: Could not write trace\n", fwrite(header, sizeof(header), 1, file) == 1 &&
+                                                              fwrite(events, sizeof(events), 1, file) == 1);
+    fclose(file);
+    size_t capacity = 0;
+    mu_assert("test_trace_replay: Replay of large ids failed\n", trace_replay(path, 0, helper_trace_factory, &capacity, &stats) == 0);
+    mu_assert("test_trace_replay: Wrong channel count\n", stats.channels == 2);
+    mu_assert("test_trace_replay: Wrong recorded capacity\n", capacity == 2);
+    mu_assert("test_trace_replay: Wrong operation count\n", stats.operations == 3);
+    mu_assert("test_trace_replay: Replay diverged\n", stats.diverged == 0);
+
+    unlink(path);
+    mu_assert("test_trace_replay: Missing trace should fail\n", trace_replay(path, 0, NULL, NULL, NULL) == -1);
+    channel_destroy(channel);
+    channel_destroy(idle);
+    return NULL;
+}
+
+typedef struct {
+    broadcast_t* broadcast;
+    channel_t* subscriber;
+    size_t messages;
+    size_t received;
+} broadcast_args;
+
+// Sends messages numbered 1..messages to a broadcast channel
+void* helper_broadcast_send(broadcast_args* args) {
+    for (size_t i = 1; i <= args->messages; i++) {
+        if (broadcast_send(args->broadcast, (void*)i) != SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Counts the messages a subscriber receives in order until a NULL message ends the stream
+void* helper_broadcast_receive(broadcast_args* args) {
+    void* data = NULL;
+    while (channel_receive(args->subscriber, &data) == SUCCESS && data != NULL) {
+        if ((size_t)data != args->received + 1) {
+            break;
+        }
+        args->received++;
+    }
+    return NULL;
+}
+
+char* test_broadcast_channel() {
+    print_test_details(__func__, "Testing broadcast channels with per-subscriber cursors");
+
+    broadcast_t* broadcast = broadcast_create(4);
+    mu_assert("test_broadcast_channel: Create failed\n", broadcast != NULL);
+    mu_assert("test_broadcast_channel: Zero capacity should fail\n", broadcast_create(0) == NULL);
+    mu_assert("test_broadcast_channel: Send without subscribers failed\n", broadcast_send(broadcast, (void*)99) == SUCCESS);
+
+    // Every subscriber sees every message; the slowest one gates the sender
+    channel_t* fast = broadcast_subscribe(broadcast);
+    channel_t* slow = broadcast_subscribe(broadcast);
+    mu_assert("test_broadcast_channel: Wrong subscriber count\n", broadcast_subscribers(broadcast) == 2);
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_broadcast_channel: Send failed\n", broadcast_non_blocking_send(broadcast, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_broadcast_channel: Ring should be full\n", broadcast_non_blocking_send(broadcast, (void*)5) == CHANNEL_FULL);
+    void* data = NULL;
+    for (size_t i = 1; i <= 4; i++) {
+        mu_assert("test_broadcast_channel: Receive failed\n", channel_receive(fast, &data) == SUCCESS);
+        mu_assert("test_broadcast_channel: Wrong message\n", (size_t)data == i);
+    }
+    mu_assert("test_broadcast_channel: Fast subscriber should be drained\n", channel_non_blocking_receive(fast, &data) == CHANNEL_EMPTY);
+    mu_assert("test_broadcast_channel: Slow subscriber should still gate\n", broadcast_non_blocking_send(broadcast, (void*)5) == CHANNEL_FULL);
+    mu_assert("test_broadcast_channel: Subscribers are receive-only\n", channel_non_blocking_send(slow, (void*)1) == GENERIC_ERROR);
+    mu_assert("test_broadcast_channel: Receive failed\n", channel_receive(slow, &data) == SUCCESS && (size_t)data == 1);
+    mu_assert("test_broadcast_channel: Send failed\n", broadcast_non_blocking_send(broadcast, (void*)5) == SUCCESS);
+
+    // A late subscriber only sees what is sent after it joined
+    channel_t* late = broadcast_subscribe(broadcast);
+    mu_assert("test_broadcast_channel: Late subscriber should be empty\n", channel_non_blocking_receive(late, &data) == CHANNEL_EMPTY);
+
+    // Leaving releases a sender blocked on the slowest subscriber
+    pthread_t pid;
+    broadcast_args args = {broadcast, NULL, 1, 0};
+    pthread_create(&pid, NULL, (void*)helper_broadcast_send, &args);
+    usleep(10000);
+    mu_assert("test_broadcast_channel: Sender should be blocked\n", channel_non_blocking_receive(late, &data) == CHANNEL_EMPTY);
+    mu_assert("test_broadcast_channel: Unsubscribe failed\n", broadcast_unsubscribe(broadcast, slow) == SUCCESS);
+    mu_assert("test_broadcast_channel: Second unsubscribe should fail\n", broadcast_unsubscribe(broadcast, slow) == GENERIC_ERROR);
+    mu_assert("test_broadcast_channel: Unsubscribed channel should be closed\n", channel_receive(slow, &data) == CLOSED_ERROR);
+    channel_destroy(slow);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast_channel: Wrong subscriber count\n", broadcast_subscribers(broadcast) == 2);
+    mu_assert("test_broadcast_channel: Receive failed\n", channel_receive(fast, &data) == SUCCESS && (size_t)data == 5);
+    mu_assert("test_broadcast_channel: Receive failed\n", channel_receive(fast, &data) == SUCCESS && (size_t)data == 1);
+    mu_assert("test_broadcast_channel: Receive failed\n", channel_receive(late, &data) == SUCCESS && (size_t)data == 1);
+
+    // Subscribers work as select cases, including waking a blocked select
+    args.messages = 1;
+    pthread_create(&pid, NULL, (void*)helper_broadcast_send, &args);
+    select_t list[2] = {{late, RECV, NULL, 0}, {fast, RECV, NULL, 0}};
+    size_t index = 2;
+    mu_assert("test_broadcast_channel: Select failed\n", channel_select(list, 2, &index) == SUCCESS);
+    mu_assert("test_broadcast_channel: Wrong select result\n", index == 0 && (size_t)list[0].data == 1);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast_channel: Select should find the other subscriber\n", channel_select(list, 2, &index) == SUCCESS && index == 1);
+
+    mu_assert("test_broadcast_channel: Unsubscribe failed\n", broadcast_unsubscribe(broadcast, late) == SUCCESS);
+    mu_assert("test_broadcast_channel: Unsubscribe failed\n", broadcast_unsubscribe(broadcast, fast) == SUCCESS);
+    channel_destroy(late);
+    channel_destroy(fast);
+
+    // Concurrent subscribers each receive the whole stream in order through a small ring, which wraps it hundreds
+    // of times
+    broadcast_args readers[4];
+    pthread_t reader_pids[4];
+    for (size_t i = 0; i < 4; i++) {
+        readers[i] = (broadcast_args){broadcast, broadcast_subscribe(broadcast), 0, 0};
+        pthread_create(&reader_pids[i], NULL, (void*)helper_broadcast_receive, &readers[i]);
+    }
+    args.messages = 2000;
+    helper_broadcast_send(&args);
+    mu_assert("test_broadcast_channel: Send failed\n", broadcast_send(broadcast, NULL) == SUCCESS);
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(reader_pids[i], NULL);
+        mu_assert("test_broadcast_channel: Reader missed messages\n", readers[i].received == args.messages);
+    }
+
+    // Closing closes every subscriber
+    mu_assert("test_broadcast_channel: Close failed\n", broadcast_close(broadcast) == SUCCESS);
+    mu_assert("test_broadcast_channel: Second close should fail\n", broadcast_close(broadcast) == CLOSED_ERROR);
+    mu_assert("test_broadcast_channel: Subscriber should be closed\n", channel_receive(readers[0].subscriber, &data) == CLOSED_ERROR);
+    mu_assert("test_broadcast_channel: Send after close should fail\n", broadcast_send(broadcast, (void*)1) == CLOSED_ERROR);
+    mu_assert("test_broadcast_channel: Subscribe after close should fail\n", broadcast_subscribe(broadcast) == NULL);
+    mu_assert("test_broadcast_channel: Destroy failed\n", broadcast_destroy(broadcast) == SUCCESS);
+    return NULL;
+}
+
+static atomic_size_t conflate_released;
+
+// Conflation key of the values used by test_conflating_channel: the low 16 bits
+static uint64_t conflate_test_key(void* data) {
+    return (uintptr_t)data & 0xffff;
+}
+
+static void conflate_test_release(void* data) {
+    (void)data;
+    atomic_fetch_add(&conflate_released, 1);
+}
+
+char* test_conflating_channel() {
+    print_test_details(__func__, "Testing latest-value-wins conflating channels");
+
+    // Whole-channel conflation keeps only the latest message
+    channel_t* channel = channel_create_conflating(NULL, NULL);
+    mu_assert("test_conflating_channel: Create failed\n", channel != NULL);
+    for (uintptr_t i = 1; i <= 3; i++) {
+        mu_assert("test_conflating_channel: Send should never be full\n", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    void* data = NULL;
+    mu_assert("test_conflating_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 3);
+    mu_assert("test_conflating_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_conflating_channel: Wrong conflated count\n", channel_conflated(channel) == 2);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Keyed conflation keeps the latest value of each key, in the order the keys became pending
+    atomic_store(&conflate_released, 0);
+    channel = channel_create_conflating(conflate_test_key, conflate_test_release);
+    const uintptr_t keys = 1000;
+    for (uintptr_t round = 0; round < 3; round++) {
+        for (uintptr_t key = 0; key < keys; key++) {
+            mu_assert("test_conflating_channel: Send failed\n", channel_send(channel, (void*)((round << 16) | key)) == SUCCESS);
+        }
+    }
+    mu_assert("test_conflating_channel: Wrong replaced count\n", channel_conflated(channel) == 2 * keys);
+    mu_assert("test_conflating_channel: Replaced values should be released\n", atomic_load(&conflate_released) == 2 * keys);
+    for (uintptr_t key = 0; key < keys / 2; key++) {
+        mu_assert("test_conflating_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_conflating_channel: Wrong value\n", (uintptr_t)data == ((2 << 16) | key));
+    }
+    // Received keys become pending again at the back; keys still pending are replaced in place
+    for (uintptr_t key = 0; key < keys; key++) {
+        channel_send(channel, (void*)((3 << 16) | key));
+    }
+    for (uintptr_t i = 0; i < keys; i++) {
+        uintptr_t key = (i + keys / 2) % keys;
+        mu_assert("test_conflating_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_conflating_channel: Wrong order after refill\n", (uintptr_t)data == ((3 << 16) | key));
+    }
+    mu_assert("test_conflating_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // Select sends are always ready; destroy releases what is still pending
+    select_t list[1] = {{channel, SEND, (void*)7, 0}};
+    size_t index;
+    mu_assert("test_conflating_channel: Select failed\n", channel_select(list, 1, &index) == SUCCESS);
+    mu_assert("test_conflating_channel: Select failed\n", channel_select(list, 1, &index) == SUCCESS);
+    size_t released = atomic_load(&conflate_released);
+    channel_close(channel);
+    channel_destroy(channel);
+    mu_assert("test_conflating_channel: Destroy should release pending values\n", atomic_load(&conflate_released) == released + 1);
+
+    // Routers on conflating channels still converge to the right distances (the "conflate" benchmark runs the
+    // big graph, which is too slow for the sanitizer and valgrind runs of this test)
+    mu_assert("test_conflating_channel: Routers processed no vectors\n", run_stress_routers(1, 1, "topology.txt", true, NULL) > 0);
+    return NULL;
+}
+
+static atomic_size_t overflow_released;
+
+static void overflow_test_release(void* data) {
+    (void)data;
+    atomic_fetch_add(&overflow_released, 1);
+}
+
+char* test_overflow_policies() {
+    print_test_details(__func__, "Testing drop-newest and drop-oldest overflow policies");
+
+    // Drop-newest fails fast and keeps what is buffered
+    channel_t* channel = channel_create(2);
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_DROP_NEWEST, NULL);
+    mu_assert("test_overflow_policies: Send failed\n", channel_send(channel, (void*)1) == SUCCESS);
+    mu_assert("test_overflow_policies: Send failed\n", channel_send(channel, (void*)2) == SUCCESS);
+    mu_assert("test_overflow_policies: Blocking send should fail fast\n", channel_send(channel, (void*)3) == CHANNEL_FULL);
+    mu_assert("test_overflow_policies: Non-blocking send should fail\n", channel_non_blocking_send(channel, (void*)4) == CHANNEL_FULL);
+    select_t list[1] = {{channel, SEND, (void*)5, 0}};
+    size_t index = 1;
+    mu_assert("test_overflow_policies: Select send should fail fast\n", channel_select(list, 1, &index) == CHANNEL_FULL && index == 0);
+    mu_assert("test_overflow_policies: Wrong drop count\n", channel_dropped(channel) == 3);
+    void* data = NULL;
+    mu_assert("test_overflow_policies: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 1);
+    mu_assert("test_overflow_policies: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 2);
+
+    // Drop-oldest turns the buffer into a lossy ring holding the newest messages
+    atomic_store(&overflow_released, 0);
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_DROP_OLDEST, overflow_test_release);
+    for (uintptr_t i = 1; i <= 5; i++) {
+        mu_assert("test_overflow_policies: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_overflow_policies: Non-blocking send failed\n", channel_non_blocking_send(channel, (void*)6) == SUCCESS);
+    list[0].data = (void*)7;
+    mu_assert("test_overflow_policies: Select send failed\n", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    mu_assert("test_overflow_policies: Wrong drop count\n", channel_dropped(channel) == 3 + 5);
+    mu_assert("test_overflow_policies: Overwritten messages should be released\n", atomic_load(&overflow_released) == 5);
+    mu_assert("test_overflow_policies: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 6);
+    mu_assert("test_overflow_policies: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 7);
+    mu_assert("test_overflow_policies: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // A sender already waiting on a full channel sheds its message once the channel turns lossy
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_BLOCK, NULL);
+    channel_send(channel, (void*)1);
+    channel_send(channel, (void*)2);
+    pthread_t pid;
+    send_args args;
+    init_object_for_send_api(&args, channel, "Message", NULL);
+    pthread_create(&pid, NULL, (void*)helper_send, &args);
+    usleep(10000);
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_DROP_NEWEST, NULL);
+    pthread_join(pid, NULL);
+    mu_assert("test_overflow_policies: Waiting sender should fail fast\n", args.out == CHANNEL_FULL);
+    mu_assert("test_overflow_policies: Wrong drop count\n", channel_dropped(channel) == 9);
+
+    // Unbounded channels are never full, so nothing is ever shed
+    channel_t* unbounded = channel_create_unbounded(4);
+    channel_set_overflow(unbounded, CHANNEL_OVERFLOW_DROP_OLDEST, NULL);
+    for (uintptr_t i = 0; i < 100; i++) {
+        channel_send(unbounded, (void*)i);
+    }
+    mu_assert("test_overflow_policies: Unbounded channel should not drop\n", channel_dropped(unbounded) == 0);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    channel_close(unbounded);
+    channel_destroy(unbounded);
+    return NULL;
+}
+
+// Remembers what the CoDel controller dropped
+typedef struct {
+    size_t count;
+    uintptr_t first;
+    uint64_t first_sojourn;
+} codel_drops;
+
+static void codel_test_drop(void* data, uint64_t sojourn_ns, void* arg) {
+    codel_drops* drops = arg;
+    if (drops->count++ == 0) {
+        drops->first = (uintptr_t)data;
+        drops->first_sojourn = sojourn_ns;
+    }
+}
+
+char* test_codel_channel() {
+    print_test_details(__func__, "Testing CoDel queue management on a backlogged channel");
+
+    channel_t* channel = channel_create(100);
+    codel_stats_t stats;
+    mu_assert("test_codel_channel: Stats without a controller should fail\n", channel_codel_stats(channel, &stats) == GENERIC_ERROR);
+    codel_drops drops = {0, 0, 0};
+    mu_assert("test_codel_channel: Enabling CoDel failed\n", channel_set_codel(channel, 1000000, 5000000, codel_test_drop, &drops) == SUCCESS);
+    for (uintptr_t i = 1; i <= 50; i++) {
+        mu_assert("test_codel_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+
+    // The first stale message only starts the interval
+    usleep(2000);
+    void* data = NULL;
+    mu_assert("test_codel_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 1);
+    mu_assert("test_codel_channel: Nothing should be dropped yet\n", channel_dropped(channel) == 0);
+
+    // The whole interval stayed above target: every message older than twice the target is dropped, except the last
+    usleep(6000);
+    select_t list[1] = {{channel, RECV, NULL, 0}};
+    size_t index = 1;
+    mu_assert("test_codel_channel: Select receive failed\n", channel_select(list, 1, &index) == SUCCESS && (uintptr_t)list[0].data == 50);
+    mu_assert("test_codel_channel: Wrong drop count\n", channel_dropped(channel) == 48 && drops.count == 48);
+    mu_assert("test_codel_channel: Wrong dropped message\n", drops.first == 2 && drops.first_sojourn >= 2000000);
+    mu_assert("test_codel_channel: Stats failed\n", channel_codel_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_codel_channel: Controller should be overloaded\n", stats.overloaded && stats.dropped == 48 && stats.delivered == 2);
+    mu_assert("test_codel_channel: Wrong sojourn time\n", stats.max_sojourn_ns >= 8000000);
+
+    // Fresh messages are under the drop threshold and get through
+    channel_send(channel, (void*)51);
+    mu_assert("test_codel_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 51);
+
+    // An interval that got below target ends the overload; a single stale message is never dropped anyway
+    channel_send(channel, (void*)52);
+    usleep(10000);
+    mu_assert("test_codel_channel: Receive failed\n", channel_non_blocking_receive(channel, &data) == SUCCESS && (uintptr_t)data == 52);
+    channel_codel_stats(channel, &stats);
+    mu_assert("test_codel_channel: Controller should not be overloaded\n", !stats.overloaded && stats.dropped == 48);
+
+    // Turning it off; only ring channels can be timestamped
+    mu_assert("test_codel_channel: Disabling CoDel failed\n", channel_set_codel(channel, 0, 0, NULL, NULL) == SUCCESS);
+    mu_assert("test_codel_channel: Stats without a controller should fail\n", channel_codel_stats(channel, &stats) == GENERIC_ERROR);
+    channel_t* unbounded = channel_create_unbounded(4);
+    mu_assert("test_codel_channel: Unbounded channel should be rejected\n", channel_set_codel(unbounded, 1000000, 5000000, NULL, NULL) == GENERIC_ERROR);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    channel_close(unbounded);
+    channel_destroy(unbounded);
+    return NULL;
+}
+
+char* test_priority_channel() {
+    print_test_details(__func__, "Testing priority lanes within a single channel");
+
+    channel_t* channel = channel_create_priority(8, 3);
+    mu_assert("test_priority_channel: Too many lanes should fail\n", channel_create_priority(8, BUFFER_PRIORITY_MAX_LANES + 1) == NULL);
+    mu_assert("test_priority_channel: Unknown lane should fail\n", channel_send_priority(channel, (void*)1, 3) == GENERIC_ERROR);
+
+    // Control messages overtake the bulk backlog; each lane stays FIFO
+    for (uintptr_t i = 1; i <= 4; i++) {
+        mu_assert("test_priority_channel: Send failed\n", channel_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_priority_channel: Send failed\n", channel_send_priority(channel, (void*)11, 1) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed\n", channel_send_priority(channel, (void*)21, 2) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed\n", channel_non_blocking_send_priority(channel, (void*)12, 1) == SUCCESS);
+    mu_assert("test_priority_channel: Send failed\n", channel_send_priority(channel, (void*)5, 0) == SUCCESS);
+    mu_assert("test_priority_channel: Lanes share the capacity\n", channel_non_blocking_send_priority(channel, (void*)22, 2) == CHANNEL_FULL);
+    uintptr_t expected[] = {21, 11, 12, 1, 2, 3, 4, 5};
+    void* data = NULL;
+    mu_assert("test_priority_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == expected[0]);
+    select_t list[1] = {{channel, RECV, NULL, 0}};
+    size_t index = 1;
+    mu_assert("test_priority_channel: Select receive failed\n", channel_select(list, 1, &index) == SUCCESS && (uintptr_t)list[0].data == expected[1]);
+    for (size_t i = 2; i < 8; i++) {
+        mu_assert("test_priority_channel: Wrong order\n", channel_non_blocking_receive(channel, &data) == SUCCESS && (uintptr_t)data == expected[i]);
+    }
+    mu_assert("test_priority_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // A blocked receiver is woken by a priority send
+    pthread_t pid;
+    receive_args receiver;
+    init_object_for_receive_api(&receiver, channel, NULL);
+    pthread_create(&pid, NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    channel_send_priority(channel, (void*)23, 2);
+    pthread_join(pid, NULL);
+    mu_assert("test_priority_channel: Blocked receive failed\n", receiver.out == SUCCESS && (uintptr_t)receiver.data == 23);
+
+    // A sender blocked on the full channel is released by close
+    for (uintptr_t i = 1; i <= 8; i++) {
+        channel_send_priority(channel, (void*)i, i % 3);
+    }
+    send_args sender;
+    init_object_for_send_api(&sender, channel, "Message", NULL);
+    pthread_create(&pid, NULL, (void*)helper_send, &sender);
+    usleep(10000);
+    channel_close(channel);
+    pthread_join(pid, NULL);
+    mu_assert("test_priority_channel: Blocked send should see the close\n", sender.out == CLOSED_ERROR);
+
+    // Other channels only have priority 0
+    channel_t* plain = channel_create(2);
+    mu_assert("test_priority_channel: Plain channel has no lane 1\n", channel_send_priority(plain, (void*)1, 1) == GENERIC_ERROR);
+    mu_assert("test_priority_channel: Plain channel send failed\n", channel_send_priority(plain, (void*)1, 0) == SUCCESS);
+
+    channel_destroy(channel);
+    channel_close(plain);
+    channel_destroy(plain);
+    return NULL;
+}
+
+// Waits for the message with the key passed in data on a keyed channel
+void* helper_receive_matching(receive_args* args) {
+    args->out = channel_receive_matching(args->channel, (uint64_t)(uintptr_t)args->data, &args->data);
+    return NULL;
+}
+
+char* test_keyed_channel() {
+    print_test_details(__func__, "Testing selective receive through a per-key index");
+
+    channel_t* channel = channel_create_keyed(8);
+    uintptr_t keys[] = {1, 2, 1, 3, 2};
+    for (uintptr_t i = 0; i < 5; i++) {
+        mu_assert("test_keyed_channel: Send failed\n", channel_send_keyed(channel, (void*)(i + 1), keys[i]) == SUCCESS);
+    }
+    void* data = NULL;
+    mu_assert("test_keyed_channel: Matching receive failed\n", channel_receive_matching(channel, 2, &data) == SUCCESS && (uintptr_t)data == 2);
+    mu_assert("test_keyed_channel: Matching receive failed\n", channel_non_blocking_receive_matching(channel, 3, &data) == SUCCESS && (uintptr_t)data == 4);
+    mu_assert("test_keyed_channel: Unknown key should be empty\n", channel_non_blocking_receive_matching(channel, 4, &data) == CHANNEL_EMPTY);
+    // The rest is still in FIFO order
+    uintptr_t expected[] = {1, 3, 5};
+    for (size_t i = 0; i < 3; i++) {
+        mu_assert("test_keyed_channel: Wrong order\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == expected[i]);
+    }
+
+    // Each key stays FIFO while keys are taken out in any order
+    for (uintptr_t round = 0; round < 100; round++) {
+        for (uintptr_t i = 0; i < 8; i++) {
+            mu_assert("test_keyed_channel: Send failed\n", channel_non_blocking_send_keyed(channel, (void*)(round * 8 + i), (i * 5 + round) % 3) == SUCCESS);
+        }
+        mu_assert("test_keyed_channel: Channel should be full\n", channel_non_blocking_send_keyed(channel, NULL, 0) == CHANNEL_FULL);
+        size_t received = 0;
+        for (uint64_t key = 3; key-- > 0;) {
+            uintptr_t previous = UINTPTR_MAX;
+            while (channel_non_blocking_receive_matching(channel, key, &data) == SUCCESS) {
+                mu_assert("test_keyed_channel: Key out of order\n", previous == UINTPTR_MAX || (uintptr_t)data > previous);
+                mu_assert("test_keyed_channel: Wrong key\n", ((uintptr_t)data % 8 * 5 + round) % 3 == key);
+                previous = (uintptr_t)data;
+                received++;
+            }
+        }
+        mu_assert("test_keyed_channel: Messages lost\n", received == 8);
+    }
+
+    // Blocked receivers each get the message with their key, whatever the arrival order
+    pthread_t pids[2];
+    receive_args receivers[2];
+    for (size_t i = 0; i < 2; i++) {
+        init_object_for_receive_api(&receivers[i], channel, NULL);
+        receivers[i].data = (void*)(10 * (i + 1));
+        pthread_create(&pids[i], NULL, (void*)helper_receive_matching, &receivers[i]);
+    }
+    usleep(10000);
+    channel_send_keyed(channel, (void*)200, 20);
+    channel_send_keyed(channel, (void*)100, 10);
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(pids[i], NULL);
+        mu_assert("test_keyed_channel: Blocked matching receive failed\n", receivers[i].out == SUCCESS && (uintptr_t)receivers[i].data == 100 * (i + 1));
+    }
+
+    // Close releases matching receivers
+    init_object_for_receive_api(&receivers[0], channel, NULL);
+    receivers[0].data = (void*)7;
+    pthread_create(&pids[0], NULL, (void*)helper_receive_matching, &receivers[0]);
+    usleep(10000);
+    channel_close(channel);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_keyed_channel: Matching receive should see the close\n", receivers[0].out == CLOSED_ERROR);
+
+    // Only keyed channels take keys
+    channel_t* plain = channel_create(2);
+    mu_assert("test_keyed_channel: Plain channel has no keys\n", channel_send_keyed(plain, NULL, 1) == GENERIC_ERROR);
+    mu_assert("test_keyed_channel: Plain channel has no keys\n", channel_non_blocking_receive_matching(plain, 1, &data) == GENERIC_ERROR);
+
+    channel_destroy(channel);
+    channel_close(plain);
+    channel_destroy(plain);
+    return NULL;
+}
+
+// Sends 1000 messages tagged with the producer number passed in data
+void* helper_sharded_send(send_args* args) {
+    uintptr_t producer = (uintptr_t)args->data;
+    args->out = SUCCESS;
+    for (uintptr_t i = 0; i < 1000 && args->out == SUCCESS; i++) {
+        args->out = channel_send(args->channel, (void*)(producer << 16 | i));
+    }
+    return NULL;
+}
+
+char* test_sharded_channel() {
+    print_test_details(__func__, "Testing per-producer order across the shards of a relaxed channel");
+
+    mu_assert("test_sharded_channel: Relaxed order must be requested\n", channel_create_sharded(4, 4, 0) == NULL);
+    mu_assert("test_sharded_channel: Too many shards\n", channel_create_sharded(4, CHANNEL_MAX_SHARDS + 1, CHANNEL_RELAXED_ORDER) == NULL);
+    channel_t* channel = channel_create_sharded(4, 0, CHANNEL_RELAXED_ORDER);
+    mu_assert("test_sharded_channel: Default shard count\n", channel != NULL && channel_shard_count(channel) >= 1);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // Small shards make producers block, yet each producer's messages arrive in order
+    channel = channel_create_sharded(4, 4, CHANNEL_RELAXED_ORDER);
+    mu_assert("test_sharded_channel: Shard count\n", channel_shard_count(channel) == 4);
+    pthread_t pids[4];
+    send_args producers[4];
+    for (uintptr_t i = 0; i < 4; i++) {
+        init_object_for_send_api(&producers[i], channel, (char*)(i + 1), NULL);
+        pthread_create(&pids[i], NULL, (void*)helper_sharded_send, &producers[i]);
+    }
+    uintptr_t next[5] = {0};
+    void* data = NULL;
+    for (size_t i = 0; i < 4000; i++) {
+        mu_assert("test_sharded_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        uintptr_t producer = (uintptr_t)data >> 16;
+        mu_assert("test_sharded_channel: Unknown producer\n", producer >= 1 && producer <= 4);
+        mu_assert("test_sharded_channel: Producer out of order\n", ((uintptr_t)data & 0xffff) == next[producer]);
+        next[producer]++;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pids[i], NULL);
+        mu_assert("test_sharded_channel: Send failed\n", producers[i].out == SUCCESS);
+    }
+    mu_assert("test_sharded_channel: Channel should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // A blocked receiver wakes up for a message on any shard
+    receive_args receiver;
+    init_object_for_receive_api(&receiver, channel, NULL);
+    pthread_create(&pids[0], NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    mu_assert("test_sharded_channel: Send failed\n", channel_non_blocking_send(channel, "Message") == SUCCESS);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_sharded_channel: Blocked receive failed\n", receiver.out == SUCCESS && string_equal(receiver.data, "Message"));
+
+    // So does a select
+    select_t list[1] = {{channel, RECV, NULL, -1}};
+    select_args selector = {list, 1, NULL, GENERIC_ERROR, 1};
+    pthread_create(&pids[0], NULL, (void*)helper_select, &selector);
+    usleep(10000);
+    mu_assert("test_sharded_channel: Send failed\n", channel_send(channel, "Select") == SUCCESS);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_sharded_channel: Select failed\n", selector.out == SUCCESS && selector.index == 0 && string_equal(list[0].data, "Select"));
+
+    // Close releases blocked receivers
+    init_object_for_receive_api(&receiver, channel, NULL);
+    pthread_create(&pids[0], NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    channel_close(channel);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_sharded_channel: Receive should see the close\n", receiver.out == CLOSED_ERROR);
+    mu_assert("test_sharded_channel: Send should see the close\n", channel_send(channel, "Message") == CLOSED_ERROR);
+
+    channel_destroy(channel);
+    return NULL;
+}
+
+// Message of a mailbox channel: the link comes first, so the received mailbox_node_t* is the message
+typedef struct {
+    mailbox_node_t node;
+    uintptr_t producer;
+    uintptr_t sequence;
+} mailbox_message_t;
+
+typedef struct {
+    channel_t* channel;
+    mailbox_message_t* messages;
+    size_t count;
+    channel_t* reply;
+} mailbox_args;
+
+void* helper_mailbox_send(mailbox_args* args) {
+    for (size_t i = 0; i < args->count; i++) {
+        channel_send(args->channel, &args->messages[i].node);
+    }
+    return NULL;
+}
+
+void* helper_mailbox_echo(mailbox_args* args) {
+    void* data = NULL;
+    for (size_t i = 0; i < args->count; i++) {
+        if (channel_receive(args->channel, &data) != SUCCESS || channel_send(args->reply, data) != SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+char* test_mailbox_channel() {
+    print_test_details(__func__, "Testing the intrusive MPSC mailbox channel");
+
+    channel_t* channel = channel_create_mailbox();
+    void* data = NULL;
+    mu_assert("test_mailbox_channel: Should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_mailbox_channel: Messages need a link\n", channel_send(channel, NULL) == GENERIC_ERROR);
+
+    // Concurrent producers never block, and each one's messages arrive in order
+    mailbox_message_t* messages = malloc(4 * 1000 * sizeof(mailbox_message_t));
+    pthread_t pids[4];
+    mailbox_args producers[4];
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 1000; j++) {
+            messages[i * 1000 + j].producer = i;
+            messages[i * 1000 + j].sequence = j;
+        }
+        producers[i] = (mailbox_args){channel, messages + i * 1000, 1000};
+        pthread_create(&pids[i], NULL, (void*)helper_mailbox_send, &producers[i]);
+    }
+    uintptr_t next[4] = {0};
+    for (size_t i = 0; i < 4000; i++) {
+        mu_assert("test_mailbox_channel: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mailbox_message_t* message = data;
+        mu_assert("test_mailbox_channel: Producer out of order\n", message->sequence == next[message->producer]);
+        next[message->producer]++;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pids[i], NULL);
+    }
+    mu_assert("test_mailbox_channel: Should be drained\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // Ping-pong between two mailboxes parks each consumer on almost every message, so a push that misses the
+    // consumer registering as a sleeper (a lost wakeup) hangs here
+    channel_t* pong = channel_create_mailbox();
+    mailbox_args echo = {channel, NULL, 2000, pong};
+    pthread_create(&pids[0], NULL, (void*)helper_mailbox_echo, &echo);
+    for (size_t i = 0; i < 2000; i++) {
+        mu_assert("test_mailbox_channel: Ping failed\n", channel_send(channel, &messages[i].node) == SUCCESS);
+        mu_assert("test_mailbox_channel: Pong failed\n", channel_receive(pong, &data) == SUCCESS);
+        mu_assert("test_mailbox_channel: Pong mismatch\n", data == &messages[i]);
+    }
+    pthread_join(pids[0], NULL);
+    channel_close(pong);
+    channel_destroy(pong);
+
+    // A parked consumer wakes up for the next message
+    receive_args receiver;
+    init_object_for_receive_api(&receiver, channel, NULL);
+    pthread_create(&pids[0], NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    mu_assert("test_mailbox_channel: Send failed\n", channel_non_blocking_send(channel, &messages[0].node) == SUCCESS);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_mailbox_channel: Parked receive failed\n", receiver.out == SUCCESS && receiver.data == &messages[0]);
+
+    // So does a select, next to a regular channel
+    channel_t* other = channel_create(1);
+    select_t list[2] = {{other, RECV, NULL, -1}, {channel, RECV, NULL, -1}};
+    select_args selector = {list, 2, NULL, GENERIC_ERROR, 0};
+    pthread_create(&pids[0], NULL, (void*)helper_select, &selector);
+    usleep(10000);
+    mu_assert("test_mailbox_channel: Send failed\n", channel_send(channel, &messages[1].node) == SUCCESS);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_mailbox_channel: Select failed\n", selector.out == SUCCESS && selector.index == 1 && list[1].data == &messages[1]);
+
+    // Close releases the parked consumer and refuses further sends
+    init_object_for_receive_api(&receiver, channel, NULL);
+    pthread_create(&pids[0], NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    channel_close(channel);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_mailbox_channel: Receive should see the close\n", receiver.out == CLOSED_ERROR);
+    mu_assert("test_mailbox_channel: Send should see the close\n", channel_send(channel, &messages[2].node) == CLOSED_ERROR);
+
+    channel_destroy(channel);
+    channel_close(other);
+    channel_destroy(other);
+    free(messages);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    uintptr_t producer;
+    size_t count;
+    enum channel_status out;
+} spsc_args;
+
+// Sends count messages tagged with the producer number
+void* helper_spsc_send(spsc_args* args) {
+    args->out = SUCCESS;
+    for (uintptr_t i = 0; i < args->count && args->out == SUCCESS; i++) {
+        args->out = channel_send(args->channel, (void*)(args->producer << 24 | i));
+    }
+    return NULL;
+}
+
+// Closes the channel once the consumer has had time to park
+void* helper_spsc_close(channel_t* channel) {
+    usleep(10000);
+    channel_close(channel);
+    return NULL;
+}
+
+char* test_spsc_detection() {
+    print_test_details(__func__, "Testing the switch to and from the lock-free single-producer single-consumer path");
+
+    // One producer and one consumer get promoted, and messages stay in order across the switch
+    // A few streaks per phase are enough to switch paths; larger counts only slow the sanitizer runs down
+    const size_t count = 4 * CHANNEL_SPSC_STREAK;
+    channel_t* channel = channel_create(8);
+    mu_assert("test_spsc_detection: Should start locked\n", !channel_spsc_active(channel));
+    pthread_t pids[2];
+    spsc_args producers[2] = {{channel, 1, count, GENERIC_ERROR}, {channel, 2, count, GENERIC_ERROR}};
+    pthread_create(&pids[0], NULL, (void*)helper_spsc_send, &producers[0]);
+    void* data = NULL;
+    for (uintptr_t i = 0; i < count; i++) {
+        mu_assert("test_spsc_detection: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spsc_detection: Out of order\n", (uintptr_t)data == (1 << 24 | i));
+    }
+    pthread_join(pids[0], NULL);
+    mu_assert("test_spsc_detection: Send failed\n", producers[0].out == SUCCESS);
+    mu_assert("test_spsc_detection: Should be promoted\n", channel_spsc_active(channel));
+    mu_assert("test_spsc_detection: Should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    // A second producer demotes the channel
+    mu_assert("test_spsc_detection: Send failed\n", channel_send(channel, (void*)7) == SUCCESS);
+    mu_assert("test_spsc_detection: Should be demoted\n", !channel_spsc_active(channel));
+    mu_assert("test_spsc_detection: Receive failed\n", channel_receive(channel, &data) == SUCCESS && (uintptr_t)data == 7);
+
+    // A second producer joining mid-stream loses nothing and keeps each producer's order
+    producers[0].out = GENERIC_ERROR;
+    pthread_create(&pids[0], NULL, (void*)helper_spsc_send, &producers[0]);
+    uintptr_t next[3] = {0};
+    for (size_t i = 0; i < 2 * count; i++) {
+        if (i == count / 2) {
+            pthread_create(&pids[1], NULL, (void*)helper_spsc_send, &producers[1]);
+        }
+        mu_assert("test_spsc_detection: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+        uintptr_t producer = (uintptr_t)data >> 24;
+        mu_assert("test_spsc_detection: Unknown producer\n", producer == 1 || producer == 2);
+        mu_assert("test_spsc_detection: Producer out of order\n", ((uintptr_t)data & 0xffffff) == next[producer]);
+        next[producer]++;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(pids[i], NULL);
+        mu_assert("test_spsc_detection: Send failed\n", producers[i].out == SUCCESS);
+    }
+
+    // Once promoted again, close releases a consumer parked on the lock-free path
+    pthread_create(&pids[0], NULL, (void*)helper_spsc_send, &producers[0]);
+    for (uintptr_t i = 0; i < count; i++) {
+        mu_assert("test_spsc_detection: Receive failed\n", channel_receive(channel, &data) == SUCCESS);
+    }
+    pthread_join(pids[0], NULL);
+    mu_assert("test_spsc_detection: Should be promoted again\n", channel_spsc_active(channel));
+    pthread_create(&pids[0], NULL, (void*)helper_spsc_close, channel);
+    mu_assert("test_spsc_detection: Receive should see the close\n", channel_receive(channel, &data) == CLOSED_ERROR);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_spsc_detection: Close should demote\n", !channel_spsc_active(channel));
+    channel_destroy(channel);
+    return NULL;
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t received;
+    uintptr_t sum;
+    bool ordered;
+} attr_receive_args;
+
+// Receives until the channel closes, checking that each producer's messages come in order
+void* helper_attr_receive(attr_receive_args* args) {
+    uintptr_t next[5] = {0};
+    void* data = NULL;
+    while (channel_receive(args->channel, &data) == SUCCESS) {
+        uintptr_t producer = (uintptr_t)data >> 16;
+        uintptr_t sequence = (uintptr_t)data & 0xffff;
+        if (producer < 1 || producer > 4 || sequence < next[producer]) {
+            args->ordered = false;
+        } else {
+            next[producer] = sequence + 1;
+        }
+        args->received++;
+        args->sum += sequence;
+    }
+    return NULL;
+}
+
+char* test_channel_attr() {
+    print_test_details(__func__, "Testing channels configured through channel_create_ex");
+
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    mu_assert("test_channel_attr: Wrong defaults\n", attr.backend == CHANNEL_BACKEND_RING && attr.wait == CHANNEL_WAIT_BLOCK &&
+              attr.wake == CHANNEL_WAKE_ONE && attr.numa_node == CHANNEL_NODE_ANY && !attr.stats);
+    attr.backend = CHANNEL_BACKEND_MPMC;
+    mu_assert("test_channel_attr: MPMC needs a capacity\n", channel_create_ex(&attr) == NULL);
+    attr.capacity = 4;
+    attr.numa_node = 0;
+    mu_assert("test_channel_attr: Only rings are placed\n", channel_create_ex(&attr) == NULL);
+    attr.numa_node = CHANNEL_NODE_ANY;
+    attr.backend = CHANNEL_BACKEND_SHARDED;
+    mu_assert("test_channel_attr: Sharding needs relaxed order\n", channel_create_ex(&attr) == NULL);
+
+    // An MPMC channel is a FIFO of fixed capacity, and counts its messages when asked to
+    attr.backend = CHANNEL_BACKEND_MPMC;
+    attr.capacity = 3;
+    attr.stats = true;
+    channel_t* mpmc = channel_create_ex(&attr);
+    void* data = NULL;
+    for (uintptr_t i = 1; i <= 3; i++) {
+        mu_assert("test_channel_attr: Send failed\n", channel_non_blocking_send(mpmc, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_attr: Should be full\n", channel_non_blocking_send(mpmc, (void*)4) == CHANNEL_FULL);
+    for (uintptr_t i = 1; i <= 3; i++) {
+        mu_assert("test_channel_attr: Out of order\n", channel_receive(mpmc, &data) == SUCCESS && (uintptr_t)data == i);
+    }
+    mu_assert("test_channel_attr: Should be empty\n", channel_non_blocking_receive(mpmc, &data) == CHANNEL_EMPTY);
+    channel_stats_t stats;
+    mu_assert("test_channel_attr: Wrong counters\n", channel_stats(mpmc, &stats) == SUCCESS && stats.sent == 3 && stats.received == 3);
+    channel_close(mpmc);
+    channel_destroy(mpmc);
+
+    // Producers and consumers both block on a small MPMC channel; nothing is lost or duplicated
+    attr.capacity = 8;
+    attr.wait = CHANNEL_WAIT_YIELD;
+    attr.wake = CHANNEL_WAKE_ALL;
+    mpmc = channel_create_ex(&attr);
+    pthread_t producer_pids[4];
+    pthread_t consumer_pids[4];
+    send_args producers[4];
+    attr_receive_args consumers[4];
+    for (uintptr_t i = 0; i < 4; i++) {
+        consumers[i] = (attr_receive_args){mpmc, 0, 0, true};
+        pthread_create(&consumer_pids[i], NULL, (void*)helper_attr_receive, &consumers[i]);
+        init_object_for_send_api(&producers[i], mpmc, (char*)(i + 1), NULL);
+        pthread_create(&producer_pids[i], NULL, (void*)helper_sharded_send, &producers[i]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(producer_pids[i], NULL);
+        mu_assert("test_channel_attr: Send failed\n", producers[i].out == SUCCESS);
+    }
+    // Receives fail once the channel is closed, so let the consumers drain it first
+    while (channel_stats(mpmc, &stats) == SUCCESS && stats.received < 4000) {
+        usleep(1000);
+    }
+    channel_close(mpmc);
+    size_t received = 0;
+    uintptr_t sum = 0;
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(consumer_pids[i], NULL);
+        mu_assert("test_channel_attr: Producer out of order\n", consumers[i].ordered);
+        received += consumers[i].received;
+        sum += consumers[i].sum;
+    }
+    mu_assert("test_channel_attr: Lost or duplicated messages\n", received == 4000 && sum == 4 * 999 * 1000 / 2);
+    mu_assert("test_channel_attr: Wrong counters\n", channel_stats(mpmc, &stats) == SUCCESS && stats.sent == 4000 && stats.received == 4000);
+    channel_destroy(mpmc);
+
+    // One select waits on a ring, an MPMC channel and a mailbox at once
+    channel_t* ring = channel_create(1);
+    mu_assert("test_channel_attr: Statistics are off by default\n", channel_stats(ring, &stats) == GENERIC_ERROR);
+    channel_attr_init(&attr);
+    attr.backend = CHANNEL_BACKEND_MPMC;
+    attr.capacity = 1;
+    mpmc = channel_create_ex(&attr);
+    attr.backend = CHANNEL_BACKEND_MAILBOX;
+    channel_t* mailbox = channel_create_ex(&attr);
+    pthread_t pid;
+    select_t list[3] = {{ring, RECV, NULL, -1}, {mpmc, RECV, NULL, -1}, {mailbox, RECV, NULL, -1}};
+    select_args selector = {list, 3, NULL, GENERIC_ERROR, 0};
+    pthread_create(&pid, NULL, (void*)helper_select, &selector);
+    usleep(10000);
+    mu_assert("test_channel_attr: Send failed\n", channel_send(mpmc, "MPMC") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_attr: MPMC case failed\n", selector.out == SUCCESS && selector.index == 1 && string_equal(list[1].data, "MPMC"));
+
+    mailbox_message_t message;
+    pthread_create(&pid, NULL, (void*)helper_select, &selector);
+    usleep(10000);
+    mu_assert("test_channel_attr: Send failed\n", channel_send(mailbox, &message.node) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_attr: Mailbox case failed\n", selector.out == SUCCESS && selector.index == 2 && list[2].data == &message);
+
+    pthread_create(&pid, NULL, (void*)helper_select, &selector);
+    usleep(10000);
+    mu_assert("test_channel_attr: Send failed\n", channel_send(ring, "Ring") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_attr: Ring case failed\n", selector.out == SUCCESS && selector.index == 0 && string_equal(list[0].data, "Ring"));
+
+    // A SEND case waits for room in a full MPMC channel
+    mu_assert("test_channel_attr: Send failed\n", channel_send(mpmc, "Full") == SUCCESS);
+    select_t send_list[1] = {{mpmc, SEND, "Next", -1}};
+    select_args sender = {send_list, 1, NULL, GENERIC_ERROR, 1};
+    pthread_create(&pid, NULL, (void*)helper_select, &sender);
+    usleep(10000);
+    mu_assert("test_channel_attr: Receive failed\n", channel_receive(mpmc, &data) == SUCCESS && string_equal(data, "Full"));
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_attr: SEND case failed\n", sender.out == SUCCESS && sender.index == 0);
+    mu_assert("test_channel_attr: Receive failed\n", channel_receive(mpmc, &data) == SUCCESS && string_equal(data, "Next"));
+
+    // Close reaches receivers parked on an MPMC channel
+    receive_args receiver;
+    init_object_for_receive_api(&receiver, mpmc, NULL);
+    pthread_create(&pid, NULL, (void*)helper_receive, &receiver);
+    usleep(10000);
+    channel_close(mpmc);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_attr: Receive should see the close\n", receiver.out == CLOSED_ERROR);
+    mu_assert("test_channel_attr: Send should see the close\n", channel_non_blocking_send(mpmc, "Closed") == CLOSED_ERROR);
+    channel_destroy(mpmc);
+    channel_close(mailbox);
+    channel_destroy(mailbox);
+    channel_close(ring);
+    channel_destroy(ring);
+
+    // The SPSC backend takes the lock-free path from the first send and receive on
+    channel_attr_init(&attr);
+    attr.backend = CHANNEL_BACKEND_SPSC;
+    attr.capacity = 4;
+    attr.stats = true;
+    channel_t* spsc = channel_create_ex(&attr);
+    mu_assert("test_channel_attr: Should start locked\n", !channel_spsc_active(spsc));
+    mu_assert("test_channel_attr: Send failed\n", channel_send(spsc, (void*)1) == SUCCESS);
+    mu_assert("test_channel_attr: Receive failed\n", channel_receive(spsc, &data) == SUCCESS && (uintptr_t)data == 1);
+    mu_assert("test_channel_attr: Should be promoted\n", channel_spsc_active(spsc));
+    mu_assert("test_channel_attr: Send failed\n", channel_send(spsc, (void*)2) == SUCCESS);
+    mu_assert("test_channel_attr: Receive failed\n", channel_receive(spsc, &data) == SUCCESS && (uintptr_t)data == 2);
+    mu_assert("test_channel_attr: Wrong counters\n", channel_stats(spsc, &stats) == SUCCESS && stats.sent == 2 && stats.received == 2);
+    channel_close(spsc);
+    channel_destroy(spsc);
+
+    // A sharded channel counts through its shards
+    channel_attr_init(&attr);
+    attr.backend = CHANNEL_BACKEND_SHARDED;
+    attr.capacity = 4;
+    attr.shards = 2;
+    attr.flags = CHANNEL_RELAXED_ORDER;
+    attr.stats = true;
+    channel_t* sharded = channel_create_ex(&attr);
+    mu_assert("test_channel_attr: Shard count\n", channel_shard_count(sharded) == 2);
+    for (uintptr_t i = 1; i <= 3; i++) {
+        mu_assert("test_channel_attr: Send failed\n", channel_send(sharded, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_channel_attr: Receive failed\n", channel_receive(sharded, &data) == SUCCESS);
+    mu_assert("test_channel_attr: Wrong counters\n", channel_stats(sharded, &stats) == SUCCESS && stats.sent == 3 && stats.received == 1);
+    channel_close(sharded);
+    channel_destroy(sharded);
+    return NULL;
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t count;
+    size_t messages;
+} state_producer_args;
+
+void* helper_state_producer(state_producer_args* args) {
+    for (size_t i = 0; i < args->messages; i++) {
+        channel_send(args->channels[(i * 7) % args->count], (void*)(uintptr_t)(i + 1));
+    }
+    return NULL;
+}
+
+char* test_channel_state() {
+    print_test_details(__func__, "Testing the lock-free channel state used by select and non-blocking calls");
+
+    // The state word follows the buffer
+    channel_t* channel = channel_create(2);
+    void* data = NULL;
+    mu_assert("test_channel_state: Should start empty\n", atomic_load(&channel->state) == 0);
+    mu_assert("test_channel_state: Should be empty\n", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_channel_state: Send failed\n", channel_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_channel_state: Wrong count\n", atomic_load(&channel->state) >> CHANNEL_STATE_SIZE_SHIFT == 1);
+    mu_assert("test_channel_state: Send failed\n", channel_send(channel, "Message2") == SUCCESS);
+    mu_assert("test_channel_state: Should be full\n", atomic_load(&channel->state) & CHANNEL_STATE_FULL);
+    mu_assert("test_channel_state: Should be full\n", channel_non_blocking_send(channel, "Message3") == CHANNEL_FULL);
+    mu_assert("test_channel_state: Receive failed\n", channel_non_blocking_receive(channel, &data) == SUCCESS && string_equal(data, "Message1"));
+    mu_assert("test_channel_state: Should have room\n", !(atomic_load(&channel->state) & CHANNEL_STATE_FULL));
+
+    // Lossy channels always accept sends, so only the lock knows what a send does
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_DROP_OLDEST, NULL);
+    mu_assert("test_channel_state: Lossy channels should be locked\n", atomic_load(&channel->state) & CHANNEL_STATE_LOCKED);
+    mu_assert("test_channel_state: Send failed\n", channel_non_blocking_send(channel, "Message3") == SUCCESS);
+    mu_assert("test_channel_state: Send failed\n", channel_non_blocking_send(channel, "Message4") == SUCCESS);
+    mu_assert("test_channel_state: Should have shed one\n", channel_dropped(channel) == 1);
+    channel_set_overflow(channel, CHANNEL_OVERFLOW_BLOCK, NULL);
+    mu_assert("test_channel_state: Should be full again\n", atomic_load(&channel->state) & CHANNEL_STATE_FULL);
+    channel_close(channel);
+    mu_assert("test_channel_state: Should be closed\n", atomic_load(&channel->state) & CHANNEL_STATE_CLOSED);
+    mu_assert("test_channel_state: Send should see the close\n", channel_non_blocking_send(channel, "Closed") == CLOSED_ERROR);
+    mu_assert("test_channel_state: Receive should see the close\n", channel_non_blocking_receive(channel, &data) == CLOSED_ERROR);
+    channel_destroy(channel);
+
+    // A wide select picks the first ready case, and a closed channel ahead of it reports the close
+    // (60 cases: the full scan locks every channel, and ThreadSanitizer tracks at most 64 held locks)
+    channel_t* channels[60];
+    select_t list[60];
+    for (size_t i = 0; i < 60; i++) {
+        channels[i] = channel_create(1);
+        list[i].channel = channels[i];
+        list[i].dir = RECV;
+        list[i].data = NULL;
+    }
+    size_t index = 60;
+    mu_assert("test_channel_state: Send failed\n", channel_send(channels[53], "Message53") == SUCCESS);
+    mu_assert("test_channel_state: Send failed\n", channel_send(channels[55], "Message55") == SUCCESS);
+    mu_assert("test_channel_state: Select failed\n", channel_select(list, 60, &index) == SUCCESS && index == 53 && string_equal(list[53].data, "Message53"));
+    mu_assert("test_channel_state: Send failed\n", channel_send(channels[10], "Message10") == SUCCESS);
+    mu_assert("test_channel_state: Select failed\n", channel_select(list, 60, &index) == SUCCESS && index == 10 && string_equal(list[10].data, "Message10"));
+    channel_close(channels[30]);
+    mu_assert("test_channel_state: Select should see the close\n", channel_select(list, 60, &index) == CLOSED_ERROR && index == 30);
+    channel_destroy(channels[30]);
+    channels[30] = channel_create(1);
+    list[30].channel = channels[30];
+    mu_assert("test_channel_state: Select failed\n", channel_select(list, 60, &index) == SUCCESS && index == 55 && string_equal(list[55].data, "Message55"));
+
+    // SEND cases skip full channels
+    for (size_t i = 0; i < 60; i++) {
+        list[i].dir = SEND;
+        list[i].data = "Sent";
+        if (i != 44) {
+            mu_assert("test_channel_state: Send failed\n", channel_send(channels[i], "Filler") == SUCCESS);
+        }
+    }
+    mu_assert("test_channel_state: Select failed\n", channel_select(list, 60, &index) == SUCCESS && index == 44);
+    mu_assert("test_channel_state: Receive failed\n", channel_receive(channels[44], &data) == SUCCESS && string_equal(data, "Sent"));
+
+    // With nothing ready the select registers and sleeps
+    for (size_t i = 0; i < 60; i++) {
+        list[i].dir = RECV;
+        if (i != 44) {
+            mu_assert("test_channel_state: Receive failed\n", channel_receive(channels[i], &data) == SUCCESS);
+        }
+    }
+    pthread_t pid;
+    select_args args;
+    init_object_for_select_api(&args, list, 60, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(6000);
+    mu_assert("test_channel_state: Select should be blocked\n", args.out == GENERIC_ERROR);
+    mu_assert("test_channel_state: Send failed\n", channel_send(channels[42], "Message42") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_state: Select failed\n", args.out == SUCCESS && args.index == 42 && string_equal(list[42].data, "Message42"));
+
+    // Selects racing a producer across the channels lose nothing
+    state_producer_args producer = {channels, 16, 2000};
+    pthread_create(&pid, NULL, (void*)helper_state_producer, &producer);
+    size_t sum = 0;
+    for (size_t i = 0; i < 2000; i++) {
+        mu_assert("test_channel_state: Select failed\n", channel_select(list, 16, &index) == SUCCESS && index < 16);
+        sum += (uintptr_t)list[index].data;
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_state: Lost or duplicated messages\n", sum == 2000 * 2001 / 2);
+    for (size_t i = 0; i < 60; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+char* test_select_futex() {
+    print_test_details(__func__, "Testing selects that sleep on the channels' futex words");
+
+    // Kernels without futex_waitv (before 5.16) fall back to registering every select
+    _Atomic uint32_t probe = 1;
+    _Atomic uint32_t* probe_word = &probe;
+    uint32_t stale = 0;
+    bool futex = futex_wait_any(&probe_word, &stale, 1) == 0 || errno != ENOSYS;
+
+    // A blocked select counts itself in on every channel instead of registering
+    channel_t* channels[8];
+    select_t list[8];
+    for (size_t i = 0; i < 8; i++) {
+        channels[i] = channel_create(1);
+        list[i].channel = channels[i];
+        list[i].dir = RECV;
+        list[i].data = NULL;
+    }
+    pthread_t pid;
+    select_args args;
+    init_object_for_select_api(&args, list, 8, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_futex: Select should be blocked\n", args.out == GENERIC_ERROR);
+    pthread_mutex_lock(&channels[3]->channel_lock);
+    size_t registered = list_count(channels[3]->sel_recvs);
+    pthread_mutex_unlock(&channels[3]->channel_lock);
+    mu_assert("test_select_futex: Select should be counted in\n", !futex || atomic_load(&channels[3]->futex_waiters) == 1);
+    mu_assert("test_select_futex: Select should not register\n", registered == (futex ? 0 : 1));
+    mu_assert("test_select_futex: Send failed\n", channel_send(channels[3], "Message3") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_futex: Select failed\n", args.out == SUCCESS && args.index == 3 && string_equal(list[3].data, "Message3"));
+    mu_assert("test_select_futex: Select should have left\n", atomic_load(&channels[3]->futex_waiters) == 0);
+
+    // Closing a channel wakes the select
+    init_object_for_select_api(&args, list, 8, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_futex: Select should be blocked\n", args.out == GENERIC_ERROR);
+    channel_close(channels[5]);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_futex: Select should see the close\n", args.out == CLOSED_ERROR && args.index == 5);
+    channel_destroy(channels[5]);
+    channels[5] = channel_create(1);
+    list[5].channel = channels[5];
+
+    // Lock-free backends bump the word too
+    channel_attr_t attr;
+    channel_attr_init(&attr);
+    attr.backend = CHANNEL_BACKEND_MPMC;
+    attr.capacity = 4;
+    channel_t* mpmc = channel_create_ex(&attr);
+    list[7].channel = mpmc;
+    init_object_for_select_api(&args, list, 8, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_futex: Select should be blocked\n", args.out == GENERIC_ERROR);
+    mu_assert("test_select_futex: Send failed\n", channel_send(mpmc, "MPMC") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_futex: Select failed\n", args.out == SUCCESS && args.index == 7 && string_equal(list[7].data, "MPMC"));
+    mu_assert("test_select_futex: Select should have left\n", atomic_load(&mpmc->sleepers) == 0);
+    list[7].channel = channels[7];
+    channel_close(mpmc);
+    channel_destroy(mpmc);
+
+    // A SEND case held back by the memory budget sleeps until budget is released
+    void* data = NULL;
+    governor_set_budget(1, GOVERNOR_ENTRIES, GOVERNOR_BLOCK);
+    mu_assert("test_select_futex: Send failed\n", channel_send(channels[0], "Charged") == SUCCESS);
+    list[1].dir = SEND;
+    list[1].data = "Budget";
+    init_object_for_select_api(&args, &list[1], 1, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_futex: Select should wait for budget\n", args.out == GENERIC_ERROR);
+    mu_assert("test_select_futex: Receive failed\n", channel_receive(channels[0], &data) == SUCCESS && string_equal(data, "Charged"));
+    pthread_join(pid, NULL);
+    mu_assert("test_select_futex: Select failed\n", args.out == SUCCESS && args.index == 0);
+    mu_assert("test_select_futex: Receive failed\n", channel_receive(channels[1], &data) == SUCCESS && string_equal(data, "Budget"));
+    governor_set_budget(0, GOVERNOR_ENTRIES, GOVERNOR_BLOCK);
+    list[1].dir = RECV;
+
+    // Selects with more cases than futex_waitv takes register with the channels instead
+    select_t wide[130];
+    for (size_t i = 0; i < 130; i++) {
+        wide[i].channel = channels[i % 2];
+        wide[i].dir = RECV;
+        wide[i].data = NULL;
+    }
+    init_object_for_select_api(&args, wide, 130, NULL);
+    pthread_create(&pid, NULL, (void*)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_futex: Select should be blocked\n", args.out == GENERIC_ERROR);
+    pthread_mutex_lock(&channels[1]->channel_lock);
+    registered = list_count(channels[1]->sel_recvs);
+    pthread_mutex_unlock(&channels[1]->channel_lock);
+    mu_assert("test_select_futex: Select should register\n", registered == 1);
+    mu_assert("test_select_futex: Send failed\n", channel_send(channels[1], "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_futex: Select failed\n", args.out == SUCCESS && args.index == 1 && string_equal(wide[1].data, "Message1"));
+    for (size_t i = 0; i < 8; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
 typedef char* (*test_fn_t)();
 typedef struct {
     char* name;
@@ -1667,6 +3876,31 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
+                  {"test_unbounded_channel", test_unbounded_channel},
+                  {"test_mapped_channel", test_mapped_channel},
+                  {"test_numa_channel", test_numa_channel},
+                  {"test_compact_channel", test_compact_channel},
+                  {"test_memory_governor", test_memory_governor},
+                  {"test_shared_channel", test_shared_channel},
+                  {"test_channel_readiness_fds", test_channel_readiness_fds},
+                  {"test_select_fd_cases", test_select_fd_cases},
+                  {"test_uring_stage", test_uring_stage},
+                  {"test_mmap_source", test_mmap_source},
+                  {"test_spill_channel", test_spill_channel},
+                  {"test_shared_channel_snapshot", test_shared_channel_snapshot},
+                  {"test_trace_replay", test_trace_replay},
+                  {"test_broadcast_channel", test_broadcast_channel},
+                  {"test_conflating_channel", test_conflating_channel},
+                  {"test_overflow_policies", test_overflow_policies},
+                  {"test_codel_channel", test_codel_channel},
+                  {"test_priority_channel", test_priority_channel},
+                  {"test_keyed_channel", test_keyed_channel},
+                  {"test_sharded_channel", test_sharded_channel},
+                  {"test_mailbox_channel", test_mailbox_channel},
+                  {"test_spsc_detection", test_spsc_detection},
+                  {"test_channel_attr", test_channel_attr},
+                  {"test_channel_state", test_channel_state},
+                  {"test_select_futex", test_select_futex},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
@@ -0,0 +1,537 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+#define TRACE_MAGIC 0x45435254 // "TRCE"
+#define TRACE_VERSION 1
+// Events buffered in memory before they are written out (64 KiB)
+#define TRACE_BUFFER_EVENTS (65536 / sizeof(trace_event_t))
+// Replay gives up on blocked operations after this long without progress
+#define TRACE_STALL_NS 1000000000ULL
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+} trace_header_t;
+
+_Atomic bool trace_enabled;
+static _Atomic uint32_t next_channel_id = 1; // 0 marks select cases that are not channels
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;
+static uint64_t trace_epoch;
+static trace_event_t trace_buffer[TRACE_BUFFER_EVENTS];
+static size_t trace_buffered;
+static __thread uint32_t thread_id;
+
+uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + 1;
+}
+
+uint32_t trace_channel_id(void)
+{
+    // The counter wraps after 2^32 channels; 0 is skipped so a channel is never taken for a descriptor case
+    uint32_t id;
+    do {
+        id = atomic_fetch_add(&next_channel_id, 1);
+    } while (id == 0);
+    return id;
+}
+
+// Writes out the buffered events; must be called with trace_lock held
+static void trace_flush(void)
+{
+    size_t bytes = trace_buffered * sizeof(trace_event_t);
+    const char* out = (const char*)trace_buffer;
+    while (bytes > 0) {
+        ssize_t written = write(trace_fd, out, bytes);
+        if (written <= 0) {
+            break; // a full disk loses the tail of the trace rather than stalling the channels
+        }
+        out += written;
+        bytes -= (size_t)written;
+    }
+    trace_buffered = 0;
+}
+
+int trace_start(const char* path)
+{
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd >= 0) {
+        pthread_mutex_unlock(&trace_lock);
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    trace_header_t header = {TRACE_MAGIC, TRACE_VERSION, 0};
+    if (fd < 0 || write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        pthread_mutex_unlock(&trace_lock);
+        return -1;
+    }
+    trace_fd = fd;
+    trace_epoch = trace_now();
+    trace_buffered = 0;
+    atomic_store(&trace_enabled, true);
+    pthread_mutex_unlock(&trace_lock);
+    return 0;
+}
+
+void trace_stop(void)
+{
+    atomic_store(&trace_enabled, false);
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd >= 0) {
+        trace_flush();
+        close(trace_fd);
+        trace_fd = -1;
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+// Appends one event; must be called with trace_lock held and a trace running
+static void trace_append(uint64_t start, enum trace_op op, uint32_t channel, uint32_t arg, bool blocked,
+                         enum channel_status status)
+{
+    if (thread_id == 0) {
+        thread_id = (uint32_t)syscall(SYS_gettid);
+    }
+    trace_event_t* event = &trace_buffer[trace_buffered++];
+    event->timestamp = start > trace_epoch ? start - trace_epoch : 0;
+    event->thread = thread_id;
+    event->channel = channel;
+    event->arg = arg;
+    event->op = (uint8_t)op;
+    event->blocked = blocked;
+    event->status = (int8_t)status;
+    event->reserved = 0;
+    if (trace_buffered == TRACE_BUFFER_EVENTS) {
+        trace_flush();
+    }
+}
+
+void trace_end(uint64_t start, enum trace_op op, uint32_t channel, uint32_t arg, bool blocked,
+               enum channel_status status)
+{
+    if (start == 0) {
+        return;
+    }
+    pthread_mutex_lock(&trace_lock);
+    // The trace may have been stopped while the operation was running
+    if (trace_fd >= 0) {
+        trace_append(start, op, channel, arg, blocked, status);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+uint32_t* trace_select_ids(uint64_t start, const select_t* channel_list, size_t channel_count)
+{
+    if (start == 0) {
+        return NULL;
+    }
+    uint32_t* ids = malloc((channel_count > 0 ? channel_count : 1) * sizeof(uint32_t));
+    for (size_t i = 0; ids && i < channel_count; i++) {
+        bool is_channel = channel_list[i].dir == SEND || channel_list[i].dir == RECV;
+        ids[i] = is_channel ? channel_list[i].channel->trace_id : 0;
+    }
+    return ids;
+}
+
+void trace_end_select(uint64_t start, uint32_t* ids, const select_t* channel_list, size_t channel_count,
+                      size_t selected_index, bool blocked, enum channel_status status)
+{
+    if (start == 0) {
+        return;
+    }
+    // Without ids (out of memory) the select is still recorded, with unknown channels
+    uint32_t channel = ids && selected_index < channel_count ? ids[selected_index] : 0;
+    pthread_mutex_lock(&trace_lock);
+    // The select and its cases are appended under one lock so they stay adjacent in the trace
+    if (trace_fd >= 0) {
+        trace_append(start, TRACE_SELECT, channel, (uint32_t)channel_count, blocked, status);
+        for (size_t i = 0; i < channel_count; i++) {
+            trace_append(start, TRACE_SELECT_CASE, ids ? ids[i] : 0, (uint32_t)channel_list[i].dir, false, SUCCESS);
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    free(ids);
+}
+
+// State shared by all replay threads
+typedef struct {
+    const trace_event_t* events;
+    const uint32_t* slots;      // replay slot of each event's channel, 0 if it has none
+    channel_t** channels;       // indexed by replay slot
+    double time_scale;
+    uint64_t start;
+    _Atomic size_t progress;    // operations completed so far
+    _Atomic size_t diverged;
+    _Atomic size_t running;     // replay threads still running
+} trace_replay_t;
+
+// Events recorded by one thread, replayed in order by one replay thread
+typedef struct {
+    trace_replay_t* replay;
+    uint32_t thread;
+    size_t* events;
+    size_t count;
+    size_t allocated;
+} trace_replay_thread_t;
+
+// Maps the recorded channel ids, which can be anywhere in 1..UINT32_MAX, to dense replay slots from 1
+typedef struct {
+    uint32_t* ids;   // open addressing table of recorded ids, 0 marks a free entry
+    uint32_t* slots; // slot of the id in the same entry
+    size_t mask;     // table size - 1 (a power of two)
+    size_t count;    // slots handed out so far
+} trace_id_map_t;
+
+static size_t trace_id_hash(uint32_t id, size_t mask)
+{
+    return (size_t)(id * 2654435761U) & mask;
+}
+
+// Stores id in the first free entry of its probe sequence
+static void trace_id_place(trace_id_map_t* map, uint32_t id, uint32_t slot)
+{
+    size_t entry = trace_id_hash(id, map->mask);
+    while (map->ids[entry] != 0) {
+        entry = (entry + 1) & map->mask;
+    }
+    map->ids[entry] = id;
+    map->slots[entry] = slot;
+}
+
+// Doubles the table; returns false if it cannot be allocated
+static bool trace_id_grow(trace_id_map_t* map)
+{
+    trace_id_map_t grown = {NULL, NULL, map->mask * 2 + 1, map->count};
+    grown.ids = calloc(grown.mask + 1, sizeof(uint32_t));
+    grown.slots = malloc((grown.mask + 1) * sizeof(uint32_t));
+    if (!grown.ids || !grown.slots) {
+        free(grown.ids);
+        free(grown.slots);
+        return false;
+    }
+    for (size_t entry = 0; entry <= map->mask; entry++) {
+        if (map->ids[entry] != 0) {
+            trace_id_place(&grown, map->ids[entry], map->slots[entry]);
+        }
+    }
+    free(map->ids);
+    free(map->slots);
+    *map = grown;
+    return true;
+}
+
+// Returns the slot of a recorded id, handing out the next one on its first appearance
+// Returns 0 for id 0 (no channel), or if the table cannot grow
+static uint32_t trace_id_slot(trace_id_map_t* map, uint32_t id)
+{
+    if (id == 0) {
+        return 0;
+    }
+    size_t entry = trace_id_hash(id, map->mask);
+    while (map->ids[entry] != 0) {
+        if (map->ids[entry] == id) {
+            return map->slots[entry];
+        }
+        entry = (entry + 1) & map->mask;
+    }
+    // Keep the table at most half full; ids are 32 bits, so the slots never run out
+    if ((map->count + 1) * 2 > map->mask + 1) {
+        if (!trace_id_grow(map)) {
+            return 0;
+        }
+    }
+    map->count++;
+    trace_id_place(map, id, (uint32_t)map->count);
+    return (uint32_t)map->count;
+}
+
+static channel_t* trace_default_factory(uint32_t id, size_t capacity, void* arg)
+{
+    (void)id;
+    (void)arg;
+    if (capacity == SIZE_MAX || capacity == TRACE_CAPACITY_UNKNOWN) {
+        return channel_create_unbounded(64);
+    }
+    return channel_create(capacity);
+}
+
+// Sleeps until the recorded time of event, scaled by the replay's time_scale
+static void trace_replay_wait(trace_replay_t* replay, const trace_event_t* event)
+{
+    if (replay->time_scale <= 0) {
+        return;
+    }
+    uint64_t due = replay->start + (uint64_t)((double)event->timestamp * replay->time_scale);
+    if (trace_now() >= due) {
+        // Running late: issue the operation right away rather than paying for a sleep
+        return;
+    }
+    struct timespec ts = {(time_t)(due / 1000000000ULL), (long)(due % 1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+static void* trace_replay_thread(trace_replay_thread_t* thread)
+{
+    trace_replay_t* replay = thread->replay;
+    void* token = (void*)thread;
+    for (size_t i = 0; i < thread->count; i++) {
+        const trace_event_t* event = &replay->events[thread->events[i]];
+        if (event->op == TRACE_CREATE || event->op == TRACE_SELECT_CASE) {
+            continue;
+        }
+        trace_replay_wait(replay, event);
+        channel_t* channel = replay->channels[replay->slots[thread->events[i]]];
+        if (!channel && event->op != TRACE_SELECT) {
+            continue;
+        }
+        enum channel_status status = (enum channel_status)event->status;
+        void* data = NULL;
+        switch (event->op) {
+        case TRACE_SEND:
+            status = channel_send(channel, token);
+            break;
+        case TRACE_RECV:
+            status = channel_receive(channel, &data);
+            break;
+        case TRACE_NB_SEND:
+            status = channel_non_blocking_send(channel, token);
+            break;
+        case TRACE_NB_RECV:
+            status = channel_non_blocking_receive(channel, &data);
+            break;
+        case TRACE_CLOSE:
+            status = channel_close(channel);
+            break;
+        case TRACE_SELECT: {
+            // The cases follow the select in this thread's events; descriptor cases cannot be replayed
+            size_t cases = event->arg < thread->count - i ? event->arg : thread->count - i - 1;
+            select_t* list = calloc(cases > 0 ? cases : 1, sizeof(select_t));
+            size_t used = 0;
+            for (size_t c = 0; c < cases; c++) {
+                const trace_event_t* sel_case = &replay->events[thread->events[i + 1 + c]];
+                channel_t* case_channel = replay->channels[replay->slots[thread->events[i + 1 + c]]];
+                if (!case_channel) {
+                    continue;
+                }
+                list[used].channel = case_channel;
+                list[used].dir = (enum direction)sel_case->arg;
+                list[used].data = token;
+                used++;
+            }
+            size_t index;
+            if (used > 0) {
+                status = channel_select(list, used, &index);
+            }
+            free(list);
+            i += cases;
+            break;
+        }
+        default:
+            break;
+        }
+        if (status != (enum channel_status)event->status) {
+            atomic_fetch_add(&replay->diverged, 1);
+        }
+        atomic_fetch_add(&replay->progress, 1);
+    }
+    atomic_fetch_sub(&replay->running, 1);
+    return NULL;
+}
+
+int trace_replay(const char* path, double time_scale, trace_channel_factory_t factory, void* arg,
+                 trace_replay_stats_t* stats)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    size_t file_size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    const char* map = file_size >= sizeof(trace_header_t) ? mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                                                           : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const trace_header_t* header = (const trace_header_t*)map;
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION) {
+        munmap((void*)map, file_size);
+        return -1;
+    }
+    const trace_event_t* events = (const trace_event_t*)(header + 1);
+    size_t event_count = (file_size - sizeof(trace_header_t)) / sizeof(trace_event_t);
+    if (!factory) {
+        factory = trace_default_factory;
+    }
+
+    // Channels: one per id seen in the trace, created up front with the recorded capacity
+    // Ids are remapped to dense slots, as the process may have created many channels before tracing
+    int rc = 0;
+    trace_id_map_t ids = {calloc(64, sizeof(uint32_t)), malloc(64 * sizeof(uint32_t)), 63, 0};
+    uint32_t* slots = malloc((event_count > 0 ? event_count : 1) * sizeof(uint32_t));
+    if (!ids.ids || !ids.slots || !slots) {
+        rc = -1;
+    }
+    for (size_t i = 0; i < event_count && rc == 0; i++) {
+        slots[i] = trace_id_slot(&ids, events[i].channel);
+        if (slots[i] == 0 && events[i].channel != 0) {
+            rc = -1;
+        }
+    }
+    size_t channel_count = rc == 0 ? ids.count : 0;
+    uint32_t* recorded = malloc((channel_count + 1) * sizeof(uint32_t));
+    size_t* capacities = malloc((channel_count + 1) * sizeof(size_t));
+    channel_t** channels = calloc(channel_count + 1, sizeof(channel_t*));
+    if (!recorded || !capacities || !channels) {
+        rc = -1;
+    }
+    for (size_t entry = 0; entry <= ids.mask && rc == 0; entry++) {
+        if (ids.ids[entry] != 0) {
+            recorded[ids.slots[entry]] = ids.ids[entry];
+            capacities[ids.slots[entry]] = TRACE_CAPACITY_UNKNOWN;
+        }
+    }
+    for (size_t i = 0; i < event_count && rc == 0; i++) {
+        if (events[i].op == TRACE_CREATE && slots[i] != 0) {
+            capacities[slots[i]] = events[i].arg == TRACE_CAPACITY_LARGE ? SIZE_MAX : events[i].arg;
+        }
+    }
+    for (size_t slot = 1; slot <= channel_count && rc == 0; slot++) {
+        channels[slot] = factory(recorded[slot], capacities[slot], arg);
+        rc = channels[slot] ? 0 : -1;
+    }
+    free(ids.ids);
+    free(ids.slots);
+    free(recorded);
+    free(capacities);
+
+    // Threads: split the events by recorded thread, keeping each thread's order
+    size_t thread_count = 0;
+    trace_replay_thread_t* threads = NULL;
+    for (size_t i = 0; i < event_count && rc == 0; i++) {
+        size_t t = 0;
+        while (t < thread_count && threads[t].thread != events[i].thread) {
+            t++;
+        }
+        if (t == thread_count) {
+            trace_replay_thread_t* grown = realloc(threads, (thread_count + 1) * sizeof(trace_replay_thread_t));
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+            threads = grown;
+            memset(&threads[t], 0, sizeof(trace_replay_thread_t));
+            threads[t].thread = events[i].thread;
+            thread_count++;
+        }
+        if (threads[t].count == threads[t].allocated) {
+            size_t allocated = threads[t].allocated > 0 ? threads[t].allocated * 2 : 64;
+            size_t* grown = realloc(threads[t].events, allocated * sizeof(size_t));
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+            threads[t].events = grown;
+            threads[t].allocated = allocated;
+        }
+        threads[t].events[threads[t].count++] = i;
+    }
+
+    trace_replay_t replay;
+    replay.events = events;
+    replay.slots = slots;
+    replay.channels = channels;
+    replay.time_scale = time_scale;
+    atomic_init(&replay.progress, 0);
+    atomic_init(&replay.diverged, 0);
+    atomic_init(&replay.running, 0);
+    replay.start = trace_now();
+    pthread_t* pids = malloc((thread_count > 0 ? thread_count : 1) * sizeof(pthread_t));
+    if (!pids) {
+        rc = -1;
+    }
+    size_t started = 0;
+    for (; started < thread_count && rc == 0; started++) {
+        threads[started].replay = &replay;
+        atomic_fetch_add(&replay.running, 1);
+        if (pthread_create(&pids[started], NULL, (void*)trace_replay_thread, &threads[started]) != 0) {
+            atomic_fetch_sub(&replay.running, 1);
+            rc = -1;
+            break;
+        }
+    }
+
+    // Watch for operations that can never complete and release them by closing every channel
+    // With timing preserved a thread may just be sleeping until its next event, so a stall only counts
+    // once the last recorded event is due
+    uint64_t last_due = event_count > 0 ? replay.start + (uint64_t)((double)events[event_count - 1].timestamp *
+                                                                    (time_scale > 0 ? time_scale : 0))
+                                        : replay.start;
+    size_t last_progress = 0;
+    uint64_t last_change = trace_now();
+    bool closed = false;
+    if (rc != 0 && started > 0) {
+        // A thread failed to start, so the threads that did may wait forever on its operations
+        closed = true;
+        for (size_t slot = 1; slot <= channel_count; slot++) {
+            channel_close(channels[slot]);
+        }
+    }
+    while (atomic_load(&replay.running) > 0) {
+        struct timespec tick = {0, 10000000};
+        nanosleep(&tick, NULL);
+        size_t progress = atomic_load(&replay.progress);
+        uint64_t now = trace_now();
+        if (progress != last_progress) {
+            last_progress = progress;
+            last_change = now;
+        } else if (!closed && now - last_change > TRACE_STALL_NS && now > last_due) {
+            closed = true;
+            for (size_t slot = 1; slot <= channel_count; slot++) {
+                channel_close(channels[slot]);
+            }
+        }
+    }
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(pids[t], NULL);
+    }
+    if (stats && rc == 0) {
+        stats->threads = thread_count;
+        stats->channels = channel_count;
+        stats->operations = atomic_load(&replay.progress);
+        stats->diverged = atomic_load(&replay.diverged);
+        stats->seconds = (double)(trace_now() - replay.start) / 1e9;
+    }
+
+    for (size_t slot = 1; channels && slot <= channel_count; slot++) {
+        if (channels[slot]) {
+            channel_close(channels[slot]);
+            channel_destroy(channels[slot]);
+        }
+    }
+    for (size_t t = 0; t < thread_count; t++) {
+        free(threads[t].events);
+    }
+    free(threads);
+    free(slots);
+    free(pids);
+    free(channels);
+    munmap((void*)map, file_size);
+    return rc;
+}
@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "channel.h"
+
+// Opt-in recorder of channel operations and a replay tool that re-drives a recorded trace
+// The trace is a small header followed by fixed-size trace_event_t records, in the order operations completed
+
+// Operations recorded in a trace
+enum trace_op {
+    TRACE_CREATE = 0,      // channel created; arg is its capacity
+    TRACE_SEND = 1,        // channel_send
+    TRACE_RECV = 2,        // channel_receive
+    TRACE_NB_SEND = 3,     // channel_non_blocking_send
+    TRACE_NB_RECV = 4,     // channel_non_blocking_receive
+    TRACE_SELECT = 5,      // channel_select on the selected channel; arg is the number of cases that follow
+    TRACE_SELECT_CASE = 6, // one case of the preceding select; arg is its direction
+    TRACE_CLOSE = 7        // channel_close
+};
+
+// Capacity recorded for channels whose capacity does not fit in 32 bits (unbounded channels included)
+#define TRACE_CAPACITY_LARGE UINT32_MAX
+// Capacity passed to replay factories for channels created before the trace started
+#define TRACE_CAPACITY_UNKNOWN (SIZE_MAX - 1)
+
+// One recorded operation (24 bytes)
+typedef struct {
+    uint64_t timestamp; // nanoseconds since trace_start, taken when the operation was issued
+    uint32_t thread;    // kernel thread id of the caller
+    uint32_t channel;   // channel id (see channel_t.trace_id)
+    uint32_t arg;       // operation specific, see enum trace_op
+    uint8_t op;         // enum trace_op
+    uint8_t blocked;    // 1 if the operation had to wait for a peer
+    int8_t status;      // enum channel_status returned by the operation
+    uint8_t reserved;
+} trace_event_t;
+
+// Set while a trace is being recorded; checked by every channel operation
+extern _Atomic bool trace_enabled;
+
+// Starts recording every channel operation to the file at path (replacing it)
+// Returns 0, or -1 if a trace is already running or the file cannot be created
+int trace_start(const char* path);
+// Stops recording and flushes the trace to disk
+void trace_stop(void);
+// Returns a new process-unique channel id (never 0)
+uint32_t trace_channel_id(void);
+// Returns the current trace clock in nanoseconds (never 0)
+uint64_t trace_now(void);
+// Returns the start timestamp to hand to trace_end, or 0 when no trace is running
+static inline uint64_t trace_begin(void)
+{
+    return atomic_load_explicit(&trace_enabled, memory_order_relaxed) ? trace_now() : 0;
+}
+// Records an operation that started at start (as returned by trace_begin); does nothing if start is 0
+void trace_end(uint64_t start, enum trace_op op, uint32_t channel, uint32_t arg, bool blocked,
+               enum channel_status status);
+// Returns the channel ids of a select's cases (0 for file descriptor cases) for trace_end_select, or NULL if start
+// is 0; they have to be read before the select runs, as any of its channels may be destroyed once it returns
+uint32_t* trace_select_ids(uint64_t start, const select_t* channel_list, size_t channel_count);
+// Records a select that started at start: a TRACE_SELECT event followed by one TRACE_SELECT_CASE event per case
+// ids comes from trace_select_ids and is freed here; selected_index is channel_count if no case was selected
+void trace_end_select(uint64_t start, uint32_t* ids, const select_t* channel_list, size_t channel_count,
+                      size_t selected_index, bool blocked, enum channel_status status);
+
+// Creates the channel that replays traced channel id with the recorded capacity
+// capacity is SIZE_MAX for unbounded channels and TRACE_CAPACITY_UNKNOWN if the trace does not say
+typedef channel_t* (*trace_channel_factory_t)(uint32_t id, size_t capacity, void* arg);
+
+// Results of a replay
+typedef struct {
+    size_t threads;    // replay threads, one per recorded thread
+    size_t channels;   // channels created through the factory
+    size_t operations; // operations replayed
+    size_t diverged;   // operations whose result differed from the recording
+    double seconds;    // wall time of the replay
+} trace_replay_stats_t;
+
+// Re-drives the trace at path against channels built by factory (NULL creates channel_create rings of the
+// recorded capacity, or unbounded channels for unbounded or unknown capacities)
+// Every recorded thread is replayed by its own thread issuing the same sends, receives, selects and closes
+// at the recorded times multiplied by time_scale (1 keeps the original timing, 0 replays as fast as possible)
+// Replay keeps each thread's order but not the order between threads, so fast replays diverge more
+// Operations that can never complete in the replay (for example receives of messages sent before the trace
+// started) are released by closing every channel once no thread makes progress for a second
+// Returns 0, or -1 if the trace cannot be read, or a channel, a replay thread or memory cannot be obtained
+int trace_replay(const char* path, double time_scale, trace_channel_factory_t factory, void* arg,
+                 trace_replay_stats_t* stats);
+#endif // TRACE_H
@@ -0,0 +1,566 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "uring_stage.h"
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing)
+// A ring is only ever used by the thread running the stage, so the submission tail and
+// completion head are plain fields and only the shared ring indices need atomics
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned sq_local_tail; // tail including prepared but not yet submitted entries
+    unsigned to_submit;
+} uring_t;
+
+typedef struct {
+    int fd;
+    channel_t* out;
+    off_t next_offset;   // offset of the next read to submit
+    size_t inflight;     // reads submitted and not yet completed
+    bool eof;            // a read returned 0 or failed; no more reads are submitted
+    io_chunk_t* marker;  // end-of-file chunk held back until inflight drops to 0
+    bool done;           // the end-of-file chunk has been sent
+} uring_file_t;
+
+struct uring_source {
+    uring_t ring;
+    bool async;          // false when io_uring is unavailable and pread() is used instead
+    bool registered;     // buffers are registered with the ring (READ_FIXED)
+    unsigned depth;
+    size_t buffer_count;
+    size_t buffer_size;
+    void* buffers;       // buffer_count * buffer_size bytes in a single mapping
+    io_chunk_t* chunks;
+    size_t* chunk_file;  // file each chunk is currently reading for
+    channel_t* free_chunks;
+    uring_file_t* files;
+    size_t file_count;
+    size_t next_file;    // round-robin position for spreading reads across files
+};
+
+static int uring_init(uring_t* ring, unsigned entries)
+{
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    long fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return -1;
+    }
+    ring->fd = (int)fd;
+    ring->entries = params.sq_entries;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+        ring->cq_ring_size = 0; // unmapped together with the submission ring
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring_size > 0) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    return 0;
+}
+
+static void uring_exit(uring_t* ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring_size > 0) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// Returns a cleared submission entry, or NULL if the submission ring is full
+static struct io_uring_sqe* uring_get_sqe(uring_t* ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->entries) {
+        return NULL;
+    }
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Submits the prepared entries and waits until at least wait_nr completions are available
+static int uring_submit_and_wait(uring_t* ring, unsigned wait_nr)
+{
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    while (ring->to_submit > 0 || wait_nr > 0) {
+        long rc = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait_nr,
+                          wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ring->to_submit -= (unsigned)rc;
+        // Completions are only waited for once everything has been submitted
+        if (ring->to_submit == 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// Takes back the newest prepared entry the kernel has not consumed, storing its user_data
+// Only valid after uring_submit_and_wait failed; returns false once every entry has been submitted
+static bool uring_take_back_sqe(uring_t* ring, uint64_t* user_data)
+{
+    if (ring->to_submit == 0) {
+        return false;
+    }
+    ring->to_submit--;
+    ring->sq_local_tail--;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    *user_data = ring->sqes[ring->sq_array[ring->sq_local_tail & *ring->sq_mask]].user_data;
+    return true;
+}
+
+// Returns the oldest unconsumed completion, or NULL if there is none
+static struct io_uring_cqe* uring_peek_cqe(uring_t* ring)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+// Marks the completion returned by uring_peek_cqe as consumed
+static void uring_cqe_seen(uring_t* ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+uring_source_t* uring_source_create(size_t buffer_count, size_t buffer_size, unsigned queue_depth)
+{
+    if (buffer_count == 0 || buffer_size == 0 || buffer_size > UINT32_MAX || queue_depth == 0) {
+        return NULL;
+    }
+    // All buffers share one mapping, whose size must not wrap around
+    if (buffer_count > SIZE_MAX / buffer_size) {
+        return NULL;
+    }
+    uring_source_t* source = calloc(1, sizeof(uring_source_t));
+    if (!source) {
+        return NULL;
+    }
+    source->buffer_count = buffer_count;
+    source->buffer_size = buffer_size;
+    source->depth = queue_depth;
+    source->buffers = mmap(NULL, buffer_count * buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    source->chunks = calloc(buffer_count, sizeof(io_chunk_t));
+    source->chunk_file = calloc(buffer_count, sizeof(size_t));
+    source->free_chunks = channel_create(buffer_count);
+    if (source->buffers == MAP_FAILED || !source->chunks || !source->chunk_file || !source->free_chunks) {
+        if (source->buffers != MAP_FAILED) {
+            munmap(source->buffers, buffer_count * buffer_size);
+        }
+        free(source->chunks);
+        free(source->chunk_file);
+        if (source->free_chunks) {
+            channel_close(source->free_chunks);
+            channel_destroy(source->free_chunks);
+        }
+        free(source);
+        return NULL;
+    }
+    for (size_t i = 0; i < buffer_count; i++) {
+        source->chunks[i].data = (char*)source->buffers + i * buffer_size;
+        source->chunks[i].index = i;
+        channel_send(source->free_chunks, &source->chunks[i]);
+    }
+
+    // io_uring may be missing (old kernel) or forbidden (seccomp); pread() keeps the stage working then
+    source->async = uring_init(&source->ring, queue_depth) == 0;
+    if (source->async) {
+        // Registered buffers save the kernel from pinning the pages on every read; this needs
+        // enough RLIMIT_MEMLOCK, so plain reads are used when registration is refused
+        struct iovec* iovecs = malloc(buffer_count * sizeof(struct iovec));
+        if (iovecs && buffer_count <= UINT32_MAX) {
+            for (size_t i = 0; i < buffer_count; i++) {
+                iovecs[i].iov_base = source->chunks[i].data;
+                iovecs[i].iov_len = buffer_size;
+            }
+            source->registered = syscall(__NR_io_uring_register, source->ring.fd, IORING_REGISTER_BUFFERS, iovecs,
+                                         (unsigned)buffer_count) == 0;
+        }
+        free(iovecs);
+    }
+    return source;
+}
+
+int uring_source_add_file(uring_source_t* source, int fd, channel_t* out)
+{
+    uring_file_t* files = realloc(source->files, (source->file_count + 1) * sizeof(uring_file_t));
+    if (!files) {
+        return -1;
+    }
+    source->files = files;
+    uring_file_t* file = &files[source->file_count++];
+    memset(file, 0, sizeof(*file));
+    file->fd = fd;
+    file->out = out;
+    return 0;
+}
+
+enum channel_status uring_source_release(uring_source_t* source, io_chunk_t* chunk)
+{
+    return channel_send(source->free_chunks, chunk);
+}
+
+channel_t* uring_source_free_channel(uring_source_t* source)
+{
+    return source->free_chunks;
+}
+
+bool uring_source_is_async(uring_source_t* source)
+{
+    return source->async;
+}
+
+// Returns the next file (round robin) that still needs reads submitted, or NULL if there is none
+static uring_file_t* uring_source_next_file(uring_source_t* source, size_t* index)
+{
+    for (size_t n = 0; n < source->file_count; n++) {
+        size_t i = (source->next_file + n) % source->file_count;
+        if (!source->files[i].eof) {
+            source->next_file = i + 1;
+            *index = i;
+            return &source->files[i];
+        }
+    }
+    return NULL;
+}
+
+// Handles a finished read of chunk: data is sent on, the first short read ends the file
+// Once the run has failed (*status != SUCCESS) chunks are only recycled
+// Returns true when this completion finished its file
+static bool uring_source_complete(uring_source_t* source, io_chunk_t* chunk, long res, enum channel_status* status)
+{
+    uring_file_t* file = &source->files[source->chunk_file[chunk->index]];
+    file->inflight--;
+
+    if (*status != SUCCESS) {
+        channel_send(source->free_chunks, chunk);
+    } else if (res > 0) {
+        // Data chunks are delivered even after another read hit the end of the file: completions
+        // are unordered, so an earlier offset can finish after a later one returned 0
+        chunk->length = (size_t)res;
+        chunk->error = 0;
+        *status = channel_send(file->out, chunk);
+        if (*status != SUCCESS) {
+            channel_send(source->free_chunks, chunk);
+        }
+    } else if (!file->eof || !file->marker) {
+        // First read past the end (or failed read): keep the chunk as the end-of-file marker
+        file->eof = true;
+        chunk->length = 0;
+        chunk->error = res < 0 ? (int)-res : 0;
+        file->marker = chunk;
+    } else {
+        channel_send(source->free_chunks, chunk);
+    }
+
+    if (file->eof && file->inflight == 0 && !file->done) {
+        file->done = true;
+        if (file->marker && *status == SUCCESS) {
+            *status = channel_send(file->out, file->marker);
+            if (*status != SUCCESS) {
+                channel_send(source->free_chunks, file->marker);
+            }
+        } else if (file->marker) {
+            channel_send(source->free_chunks, file->marker);
+        }
+        file->marker = NULL;
+        return true;
+    }
+    return false;
+}
+
+enum channel_status uring_source_run(uring_source_t* source)
+{
+    enum channel_status status = SUCCESS;
+    size_t remaining = source->file_count;
+    size_t inflight = 0;
+
+    while (remaining > 0) {
+        // Queue reads while the ring has room and buffers are free
+        while (status == SUCCESS && inflight < source->depth) {
+            size_t file_index;
+            uring_file_t* file = uring_source_next_file(source, &file_index);
+            if (!file) {
+                break;
+            }
+            // Only wait for a buffer when nothing is in flight; otherwise go reap completions first
+            void* free_chunk = NULL;
+            enum channel_status rc = inflight == 0 ? channel_receive(source->free_chunks, &free_chunk)
+                                                   : channel_non_blocking_receive(source->free_chunks, &free_chunk);
+            if (rc == CHANNEL_EMPTY) {
+                break;
+            }
+            if (rc != SUCCESS) {
+                status = rc;
+                break;
+            }
+            io_chunk_t* chunk = free_chunk;
+            chunk->fd = file->fd;
+            chunk->offset = file->next_offset;
+            file->next_offset += (off_t)source->buffer_size;
+            file->inflight++;
+            source->chunk_file[chunk->index] = file_index;
+
+            if (!source->async) {
+                ssize_t res = pread(chunk->fd, chunk->data, source->buffer_size, chunk->offset);
+                if (uring_source_complete(source, chunk, res < 0 ? -errno : res, &status)) {
+                    remaining--;
+                }
+                continue;
+            }
+            struct io_uring_sqe* sqe = uring_get_sqe(&source->ring);
+            if (!sqe) {
+                // The ring is smaller than queue_depth asked for
+                file->next_offset -= (off_t)source->buffer_size;
+                file->inflight--;
+                channel_send(source->free_chunks, chunk);
+                break;
+            }
+            sqe->opcode = source->registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe->fd = chunk->fd;
+            sqe->off = (uint64_t)chunk->offset;
+            sqe->addr = (uint64_t)(uintptr_t)chunk->data;
+            sqe->len = (uint32_t)source->buffer_size;
+            sqe->buf_index = (uint16_t)(source->registered ? chunk->index : 0);
+            sqe->user_data = (uint64_t)(uintptr_t)chunk;
+            inflight++;
+        }
+
+        if (inflight == 0) {
+            // Nothing left to wait for: either every file is done or the run failed
+            if (status != SUCCESS) {
+                break;
+            }
+            continue;
+        }
+
+        if (uring_submit_and_wait(&source->ring, 1) != 0) {
+            // Reads already in the kernel still own their buffers, so the ring cannot be abandoned
+            // halfway; this only happens when the submission itself is rejected
+            return GENERIC_ERROR;
+        }
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring_peek_cqe(&source->ring)) != NULL) {
+            io_chunk_t* chunk = (io_chunk_t*)(uintptr_t)cqe->user_data;
+            long res = cqe->res;
+            uring_cqe_seen(&source->ring);
+            inflight--;
+            if (uring_source_complete(source, chunk, res, &status)) {
+                remaining--;
+            }
+        }
+    }
+    return status;
+}
+
+void uring_source_destroy(uring_source_t* source)
+{
+    if (source->async) {
+        uring_exit(&source->ring);
+    }
+    channel_close(source->free_chunks);
+    channel_destroy(source->free_chunks);
+    munmap(source->buffers, source->buffer_count * source->buffer_size);
+    free(source->chunks);
+    free(source->chunk_file);
+    free(source->files);
+    free(source);
+}
+
+// Writes the whole chunk synchronously, returning false on failure
+static bool uring_sink_write_rest(int fd, io_chunk_t* chunk, size_t written)
+{
+    while (written < chunk->length) {
+        ssize_t res = pwrite(fd, (char*)chunk->data + written, chunk->length - written,
+                             chunk->offset + (off_t)written);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        written += (size_t)res;
+    }
+    return true;
+}
+
+enum channel_status uring_sink_run(channel_t* in, int fd, unsigned queue_depth, channel_t* release)
+{
+    uring_t ring;
+    bool async = queue_depth > 0 && uring_init(&ring, queue_depth) == 0;
+    enum channel_status status = SUCCESS;
+    bool failed = false;
+    bool finished = false;
+    bool rejected = false; // the ring rejected a submission; later chunks are written synchronously
+    io_chunk_t* last = NULL;
+    size_t inflight = 0;
+
+    while (!finished || inflight > 0) {
+        // Collect a batch: block for the first chunk only when no write is pending
+        while (!finished && status == SUCCESS && (!async || rejected || inflight < queue_depth)) {
+            void* received = NULL;
+            enum channel_status rc = inflight == 0 ? channel_receive(in, &received)
+                                                   : channel_non_blocking_receive(in, &received);
+            if (rc == CHANNEL_EMPTY) {
+                break;
+            }
+            if (rc != SUCCESS) {
+                status = rc;
+                finished = true;
+                break;
+            }
+            io_chunk_t* chunk = received;
+            if (chunk->length == 0) {
+                last = chunk;
+                finished = true;
+                break;
+            }
+            struct io_uring_sqe* sqe = async && !rejected ? uring_get_sqe(&ring) : NULL;
+            if (!sqe) {
+                if (!uring_sink_write_rest(fd, chunk, 0)) {
+                    failed = true;
+                }
+                if (release) {
+                    channel_send(release, chunk);
+                }
+                continue;
+            }
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->off = (uint64_t)chunk->offset;
+            sqe->addr = (uint64_t)(uintptr_t)chunk->data;
+            sqe->len = (uint32_t)chunk->length;
+            sqe->user_data = (uint64_t)(uintptr_t)chunk;
+            inflight++;
+        }
+        if (inflight == 0) {
+            continue;
+        }
+
+        // The whole batch goes to the kernel in one io_uring_enter
+        if (uring_submit_and_wait(&ring, 1) != 0) {
+            // Writes the kernel already took still own their buffers and are reaped below before the ring
+            // goes away; the entries it never saw are written here instead
+            rejected = true;
+            uint64_t user_data;
+            bool taken = false;
+            while (uring_take_back_sqe(&ring, &user_data)) {
+                io_chunk_t* chunk = (io_chunk_t*)(uintptr_t)user_data;
+                taken = true;
+                inflight--;
+                if (!uring_sink_write_rest(fd, chunk, 0)) {
+                    failed = true;
+                }
+                if (release) {
+                    channel_send(release, chunk);
+                }
+            }
+            if (!taken) {
+                // Even waiting is rejected: let the kernel make progress and poll the completions
+                sched_yield();
+            }
+        }
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            io_chunk_t* chunk = (io_chunk_t*)(uintptr_t)cqe->user_data;
+            int res = cqe->res;
+            uring_cqe_seen(&ring);
+            inflight--;
+            // Short writes are rare on files; finish them synchronously
+            if (res < 0 || !uring_sink_write_rest(fd, chunk, (size_t)res)) {
+                failed = true;
+            }
+            if (release) {
+                channel_send(release, chunk);
+            }
+        }
+    }
+
+    if (last && release) {
+        channel_send(release, last);
+    }
+    if (async) {
+        uring_exit(&ring);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+    return failed ? GENERIC_ERROR : SUCCESS;
+}
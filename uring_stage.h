@@ -0,0 +1,57 @@
+#ifndef URING_STAGE_H
+#define URING_STAGE_H
+#include <stdbool.h>
+#include <sys/types.h>
+#include "channel.h"
+
+// Describes one I/O buffer travelling through a pipeline of channels
+// Chunks are owned by the source that created them and must be handed back with uring_source_release
+// (or by a sink given the source's free channel) once the consumer is done with the bytes
+typedef struct {
+    // Start of the buffer; it holds up to the source's buffer_size bytes
+    void* data;
+    // Number of valid bytes; a chunk with length 0 marks the end of its file
+    size_t length;
+    // File offset the bytes were read from
+    off_t offset;
+    // File the bytes were read from
+    int fd;
+    // 0, or the errno of the read that ended the file early (end-of-file chunks only)
+    int error;
+    // Index of the buffer in the source's buffer table
+    size_t index;
+} io_chunk_t;
+
+// Reads files into channels from a single thread that keeps many reads in flight through io_uring
+typedef struct uring_source uring_source_t;
+
+// Creates a source with buffer_count buffers of buffer_size bytes and up to queue_depth reads in flight
+// The buffers are registered with the ring when possible and recycled through an internal free channel
+// Falls back to synchronous pread() when io_uring is not available
+// Returns NULL on invalid arguments (including buffers totaling more than SIZE_MAX bytes) or allocation failure
+uring_source_t* uring_source_create(size_t buffer_count, size_t buffer_size, unsigned queue_depth);
+// Queues the regular file fd to be read from offset 0 to its end into out
+// Chunks arrive in completion order, which is not necessarily file order; use io_chunk_t.offset to reorder
+// A zero-length chunk is sent after every data chunk of the file has been sent
+// Must be called before uring_source_run; returns 0, or -1 on allocation failure
+int uring_source_add_file(uring_source_t* source, int fd, channel_t* out);
+// Reads every queued file in the calling thread and returns once all of them have been sent
+// Blocks while no buffer is free, so consumers must release chunks as they finish with them
+// Returns SUCCESS, CLOSED_ERROR if an output channel was closed, or GENERIC_ERROR on a ring failure
+enum channel_status uring_source_run(uring_source_t* source);
+// Hands a chunk received from one of the source's channels back to the source
+enum channel_status uring_source_release(uring_source_t* source, io_chunk_t* chunk);
+// Returns the channel the source takes free buffers from; sinks can release chunks into it directly
+channel_t* uring_source_free_channel(uring_source_t* source);
+// Returns true if the source submits its reads through io_uring rather than pread()
+bool uring_source_is_async(uring_source_t* source);
+// Frees the source and its buffers; no chunk may still be in use
+void uring_source_destroy(uring_source_t* source);
+
+// Writes the chunks received from in to fd at their offsets, submitting up to queue_depth writes per batch
+// Runs in the calling thread until it receives a zero-length chunk; every chunk (including the final one)
+// is sent to release afterwards when release is not NULL
+// Falls back to synchronous pwrite() when io_uring is not available or rejects a submission
+// Returns SUCCESS, CLOSED_ERROR if in was closed, or GENERIC_ERROR if a write failed
+enum channel_status uring_sink_run(channel_t* in, int fd, unsigned queue_depth, channel_t* release);
+#endif // URING_STAGE_H